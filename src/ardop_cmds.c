@@ -35,6 +35,7 @@
 #include "arim_arq_msg.h"
 #include "bufq.h"
 #include "tnc_attach.h"
+#include "tnc_flow.h"
 #include "ui.h"
 
 size_t ardop_cmds_proc_resp(char *response, size_t size)
@@ -78,6 +79,7 @@ size_t ardop_cmds_proc_resp(char *response, size_t size)
                 snprintf(g_tnc_settings[g_cur_tnc].buffer,
                     sizeof(g_tnc_settings[g_cur_tnc].buffer), "%s", val);
                 pthread_mutex_unlock(&mutex_tnc_set);
+                tnc_flow_on_buffer(atoi(val));
             } else if (!strncasecmp(start, "NEWSTATE", 8)) {
                 pthread_mutex_lock(&mutex_tnc_set);
                 snprintf(g_tnc_settings[g_cur_tnc].state,
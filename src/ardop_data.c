@@ -33,6 +33,7 @@
 #include "arim_arq_files.h"
 #include "arim_arq_msg.h"
 #include "bufq.h"
+#include "trace.h"
 
 int arim_data_waiting = 0;
 time_t arim_start_time = 0;
@@ -204,82 +205,127 @@ void ardop_data_on_err(char *data, size_t size)
     bufq_queue_debug_log("Data thread: received ARDOP ERR frame from TNC");
 }
 
+/*  Receive buffer for the data port byte stream. Frames are parsed in place
+    and every complete frame is dispatched; a trailing partial frame is kept
+    and moved to the front of the buffer when space is needed. The extra
+    byte allows a frame's payload to be nul terminated while it's handled. */
+static unsigned char rx_buf[MIN_DATA_BUF_SIZE+1];
+static size_t rx_head, rx_tail, rx_skip;
+
+void ardop_data_reset_rx()
+{
+    rx_head = rx_tail = rx_skip = 0;
+}
+
 //#define VIEW_DATA_IN
-size_t ardop_data_handle_data(unsigned char *data, size_t size)
+void ardop_data_dispatch_frame(unsigned char *frame, size_t datasize)
 {
-    static unsigned char buffer[MIN_DATA_BUF_SIZE];
-    static size_t cnt = 0;
     static int arim_frame_type = 0;
-    int is_new_frame, is_arim_frame, datasize = 0;
+    int is_new_frame, is_arim_frame;
 
 #ifdef VIEW_DATA_IN
 char buf[MIN_DATA_BUF_SIZE];
-#endif
-
-    if ((cnt + size) > sizeof(buffer)) {
-        /* too much data, can't be a valid ARIM payload */
-        cnt = 0;
-        return cnt;
-    }
-    ardop_data_inc_num_bytes_in(size);
-    memcpy(buffer + cnt, data, size);
-    cnt += size;
-    /* extract data size */
-    if (cnt < 5) /* not enough data yet, wait for more */
-        return cnt;
-    /* is this a valid frame? */
-    if ((buffer[2] == 'A' && buffer[3] == 'R' && buffer[4] == 'Q') ||
-        (buffer[2] == 'F' && buffer[3] == 'E' && buffer[4] == 'C') ||
-        (buffer[2] == 'E' && buffer[3] == 'R' && buffer[4] == 'R') ||
-        (buffer[2] == 'I' && buffer[3] == 'D' && buffer[4] == 'F')) {
-        /* yes, extract payload size */
-        datasize = buffer[0] << 8;
-        datasize += buffer[1];
-    }
-    if (datasize <= 0) {
-        /* invalid frame or bad payload size */
-        bufq_queue_debug_log("Data thread: received bad ARDOP ARQ frame from TNC");
-        cnt = 0;
-        return cnt;
-    }
-    if (datasize <= (cnt - 2)) {
-        /* got all data, dispatch on frame type */
-#ifdef VIEW_DATA_IN
-snprintf(buf, datasize + 7, "[%04X]%s", datasize, buffer + 2);
+snprintf(buf, datasize + 7, "[%04zX]%s", datasize, frame);
 bufq_queue_debug_log(buf);
 sleep(1);
 #endif
-        if (buffer[2] == 'F') { /* FEC frame */
-            is_arim_frame = 0;
-            is_arim_frame = arim_test_frame((char *)&buffer[5], datasize - 3);
-            is_new_frame = 0;
-            is_new_frame = (!arim_data_waiting && is_arim_frame);
-            if (is_new_frame) {
-                arim_frame_type = is_arim_frame;
-                arim_on_event(EV_FRAME_START, arim_frame_type);
-                bufq_queue_debug_log("Data thread: received start of ARIM frame");
+    /* frame type is first three chars, e.g. 'ARQ' or 'FEC' */
+    trace_record(TRACE_DATA_RX, (int)datasize, frame[0] << 16 | frame[1] << 8 | frame[2], 0);
+    if (frame[0] == 'F') { /* FEC frame */
+        is_arim_frame = 0;
+        is_arim_frame = arim_test_frame((char *)&frame[3], datasize - 3);
+        is_new_frame = 0;
+        is_new_frame = (!arim_data_waiting && is_arim_frame);
+        if (is_new_frame) {
+            arim_frame_type = is_arim_frame;
+            arim_on_event(EV_FRAME_START, arim_frame_type);
+            bufq_queue_debug_log("Data thread: received start of ARIM frame");
+        }
+        if (arim_data_waiting || is_new_frame)
+            arim_data_waiting = arim_on_data((char *)&frame[3], datasize - 3);
+        else
+            ardop_data_on_fec((char *)&frame[3], datasize - 3);
+        /* clear start time if done, otherwise update with current time */
+        if (!arim_data_waiting) {
+            arim_start_time = 0;
+            arim_on_event(EV_FRAME_END, arim_frame_type);
+        } else {
+            arim_start_time = time(NULL);
+        }
+    }
+    else if (frame[0] == 'I') /* IDF frame */
+        ardop_data_on_idf((char *)&frame[3], datasize - 3);
+    else if (frame[0] == 'A') /* ARQ frame */
+        ardop_data_on_arq((char *)&frame[3], datasize - 3);
+    else if (frame[0] == 'E') /* ERR frame */
+        ardop_data_on_err((char *)&frame[3], datasize - 3);
+}
+
+size_t ardop_data_handle_data(unsigned char *data, size_t size)
+{
+    unsigned char *frame, saved;
+    size_t avail, datasize, num;
+
+    ardop_data_inc_num_bytes_in(size);
+    while (size) {
+        if (rx_skip) {
+            /* discard remainder of oversize frame */
+            num = rx_skip < size ? rx_skip : size;
+            rx_skip -= num;
+            data += num;
+            size -= num;
+            continue;
+        }
+        if (rx_tail + size > MIN_DATA_BUF_SIZE && rx_head) {
+            /* make room by moving partial frame to front of buffer */
+            memmove(rx_buf, rx_buf + rx_head, rx_tail - rx_head);
+            rx_tail -= rx_head;
+            rx_head = 0;
+        }
+        num = MIN_DATA_BUF_SIZE - rx_tail;
+        if (num > size)
+            num = size;
+        memcpy(rx_buf + rx_tail, data, num);
+        rx_tail += num;
+        data += num;
+        size -= num;
+        /* dispatch every complete frame in the buffer */
+        while ((avail = rx_tail - rx_head) >= 5) {
+            frame = rx_buf + rx_head;
+            datasize = 0;
+            /* is this a valid frame? */
+            if ((frame[2] == 'A' && frame[3] == 'R' && frame[4] == 'Q') ||
+                (frame[2] == 'F' && frame[3] == 'E' && frame[4] == 'C') ||
+                (frame[2] == 'E' && frame[3] == 'R' && frame[4] == 'R') ||
+                (frame[2] == 'I' && frame[3] == 'D' && frame[4] == 'F')) {
+                /* yes, extract payload size */
+                datasize = frame[0] << 8;
+                datasize += frame[1];
+            }
+            if (datasize < 3) {
+                /* invalid frame or bad payload size, framing is lost */
+                bufq_queue_debug_log("Data thread: received bad ARDOP ARQ frame from TNC");
+                ardop_data_reset_rx();
+                return 0;
             }
-            if (arim_data_waiting || is_new_frame)
-                arim_data_waiting = arim_on_data((char *)&buffer[5], datasize - 3);
-            else
-                ardop_data_on_fec((char *)&buffer[5], datasize - 3);
-            /* clear start time if done, otherwise update with current time */
-            if (!arim_data_waiting) {
-                arim_start_time = 0;
-                arim_on_event(EV_FRAME_END, arim_frame_type);
-            } else {
-                arim_start_time = time(NULL);
+            if (datasize + 2 > MIN_DATA_BUF_SIZE) {
+                /* too much data, can't be a valid ARIM payload */
+                bufq_queue_debug_log("Data thread: discarding oversize ARDOP frame from TNC");
+                rx_skip = datasize + 2 - avail;
+                rx_head = rx_tail = 0;
+                break;
             }
+            if (avail < datasize + 2)
+                break; /* not enough data yet, wait for more */
+            saved = frame[datasize + 2];
+            frame[datasize + 2] = '\0';
+            ardop_data_dispatch_frame(frame + 2, datasize);
+            frame[datasize + 2] = saved;
+            rx_head += datasize + 2;
         }
-        else if (buffer[2] == 'I') /* IDF frame */
-            ardop_data_on_idf((char *)&buffer[5], datasize - 3);
-        else if (buffer[2] == 'A') /* ARQ frame */
-            ardop_data_on_arq((char *)&buffer[5], datasize - 3);
-        else if (buffer[2] == 'E') /* ERR frame */
-            ardop_data_on_err((char *)&buffer[5], datasize - 3);
-        /* reset buffer */
-        cnt = 0;
+        if (rx_head == rx_tail)
+            rx_head = rx_tail = 0;
     }
-    return cnt;
+    return rx_tail - rx_head;
 }
 
@@ -38,6 +38,7 @@ extern size_t ardop_data_get_num_bytes_in(void);
 extern size_t ardop_data_get_num_bytes_out(void);
 extern void ardop_data_reset_num_bytes(void);
 extern size_t ardop_data_handle_data(unsigned char *data, size_t size);
+extern void ardop_data_reset_rx(void);
 
 #ifdef __cplusplus
 }
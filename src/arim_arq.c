@@ -53,6 +53,7 @@
 #define ONE_SECOND_TIMER    5 /* 200 msec intervals */
 
 static int arq_rpts, arq_cmd_size, is_outbound, arq_session_bw_any;
+static int queue_full_disconn;
 static char cached_cmd[MAX_CMD_SIZE];
 static char cached_arq_bw[TNC_ARQ_BW_SIZE];
 static char arq_session_bw[TNC_ARQ_BW_SIZE];
@@ -199,6 +200,7 @@ int arim_arq_on_connected()
         arim_arq_send_disconn_req();
         return 0;
     }
+    queue_full_disconn = 0;
     /* we are connected to a remote station now so
        print to monitor view and traffic log */
     snprintf(buffer, sizeof(buffer),
@@ -508,6 +510,28 @@ int arim_arq_on_conn_closed()
     return 1;
 }
 
+int arim_arq_on_queue_full()
+{
+    char buffer[MAX_LOG_LINE_SIZE];
+    char remote_call[TNC_MYCALL_SIZE], target_call[TNC_MYCALL_SIZE];
+
+    /*  a line for the remote station was dropped because the data queue is
+        full. The session can't recover from a lost protocol line, the remote
+        station would wait for it in vain, so end the session instead */
+    if (queue_full_disconn)
+        return 0; /* already disconnecting */
+    queue_full_disconn = 1;
+    arim_copy_target_call(target_call, sizeof(target_call));
+    if (!strlen(target_call))
+        arim_copy_mycall(target_call, sizeof(target_call));
+    arim_copy_remote_call(remote_call, sizeof(remote_call));
+    snprintf(buffer, sizeof(buffer),
+                "<< [@] %s<%s (Data queue full, line dropped)", remote_call, target_call);
+    bufq_queue_traffic_log(buffer);
+    bufq_queue_data_in(buffer);
+    return arim_arq_send_disconn_req();
+}
+
 size_t arim_arq_send_remote(const char *msg)
 {
     char sendcr[TNC_ARQ_SENDCR_SIZE], linebuf[MAX_LOG_LINE_SIZE];
@@ -518,7 +542,10 @@ size_t arim_arq_send_remote(const char *msg)
         snprintf(linebuf, sizeof(linebuf), "%s\r\n", msg);
     else
         snprintf(linebuf, sizeof(linebuf), "%s\n", msg);
-    bufq_queue_data_out(linebuf);
+    if (!bufq_queue_data_out(linebuf)) {
+        arim_arq_on_queue_full();
+        return 0;
+    }
     return strlen(linebuf);
 }
 
@@ -617,6 +644,33 @@ size_t arim_arq_on_cmd(const char *cmd, size_t size)
                 arim_arq_files_on_fget(cmdbuf, size, eol);
                 break;
             }
+        } else if (!strncasecmp(cmdbuf, "/MFGET ", 7)) {
+            /* remote station requests a batch of files. If in a wait state
+               already, abandon that transaction and respond to the /MFGET to
+               avoid deadlock when commands are issued by both parties simultaneously */
+            switch (state) {
+            case ST_ARQ_FILE_SEND_WAIT:
+            case ST_ARQ_FILE_SEND_WAIT_OK:
+            case ST_ARQ_FILE_RCV_WAIT:
+            case ST_ARQ_FILE_RCV_WAIT_OK:
+            case ST_ARQ_FLIST_SEND_WAIT:
+            case ST_ARQ_FLIST_RCV_WAIT:
+            case ST_ARQ_AUTH_RCV_A2_WAIT:
+            case ST_ARQ_AUTH_RCV_A3_WAIT:
+            case ST_ARQ_MSG_SEND_WAIT:
+                arim_on_event(EV_ARQ_CANCEL_WAIT, 0);
+                state = arim_get_state();
+                break;
+            }
+            switch (state) {
+            case ST_ARQ_AUTH_RCV_A4_WAIT:
+                /* /MFGET implies remote stn accepted our /A3, auth successful */
+                arim_on_event(EV_ARQ_AUTH_OK, 0);
+                /* fallthrough intentional */
+            case ST_ARQ_CONNECTED:
+                arim_arq_files_on_mfget(cmdbuf, size, eol);
+                break;
+            }
         } else if (!strncasecmp(cmdbuf, "/FLPUT ", 7)) {
             /* remote station sends a file listing. If in a wait state already,
                abandon that transaction and respond to the /fput to avoid
@@ -803,8 +857,12 @@ size_t arim_arq_on_cmd(const char *cmd, size_t size)
             }
         } else if (!strncasecmp(cmdbuf, "/OK", 3)) {
             switch (state) {
-            case ST_ARQ_FILE_SEND:
             case ST_ARQ_FILE_SEND_WAIT_OK:
+                /* must call this before data is queued if resuming a file */
+                arim_arq_files_on_resume(cmdbuf);
+                arim_on_event(EV_ARQ_FILE_OK, 0);
+                break;
+            case ST_ARQ_FILE_SEND:
             case ST_ARQ_FLIST_SEND:
                 arim_on_event(EV_ARQ_FILE_OK, 0);
                 break;
@@ -893,7 +951,12 @@ size_t arim_arq_on_cmd(const char *cmd, size_t size)
                 numch = snprintf(respbuf, sizeof(respbuf), "%s\r\n", buffer);
             else
                 numch = snprintf(respbuf, sizeof(respbuf), "%s\n", buffer);
-            bufq_queue_data_out(respbuf);
+            if (!bufq_queue_data_out(respbuf)) {
+                /* session is being ended, discard rest of response */
+                arim_arq_on_queue_full();
+                cnt = 0;
+                return cnt;
+            }
             cnt -= (e - buffer);
             memmove(buffer, e, cnt + 1);
         }
@@ -40,6 +40,10 @@
 #include "ui_dialog.h"
 #include "log.h"
 #include "zlib.h"
+#include "zdict.h"
+#include "zcache.h"
+#include "fstream.h"
+#include "farc.h"
 #include "datathread.h"
 #include "arim_arq.h"
 #include "arim_arq_auth.h"
@@ -49,6 +53,12 @@ static FILEQUEUEITEM file_in;
 static FILEQUEUEITEM file_out;
 static size_t file_in_cnt, file_out_cnt, flistsize;
 static char flistbuf[MAX_UNCOMP_DATA_SIZE+1];
+static FSTREAM stream_in, stream_out;
+/* resume offsets for streamed files, see fstream.c */
+static size_t file_in_offset, file_out_offset, resume_offset;
+static unsigned int resume_check;
+/* set if file is a batch of files packed by farc_pack() */
+static int file_in_archive, file_out_archive;
 
 int arim_arq_files_send_flist(const char *dir)
 {
@@ -108,6 +118,7 @@ int arim_arq_files_send_flist(const char *dir)
         return 0;
     }
     snprintf(file_out.path, sizeof(file_out.path), "%s", dir ? dir : "");
+    file_out.stream = NULL;
     /* compress file listing if -z option invoked */
     if (zoption) {
         zs.zalloc = Z_NULL;
@@ -117,7 +128,7 @@ int arim_arq_files_send_flist(const char *dir)
         zs.next_in = (Bytef *)flistbuf;
         zs.avail_out = sizeof(file_out.data);
         zs.next_out = (Bytef *)file_out.data;
-        zret = deflateInit(&zs, Z_BEST_COMPRESSION);
+        zret = zdict_deflate_init(&zs, zoption);
         if (zret == Z_OK) {
             zret = deflate(&zs, Z_FINISH);
             if (zret != Z_STREAM_END) {
@@ -162,12 +173,12 @@ int arim_arq_files_send_flist(const char *dir)
     file_out.check = ccitt_crc16(file_out.data, file_out.size);
     /* enqueue command for TNC */
     if (dir)
-        snprintf((char *)databuf, sizeof(databuf), "%s %s %zu %04X",
-                 zoption ? "/FLPUT -z" : "/FLPUT",
+        snprintf((char *)databuf, sizeof(databuf), "/FLPUT%s %s %zu %04X",
+                 zdict_opt_str(zoption),
                     file_out.path, file_out.size, file_out.check);
     else
-        snprintf((char *)databuf, sizeof(databuf), "%s %zu %04X",
-                 zoption ? "/FLPUT -z" : "/FLPUT", file_out.size, file_out.check);
+        snprintf((char *)databuf, sizeof(databuf), "/FLPUT%s %zu %04X",
+                 zdict_opt_str(zoption), file_out.size, file_out.check);
     arim_arq_send_remote(databuf);
     /* initialize count and start progress meter */
     file_out_cnt = 0;
@@ -183,6 +194,7 @@ int arim_arq_files_flist_on_send_cmd()
     pthread_mutex_lock(&mutex_file_out);
     fileq_push(&g_file_out_q, &file_out);
     pthread_mutex_unlock(&mutex_file_out);
+    bufq_notify(&g_data_out_notify);
     numch = snprintf(linebuf, sizeof(linebuf),
                      "ARQ: File listing upload for %s buffered for sending",
                          *file_out.path ? file_out.path : "(root)");
@@ -318,7 +330,7 @@ int arim_arq_files_flist_on_rcv_frame(const char *data, size_t size)
             zs.next_out = (Bytef *)flistbuf;
             zret = inflateInit(&zs);
             if (zret == Z_OK) {
-                zret = inflate(&zs, Z_FINISH);
+                zret = zdict_inflate(&zs);
                 inflateEnd(&zs);
                 if (zret != Z_STREAM_END) {
                     numch = snprintf(linebuf, sizeof(linebuf),
@@ -388,8 +400,7 @@ int arim_arq_files_on_flput(char *cmd, size_t size, char *eol)
     while (*s && (*s == ' ' || *s == '/'))
         ++s;
     if (*s && (s == strstr(s, "-z"))) {
-        zoption = 1;
-        s += 2;
+        s += zdict_parse_opt(s, &zoption);
         while (*s && (*s == ' ' || *s == '/'))
             ++s;
     }
@@ -484,8 +495,7 @@ int arim_arq_files_on_flget(char *cmd, size_t size, char *eol)
     while (*s && (*s == ' ' || *s == '/'))
         ++s;
     if (*s && (s == strstr(s, "-z"))) {
-        zoption = 1;
-        s += 2;
+        s += zdict_parse_opt(s, &zoption);
         while (*s && (*s == ' ' || *s == '/'))
             ++s;
     }
@@ -626,7 +636,7 @@ int arim_arq_files_send_dyn_file(const char *fn, const char *destdir, int is_loc
         zs.next_in = (Bytef *)filebuf;
         zs.avail_out = sizeof(file_out.data);
         zs.next_out = (Bytef *)file_out.data;
-        zret = deflateInit(&zs, Z_BEST_COMPRESSION);
+        zret = zdict_deflate_init(&zs, zoption);
         if (zret == Z_OK) {
             zret = deflate(&zs, Z_FINISH);
             if (zret != Z_STREAM_END) {
@@ -683,15 +693,16 @@ int arim_arq_files_send_dyn_file(const char *fn, const char *destdir, int is_loc
     }
     snprintf(file_out.name, sizeof(file_out.name), "%s", fn);
     snprintf(file_out.path, sizeof(file_out.path), "%s", destdir ? destdir : "");
+    file_out.stream = NULL;
     file_out.check = ccitt_crc16(file_out.data, file_out.size);
     /* enqueue command for TNC */
     if (destdir)
-        snprintf(databuf, sizeof(databuf), "%s %s %zu %04X > %s",
-                 zoption ? "/FPUT -z" : "/FPUT",
+        snprintf(databuf, sizeof(databuf), "/FPUT%s %s %zu %04X > %s",
+                 zdict_opt_str(zoption),
                      file_out.name, file_out.size, file_out.check, file_out.path);
     else
-        snprintf(databuf, sizeof(databuf), "%s %s %zu %04X",
-                 zoption ? "/FPUT -z" : "/FPUT",
+        snprintf(databuf, sizeof(databuf), "/FPUT%s %s %zu %04X",
+                 zdict_opt_str(zoption),
                      file_out.name, file_out.size, file_out.check);
     len = arim_arq_send_remote(databuf);
     /* initialize count and start progress meter */
@@ -700,17 +711,136 @@ int arim_arq_files_send_dyn_file(const char *fn, const char *destdir, int is_loc
     return 1;
 }
 
+int arim_arq_files_start_upload(const char *fn, const char *destdir)
+{
+    char fpath[MAX_PATH_SIZE], linebuf[MAX_LOG_LINE_SIZE];
+    char databuf[MIN_DATA_BUF_SIZE], remote_call[TNC_MYCALL_SIZE];
+    char ropt[32];
+    int numch;
+
+    snprintf(fpath, sizeof(fpath), "%s", fn);
+    snprintf(file_out.name, sizeof(file_out.name), "%s", basename(fpath));
+    snprintf(file_out.path, sizeof(file_out.path), "%s", destdir ? destdir : "");
+    /* streamed files offer resume with '-r', or continue at '-r:offset',
+       archives from /MFGET are flagged with '-a' */
+    if (file_out_archive)
+        snprintf(ropt, sizeof(ropt), " -a");
+    else if (file_out_offset)
+        snprintf(ropt, sizeof(ropt), " -r:%zu", file_out_offset);
+    else
+        snprintf(ropt, sizeof(ropt), "%s", file_out.stream ? " -r" : "");
+    /* enqueue command for TNC */
+    if (destdir)
+        snprintf(databuf, sizeof(databuf), "/FPUT%s%s %s %zu %04X > %s",
+                 zdict_opt_str(zoption), ropt, file_out.name,
+                     file_out_offset + file_out.size, file_out.check, file_out.path);
+    else
+        snprintf(databuf, sizeof(databuf), "/FPUT%s%s %s %zu %04X",
+                 zdict_opt_str(zoption), ropt, file_out.name,
+                     file_out_offset + file_out.size, file_out.check);
+    arim_arq_send_remote(databuf);
+    /* initialize count and start progress meter */
+    file_out_cnt = 0;
+    ui_status_xfer_start(0, file_out.size, STATUS_XFER_DIR_UP);
+    /* initialize file history entry */
+    arim_copy_remote_call(remote_call, sizeof(remote_call));
+    numch = snprintf(linebuf, MAX_FTABLE_ROW_SIZE,
+             "O%c%-12s%6zu%04X%s", zoption ? 'Z' : ' ',
+                 remote_call, file_out_offset + file_out.size, file_out.check, fpath);
+    if (numch >= MAX_FTABLE_ROW_SIZE)
+        ui_truncate_line(linebuf, MAX_FTABLE_ROW_SIZE);
+    bufq_queue_ftable(linebuf);
+    return 1;
+}
+
+int arim_arq_files_send_stream(const char *fn, const char *fpath,
+                                   const char *destdir, int is_local)
+{
+    char linebuf[MAX_LOG_LINE_SIZE];
+    size_t max;
+    int numch;
+
+    /* read and compress in a first pass to get size and checksum,
+       data is read again block by block by the data thread */
+    if (!fstream_open(&stream_out, fpath, zoption)) {
+        if (is_local) {
+            ui_show_dialog("\tCannot send file:\n"
+                           "\tfile read failed.\n \n\t[O]k", "oO \n");
+        } else {
+            snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot open file");
+            arim_arq_send_remote(linebuf);
+        }
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File upload %s failed, stream read error", fn);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        return 0;
+    }
+    max = atoi(g_arim_settings.max_arq_file_size);
+    if (stream_out.size > max) {
+        fstream_close(&stream_out);
+        if (is_local) {
+            ui_show_dialog("\tCannot send file:\n"
+                           "\tfile size exceeds limit.\n \n\t[O]k", "oO \n");
+        } else {
+            snprintf(linebuf, sizeof(linebuf), "/ERROR File size exceeds limit");
+            arim_arq_send_remote(linebuf);
+        }
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File upload %s failed, size exceeds limit", fn);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        return 0;
+    }
+    file_out.size = stream_out.size;
+    file_out.check = fstream_get_check(&stream_out);
+    file_out.stream = &stream_out;
+    numch = snprintf(linebuf, sizeof(linebuf),
+                     "ARQ: File upload %s streaming %zu bytes", fn, file_out.size);
+    if (numch >= sizeof(linebuf))
+        ui_truncate_line(linebuf, sizeof(linebuf));
+    bufq_queue_debug_log(linebuf);
+    /* remote asked to resume an interrupted /FGET, honor it only if
+       this revision of the file is the one it has a part of */
+    if (!is_local && resume_offset) {
+        if (resume_offset < stream_out.size && resume_check == file_out.check) {
+            if (!fstream_skip(&stream_out, resume_offset)) {
+                fstream_close(&stream_out);
+                snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot open file");
+                arim_arq_send_remote(linebuf);
+                return 0;
+            }
+            file_out_offset = resume_offset;
+            file_out.size -= resume_offset;
+        }
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File upload %s resume at %zu %s", fn, resume_offset,
+                             file_out_offset ? "accepted" : "refused, file changed");
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        resume_offset = 0;
+    }
+    return arim_arq_files_start_upload(fn, destdir);
+}
+
 int arim_arq_files_send_file(const char *fn, const char *destdir, int is_local)
 {
     FILE *fp;
     char fpath[MAX_PATH_SIZE], dpath[MAX_PATH_SIZE];
-    char linebuf[MAX_LOG_LINE_SIZE], databuf[MIN_DATA_BUF_SIZE];
-    char filebuf[MAX_UNCOMP_DATA_SIZE+1], remote_call[TNC_MYCALL_SIZE];
+    char linebuf[MAX_LOG_LINE_SIZE], filebuf[MAX_UNCOMP_DATA_SIZE+1];
     size_t max, filesize;
-    int numch, result;
+    int numch, result, cacheable, cached = 0;
+    struct stat st;
     z_stream zs;
     int zret;
 
+    /* release stream left over from an earlier upload */
+    fstream_close(&stream_out);
+    file_out_offset = 0;
+    file_out_archive = 0;
     max = atoi(g_arim_settings.max_file_size);
     if (max <= 0) {
         if (is_local) {
@@ -750,8 +880,8 @@ int arim_arq_files_send_file(const char *fn, const char *destdir, int is_local)
         return 0;
     }
     snprintf(fpath, sizeof(fpath), "%s", fn);
-    if (strstr(basename(fpath), DEFAULT_DIGEST_FNAME)) {
-        /* deny access to password digest file */
+    if (strstr(basename(fpath), DEFAULT_DIGEST_FNAME) || strstr(fn, DEFAULT_ZCACHE_DIR)) {
+        /* deny access to password digest file and compressed file cache */
         if (is_local) {
             ui_show_dialog("\tCannot send file:\n"
                            "\tpassword file not accessible.\n \n\t[O]k", "oO \n");
@@ -802,12 +932,24 @@ int arim_arq_files_send_file(const char *fn, const char *destdir, int is_local)
         bufq_queue_debug_log(linebuf);
         return 0;
     }
+    /* files too large for one buffer are streamed if enabled */
+    cacheable = !fstat(fileno(fp), &st);
+    if (cacheable && (size_t)st.st_size > max &&
+        (size_t)atoi(g_arim_settings.max_arq_file_size) > max) {
+        fclose(fp);
+        return arim_arq_files_send_stream(fn, fpath, destdir, is_local);
+    }
+    /* reuse compressed data if this revision of the file was sent before */
+    cacheable = cacheable && zoption;
+    if (cacheable)
+        cached = zcache_get(fn, &st, zoption, file_out.data, max,
+                            &file_out.size, &file_out.check);
     /* read into buffer, will be sent later by arim_arq_files_on_send_cmd()
        file will be truncated if larger than buffer */
-    filesize = fread(filebuf, 1, sizeof(filebuf), fp);
+    filesize = cached ? 0 : fread(filebuf, 1, sizeof(filebuf), fp);
     fclose(fp);
     /* test size of file */
-    if (filesize > MAX_UNCOMP_DATA_SIZE || (!zoption && filesize > max)) {
+    if (!cached && (filesize > MAX_UNCOMP_DATA_SIZE || (!zoption && filesize > max))) {
         if (is_local) {
             ui_show_dialog("\tCannot send file:\n"
                            "\tfile size exceeds limit.\n \n\t[O]k", "oO \n");
@@ -823,7 +965,9 @@ int arim_arq_files_send_file(const char *fn, const char *destdir, int is_local)
         return 0;
     }
     /* compress file if -z option invoked */
-    if (zoption) {
+    if (cached) {
+        ; /* file_out already holds the compressed data and its checksum */
+    } else if (zoption) {
         zs.zalloc = Z_NULL;
         zs.zfree = Z_NULL;
         zs.opaque = Z_NULL;
@@ -831,7 +975,7 @@ int arim_arq_files_send_file(const char *fn, const char *destdir, int is_local)
         zs.next_in = (Bytef *)filebuf;
         zs.avail_out = sizeof(file_out.data);
         zs.next_out = (Bytef *)file_out.data;
-        zret = deflateInit(&zs, Z_BEST_COMPRESSION);
+        zret = zdict_deflate_init(&zs, zoption);
         if (zret == Z_OK) {
             zret = deflate(&zs, Z_FINISH);
             if (zret != Z_STREAM_END) {
@@ -886,32 +1030,110 @@ int arim_arq_files_send_file(const char *fn, const char *destdir, int is_local)
         memcpy(file_out.data, filebuf, filesize);
         file_out.size = filesize;
     }
-    snprintf(fpath, sizeof(fpath), "%s", fn);
-    snprintf(file_out.name, sizeof(file_out.name), "%s", basename(fpath));
-    snprintf(file_out.path, sizeof(file_out.path), "%s", destdir ? destdir : "");
+    if (!cached) {
+        file_out.check = ccitt_crc16(file_out.data, file_out.size);
+        if (cacheable)
+            zcache_put(fn, &st, zoption, file_out.data, file_out.size, file_out.check);
+    }
+    file_out.stream = NULL;
+    return arim_arq_files_start_upload(fn, destdir);
+}
+
+int arim_arq_files_send_archive(const char *pattern, const char *destdir)
+{
+    char fpath[MAX_PATH_SIZE], dpath[MAX_PATH_SIZE*2], *glob;
+    char linebuf[MAX_LOG_LINE_SIZE], arcbuf[MAX_UNCOMP_DATA_SIZE];
+    size_t max, arcsize;
+    int numch, count, skipped;
+    z_stream zs;
+    int zret;
+
+    file_out_offset = 0;
+    file_out_archive = 0;
+    max = atoi(g_arim_settings.max_file_size);
+    if (max <= 0) {
+        snprintf(linebuf, sizeof(linebuf), "/ERROR File sharing disabled");
+        arim_arq_send_remote(linebuf);
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File batch upload %s failed, file sharing disabled", pattern);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        return 0;
+    }
+    /* split pattern into directory and file name pattern */
+    snprintf(fpath, sizeof(fpath), "%s", pattern);
+    glob = strrchr(fpath, '/');
+    if (glob) {
+        *glob++ = '\0';
+        snprintf(dpath, sizeof(dpath), "%s/%s", g_arim_settings.files_dir, fpath);
+    } else {
+        glob = fpath;
+        snprintf(dpath, sizeof(dpath), "%s", g_arim_settings.files_dir);
+    }
+    /* pack matching files, uncompressed archive must fit the buffer */
+    if (max > sizeof(file_out.data))
+        max = sizeof(file_out.data);
+    arcsize = farc_pack(dpath, glob, arcbuf,
+                        zoption ? sizeof(arcbuf) : max, &count, &skipped);
+    if (!arcsize) {
+        snprintf(linebuf, sizeof(linebuf), "/ERROR File not found");
+        arim_arq_send_remote(linebuf);
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File batch upload %s failed, no files found%s", pattern,
+                             skipped ? " within size limit" : "");
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        return 0;
+    }
+    numch = snprintf(linebuf, sizeof(linebuf),
+                     "ARQ: File batch upload %s packed %d files %zu bytes, %d skipped",
+                         pattern, count, arcsize, skipped);
+    if (numch >= sizeof(linebuf))
+        ui_truncate_line(linebuf, sizeof(linebuf));
+    bufq_queue_debug_log(linebuf);
+    /* compress whole batch in one pass if -z option invoked */
+    if (zoption) {
+        zs.zalloc = Z_NULL;
+        zs.zfree = Z_NULL;
+        zs.opaque = Z_NULL;
+        zs.avail_in = arcsize;
+        zs.next_in = (Bytef *)arcbuf;
+        zs.avail_out = max;
+        zs.next_out = (Bytef *)file_out.data;
+        zret = zdict_deflate_init(&zs, zoption);
+        if (zret != Z_OK) {
+            snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot open file");
+            arim_arq_send_remote(linebuf);
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File batch upload %s failed, compression init error", pattern);
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            return 0;
+        }
+        zret = deflate(&zs, Z_FINISH);
+        deflateEnd(&zs);
+        if (zret != Z_STREAM_END) {
+            snprintf(linebuf, sizeof(linebuf), "/ERROR Compressed file size exceeds limit");
+            arim_arq_send_remote(linebuf);
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File batch upload %s failed, compressed size exceeds limit", pattern);
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            return 0;
+        }
+        file_out.size = zs.total_out;
+    } else {
+        memcpy(file_out.data, arcbuf, arcsize);
+        file_out.size = arcsize;
+    }
     file_out.check = ccitt_crc16(file_out.data, file_out.size);
-    /* enqueue command for TNC */
-    if (destdir)
-        snprintf(databuf, sizeof(databuf), "%s %s %zu %04X > %s",
-                 zoption ? "/FPUT -z" : "/FPUT",
-                     file_out.name, file_out.size, file_out.check, file_out.path);
-    else
-        snprintf(databuf, sizeof(databuf), "%s %s %zu %04X",
-                 zoption ? "/FPUT -z" : "/FPUT",
-                     file_out.name, file_out.size, file_out.check);
-    arim_arq_send_remote(databuf);
-    /* initialize count and start progress meter */
-    file_out_cnt = 0;
-    ui_status_xfer_start(0, file_out.size, STATUS_XFER_DIR_UP);
-    /* initialize file history entry */
-    arim_copy_remote_call(remote_call, sizeof(remote_call));
-    numch = snprintf(linebuf, MAX_FTABLE_ROW_SIZE,
-             "O%c%-12s%6zu%04X%s", zoption ? 'Z' : ' ',
-                 remote_call, file_out.size, file_out.check, fpath);
-    if (numch >= MAX_FTABLE_ROW_SIZE)
-        ui_truncate_line(linebuf, MAX_FTABLE_ROW_SIZE);
-    bufq_queue_ftable(linebuf);
-    return 1;
+    file_out.stream = NULL;
+    file_out_archive = 1;
+    return arim_arq_files_start_upload(pattern, destdir);
 }
 
 int arim_arq_files_on_send_cmd()
@@ -922,6 +1144,7 @@ int arim_arq_files_on_send_cmd()
     pthread_mutex_lock(&mutex_file_out);
     fileq_push(&g_file_out_q, &file_out);
     pthread_mutex_unlock(&mutex_file_out);
+    bufq_notify(&g_data_out_notify);
     numch = snprintf(linebuf, sizeof(linebuf),
                      "ARQ: File upload %s buffered for sending", file_out.name);
     if (numch >= sizeof(linebuf))
@@ -931,6 +1154,35 @@ int arim_arq_files_on_send_cmd()
     return 1;
 }
 
+void arim_arq_files_on_resume(const char *cmd)
+{
+    char linebuf[MAX_LOG_LINE_SIZE];
+    const char *s;
+    size_t offset;
+    int numch;
+
+    /* called when remote station sends /OK in reply to our /FPUT,
+       '/OK -r:offset' means it holds the start of a streamed file */
+    s = strstr(cmd, "-r:");
+    if (!s || !file_out.stream || file_out_offset ||
+        1 != sscanf(s + 3, "%zu", &offset) || !offset || offset >= file_out.size)
+        return;
+    if (!fstream_skip(file_out.stream, offset)) {
+        /* data thread will pad the stream, remote rejects the checksum */
+        fstream_close(file_out.stream);
+        return;
+    }
+    file_out_offset = offset;
+    file_out.size -= offset;
+    ui_status_xfer_start(0, file_out.size, STATUS_XFER_DIR_UP);
+    numch = snprintf(linebuf, sizeof(linebuf),
+                     "ARQ: File upload %s resuming at %zu of %zu bytes",
+                         file_out.name, file_out_offset, file_out_offset + file_out.size);
+    if (numch >= sizeof(linebuf))
+        ui_truncate_line(linebuf, sizeof(linebuf));
+    bufq_queue_debug_log(linebuf);
+}
+
 size_t arim_arq_files_on_send_buffer(size_t size)
 {
     static int prev_size = -1, prev_file_out_cnt = 0;
@@ -954,12 +1206,14 @@ size_t arim_arq_files_on_send_buffer(size_t size)
         prev_file_out_cnt = file_out_cnt;
         numch = snprintf(linebuf, sizeof(linebuf),
                          "ARQ: File upload %s sending %zu of %zu bytes",
-                            file_out.name, file_out_cnt, file_out.size);
+                            file_out.name, file_out_offset + file_out_cnt,
+                                file_out_offset + file_out.size);
         if (numch >= sizeof(linebuf))
             ui_truncate_line(linebuf, sizeof(linebuf));
         bufq_queue_debug_log(linebuf);
         numch = snprintf(linebuf, sizeof(linebuf), "<< [@] %s %zu of %zu bytes",
-                         file_out.name, file_out_cnt, file_out.size);
+                         file_out.name, file_out_offset + file_out_cnt,
+                             file_out_offset + file_out.size);
         if (numch >= sizeof(linebuf))
             ui_truncate_line(linebuf, sizeof(linebuf));
         bufq_queue_traffic_log(linebuf);
@@ -968,6 +1222,8 @@ size_t arim_arq_files_on_send_buffer(size_t size)
         ui_status_xfer_update(file_out_cnt);
         /* if done, re-arm for next upload */
         if (file_out_cnt == file_out.size) {
+            if (file_out.stream)
+                fstream_close(file_out.stream);
             send_done = 1;
             prev_size = -1;
             prev_file_out_cnt = 0;
@@ -977,35 +1233,57 @@ size_t arim_arq_files_on_send_buffer(size_t size)
     return 1;
 }
 
-int arim_arq_files_on_rcv_frame(const char *data, size_t size)
+int arim_arq_files_open_dest_dir(char *dpath, size_t size)
 {
-    FILE *fp;
     DIR *dirp;
-    char fpath[MAX_PATH_SIZE*2], dpath[MAX_PATH_SIZE];
-    char linebuf[MAX_LOG_LINE_SIZE], databuf[MIN_DATA_BUF_SIZE];
-    char remote_call[TNC_MYCALL_SIZE];
+    char fpath[MAX_PATH_SIZE*2], linebuf[MAX_LOG_LINE_SIZE];
     int numch;
-    unsigned int check;
-    z_stream zs;
-    char zbuffer[MAX_UNCOMP_DATA_SIZE];
-    int zret;
 
-    /* buffer data, increment count of bytes */
-    if (file_in_cnt + size > sizeof(file_in.data)) {
-        /* overflow */
+    /* make sure access to directory is allowed */
+    snprintf(dpath, size, "%s/%s", g_arim_settings.files_dir, file_in.path);
+    snprintf(fpath, sizeof(fpath), "%s/%s", g_arim_settings.files_dir, DEFAULT_DOWNLOAD_DIR);
+    if ((strstr(file_in.path, "..") || strstr(file_in.name, "..")) ||
+        (strcmp(dpath, fpath) &&
+        !ini_check_add_files_dir(dpath) &&
+        !ini_check_ac_files_dir(dpath))) {
         numch = snprintf(linebuf, sizeof(linebuf),
-                         "ARQ: File download %s failed, buffer overflow %zu",
-                             file_in.name, file_in_cnt + size);
+                         "ARQ: File download %s failed, directory %s not accessible",
+                              file_in.name, dpath);
         if (numch >= sizeof(linebuf))
             ui_truncate_line(linebuf, sizeof(linebuf));
         bufq_queue_debug_log(linebuf);
-        snprintf(linebuf, sizeof(linebuf), "/ERROR Buffer overflow");
+        snprintf(linebuf, sizeof(linebuf), "/ERROR Directory not accessible");
         arim_arq_send_remote(linebuf);
         arim_on_event(EV_ARQ_FILE_ERROR, 0);
         return 0;
     }
-    memcpy(file_in.data + file_in_cnt, data, size);
-    file_in_cnt += size;
+    dirp = opendir(dpath);
+    if (!dirp) {
+        /* if directory not found, try to create it */
+        if (errno == ENOENT &&
+            mkdir(dpath, S_IRWXU|S_IRWXG|S_IROTH|S_IXOTH) == -1) {
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File download %s failed, cannot open directory %s",
+                                 file_in.name, dpath);
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot open directory");
+            arim_arq_send_remote(linebuf);
+            arim_on_event(EV_ARQ_FILE_ERROR, 0);
+            return 0;
+        }
+    } else {
+        closedir(dirp);
+    }
+    return 1;
+}
+
+void arim_arq_files_on_rcv_progress()
+{
+    char linebuf[MAX_LOG_LINE_SIZE];
+    int numch;
+
     numch = snprintf(linebuf, sizeof(linebuf),
                      "ARQ: File download %s reading %zu of %zu bytes",
                          file_in.name, file_in_cnt, file_in.size);
@@ -1021,6 +1299,141 @@ int arim_arq_files_on_rcv_frame(const char *data, size_t size)
     /* update progress meter */
     ui_status_xfer_update(file_in_cnt);
     arim_on_event(EV_ARQ_FILE_RCV_FRAME, 0);
+}
+
+void arim_arq_files_on_rcv_done(unsigned int check)
+{
+    char linebuf[MAX_LOG_LINE_SIZE], databuf[MIN_DATA_BUF_SIZE];
+    char remote_call[TNC_MYCALL_SIZE];
+    int numch;
+
+    numch = snprintf(linebuf, sizeof(linebuf),
+                     "ARQ: Saved %s file %s %zu bytes, checksum %04X",
+                           zoption ? "compressed" : "uncompressed",
+                               file_in.name, file_in_cnt, check);
+    if (numch >= sizeof(linebuf))
+        ui_truncate_line(linebuf, sizeof(linebuf));
+    bufq_queue_debug_log(linebuf);
+    snprintf(databuf, sizeof(databuf),
+             "/OK %s %zu %04X saved", file_in.name, file_in_cnt, check);
+    arim_arq_send_remote(databuf);
+    arim_on_event(EV_ARQ_FILE_RCV_DONE, 0);
+    /* update file history list */
+    arim_copy_remote_call(remote_call, sizeof(remote_call));
+    numch = snprintf(linebuf, MAX_FTABLE_ROW_SIZE,
+             "I%c%-12s%6zu%04X%s/%s", zoption ? 'Z' : ' ',
+                 remote_call, file_in.size, file_in.check, file_in.path, file_in.name);
+    if (numch >= MAX_FTABLE_ROW_SIZE)
+        ui_truncate_line(linebuf, MAX_FTABLE_ROW_SIZE);
+    bufq_queue_ftable(linebuf);
+}
+
+int arim_arq_files_on_rcv_stream(const char *data, size_t size)
+{
+    char fpath[MAX_PATH_SIZE*2], dpath[MAX_PATH_SIZE];
+    char linebuf[MAX_LOG_LINE_SIZE];
+    int numch, result;
+    unsigned int check;
+
+    if (!fstream_is_open(&stream_in)) {
+        /* first block of a large file, open destination before writing */
+        if (!arim_arq_files_open_dest_dir(dpath, sizeof(dpath)))
+            return 0;
+        snprintf(fpath, sizeof(fpath), "%s/%s", dpath, file_in.name);
+        if (!fstream_create(&stream_in, fpath, zoption,
+                            file_in.size, file_in.check, file_in_offset)) {
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File download %s failed, file open error", file_in.name);
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot open file");
+            arim_arq_send_remote(linebuf);
+            arim_on_event(EV_ARQ_FILE_ERROR, 0);
+            return 0;
+        }
+    }
+    /* ignore any excess data */
+    if (size > file_in.size - file_in_cnt)
+        size = file_in.size - file_in_cnt;
+    if (!fstream_write(&stream_in, (const unsigned char *)data, size)) {
+        /* what was written so far is kept for a later resume */
+        fstream_close(&stream_in);
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File download %s failed, file write error", file_in.name);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot open file");
+        arim_arq_send_remote(linebuf);
+        arim_on_event(EV_ARQ_FILE_ERROR, 0);
+        return 0;
+    }
+    file_in_cnt += size;
+    arim_arq_files_on_rcv_progress();
+    if (file_in_cnt >= file_in.size) {
+        /* verify checksum over the whole file, partial file is discarded if bad */
+        result = fstream_commit(&stream_in, file_in.check);
+        check = fstream_get_check(&stream_in);
+        if (result == -1) {
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File download %s failed, bad checksum %04X",
+                                 file_in.name, check);
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            snprintf(linebuf, sizeof(linebuf), "/ERROR Bad checksum");
+            arim_arq_send_remote(linebuf);
+            arim_on_event(EV_ARQ_FILE_ERROR, 0);
+            return 0;
+        } else if (result == 0) {
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File download %s failed, %s", file_in.name,
+                                 zoption ? "decompression failed" : "file write error");
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            snprintf(linebuf, sizeof(linebuf), "/ERROR %s",
+                     zoption ? "Decompression failed" : "Cannot open file");
+            arim_arq_send_remote(linebuf);
+            arim_on_event(EV_ARQ_FILE_ERROR, 0);
+            return 0;
+        }
+        arim_arq_files_on_rcv_done(check);
+    }
+    return 1;
+}
+
+int arim_arq_files_on_rcv_frame(const char *data, size_t size)
+{
+    FILE *fp;
+    char fpath[MAX_PATH_SIZE*2], dpath[MAX_PATH_SIZE];
+    char linebuf[MAX_LOG_LINE_SIZE];
+    int numch, count, result;
+    unsigned int check;
+    z_stream zs;
+    char zbuffer[MAX_UNCOMP_DATA_SIZE];
+    int zret;
+
+    if (file_in.size > sizeof(file_in.data))
+        return arim_arq_files_on_rcv_stream(data, size);
+    /* buffer data, increment count of bytes */
+    if (file_in_cnt + size > sizeof(file_in.data)) {
+        /* overflow */
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File download %s failed, buffer overflow %zu",
+                             file_in.name, file_in_cnt + size);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        snprintf(linebuf, sizeof(linebuf), "/ERROR Buffer overflow");
+        arim_arq_send_remote(linebuf);
+        arim_on_event(EV_ARQ_FILE_ERROR, 0);
+        return 0;
+    }
+    memcpy(file_in.data + file_in_cnt, data, size);
+    file_in_cnt += size;
+    arim_arq_files_on_rcv_progress();
     if (file_in_cnt >= file_in.size) {
         /* if excess data, take most recent file_in.size bytes */
         if (file_in_cnt > file_in.size) {
@@ -1043,42 +1456,8 @@ int arim_arq_files_on_rcv_frame(const char *data, size_t size)
             return 0;
         }
         /* make sure access to directory is allowed */
-        snprintf(dpath, sizeof(dpath), "%s/%s", g_arim_settings.files_dir, file_in.path);
-        snprintf(fpath, sizeof(fpath), "%s/%s", g_arim_settings.files_dir, DEFAULT_DOWNLOAD_DIR);
-        if ((strstr(file_in.path, "..") || strstr(file_in.name, "..")) ||
-            (strcmp(dpath, fpath) &&
-            !ini_check_add_files_dir(dpath) &&
-            !ini_check_ac_files_dir(dpath))) {
-            numch = snprintf(linebuf, sizeof(linebuf),
-                             "ARQ: File download %s failed, directory %s not accessible",
-                                  file_in.name, dpath);
-            if (numch >= sizeof(linebuf))
-                ui_truncate_line(linebuf, sizeof(linebuf));
-            bufq_queue_debug_log(linebuf);
-            snprintf(linebuf, sizeof(linebuf), "/ERROR Directory not accessible");
-            arim_arq_send_remote(linebuf);
-            arim_on_event(EV_ARQ_FILE_ERROR, 0);
+        if (!arim_arq_files_open_dest_dir(dpath, sizeof(dpath)))
             return 0;
-        }
-        dirp = opendir(dpath);
-        if (!dirp) {
-            /* if directory not found, try to create it */
-            if (errno == ENOENT &&
-                mkdir(dpath, S_IRWXU|S_IRWXG|S_IROTH|S_IXOTH) == -1) {
-                numch = snprintf(linebuf, sizeof(linebuf),
-                                 "ARQ: File download %s failed, cannot open directory %s",
-                                     file_in.name, dpath);
-                if (numch >= sizeof(linebuf))
-                    ui_truncate_line(linebuf, sizeof(linebuf));
-                bufq_queue_debug_log(linebuf);
-                snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot open directory");
-                arim_arq_send_remote(linebuf);
-                arim_on_event(EV_ARQ_FILE_ERROR, 0);
-                return 0;
-            }
-        } else {
-            closedir(dirp);
-        }
         if (zoption) {
             zs.zalloc = Z_NULL;
             zs.zfree = Z_NULL;
@@ -1089,7 +1468,7 @@ int arim_arq_files_on_rcv_frame(const char *data, size_t size)
             zs.next_out = (Bytef *)zbuffer;
             zret = inflateInit(&zs);
             if (zret == Z_OK) {
-                zret = inflate(&zs, Z_FINISH);
+                zret = zdict_inflate(&zs);
                 inflateEnd(&zs);
                 if (zret != Z_STREAM_END) {
                     numch = snprintf(linebuf, sizeof(linebuf),
@@ -1116,6 +1495,44 @@ int arim_arq_files_on_rcv_frame(const char *data, size_t size)
                 return 0;
             }
         }
+        if (file_in_archive) {
+            /* unpack batch of files from /MFGET into destination dir */
+            result = farc_unpack(zoption ? zbuffer : (char *)file_in.data,
+                                 zoption ? zs.total_out : file_in.size, dpath, &count);
+            if (result == FARC_EXISTS) {
+                /* existing files are never overwritten, nothing written */
+                numch = snprintf(linebuf, sizeof(linebuf),
+                                 "ARQ: File download %s failed, archive file already exists in %s",
+                                     file_in.name, dpath);
+                if (numch >= sizeof(linebuf))
+                    ui_truncate_line(linebuf, sizeof(linebuf));
+                bufq_queue_debug_log(linebuf);
+                snprintf(linebuf, sizeof(linebuf), "/ERROR File exists");
+                arim_arq_send_remote(linebuf);
+                arim_on_event(EV_ARQ_FILE_ERROR, 0);
+                return 0;
+            }
+            if (!result) {
+                numch = snprintf(linebuf, sizeof(linebuf),
+                                 "ARQ: File download %s failed, bad archive after %d files",
+                                     file_in.name, count);
+                if (numch >= sizeof(linebuf))
+                    ui_truncate_line(linebuf, sizeof(linebuf));
+                bufq_queue_debug_log(linebuf);
+                snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot unpack archive");
+                arim_arq_send_remote(linebuf);
+                arim_on_event(EV_ARQ_FILE_ERROR, 0);
+                return 0;
+            }
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File download %s unpacked %d files to %s",
+                                 file_in.name, count, dpath);
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            arim_arq_files_on_rcv_done(check);
+            return 1;
+        }
         /* now write file */
         snprintf(fpath, sizeof(fpath), "%s/%s", dpath, file_in.name);
         fp = fopen(fpath, "w");
@@ -1137,25 +1554,7 @@ int arim_arq_files_on_rcv_frame(const char *data, size_t size)
             return 0;
         }
         /* success */
-        numch = snprintf(linebuf, sizeof(linebuf),
-                         "ARQ: Saved %s file %s %zu bytes, checksum %04X",
-                               zoption ? "compressed" : "uncompressed",
-                                   file_in.name, file_in_cnt, check);
-        if (numch >= sizeof(linebuf))
-            ui_truncate_line(linebuf, sizeof(linebuf));
-        bufq_queue_debug_log(linebuf);
-        snprintf(databuf, sizeof(databuf),
-                 "/OK %s %zu %04X saved", file_in.name, file_in_cnt, check);
-        arim_arq_send_remote(databuf);
-        arim_on_event(EV_ARQ_FILE_RCV_DONE, 0);
-        /* update file history list */
-        arim_copy_remote_call(remote_call, sizeof(remote_call));
-        numch = snprintf(linebuf, MAX_FTABLE_ROW_SIZE,
-                 "I%c%-12s%6zu%04X%s/%s", zoption ? 'Z' : ' ',
-                     remote_call, file_in.size, file_in.check, file_in.path, file_in.name);
-        if (numch >= MAX_FTABLE_ROW_SIZE)
-            ui_truncate_line(linebuf, MAX_FTABLE_ROW_SIZE);
-        bufq_queue_ftable(linebuf);
+        arim_arq_files_on_rcv_done(check);
     }
     return 1;
 }
@@ -1169,6 +1568,7 @@ int arim_arq_files_on_fget(char *cmd, size_t size, char *eol)
 
     zoption = 0;
     p_path = NULL;
+    resume_offset = 0;
     /* empty outbound data buffer before handling file request */
     while (arim_get_buffer_cnt() > 0)
         sleep(1);
@@ -1177,8 +1577,15 @@ int arim_arq_files_on_fget(char *cmd, size_t size, char *eol)
     while (*s && *s == ' ')
         ++s;
     if (*s && (s == strstr(s, "-z"))) {
-        zoption = 1;
-        s += 2;
+        s += zdict_parse_opt(s, &zoption);
+        while (*s && *s == ' ')
+            ++s;
+    }
+    if (*s && (s == strstr(s, "-r:"))) {
+        /* remote holds part of this file, '-r:offset:checksum' */
+        if (2 != sscanf(s + 3, "%zu:%x", &resume_offset, &resume_check))
+            resume_offset = 0;
+        s += strcspn(s, " ");
         while (*s && *s == ' ')
             ++s;
     }
@@ -1277,22 +1684,153 @@ int arim_arq_files_on_fget(char *cmd, size_t size, char *eol)
     return 1;
 }
 
+int arim_arq_files_on_mfget(char *cmd, size_t size, char *eol)
+{
+    char *p_name, *p_path, *s, *e;
+    char linebuf[MAX_LOG_LINE_SIZE], remote_call[TNC_MYCALL_SIZE];
+    char dpath[MAX_PATH_SIZE], add_file_dir[MAX_DIR_PATH_SIZE];
+    int numch, result;
+
+    zoption = 0;
+    p_path = NULL;
+    /* empty outbound data buffer before handling file request */
+    while (arim_get_buffer_cnt() > 0)
+        sleep(1);
+    /* parse the parameters */
+    s = cmd + 7;
+    while (*s && *s == ' ')
+        ++s;
+    if (*s && (s == strstr(s, "-z"))) {
+        s += zdict_parse_opt(s, &zoption);
+        while (*s && *s == ' ')
+            ++s;
+    }
+    p_name = s;
+    if (!*p_name || !eol) {
+        snprintf(linebuf, sizeof(linebuf), "ARQ: Bad /MFGET file pattern parameter");
+        bufq_queue_debug_log(linebuf);
+        snprintf(linebuf, sizeof(linebuf), "/ERROR File not found");
+        arim_arq_send_remote(linebuf);
+        arim_on_event(EV_ARQ_FILE_ERROR, 0);
+        return 1;
+    }
+    /* trim trailing spaces */
+    e = eol - 1;
+    while (e > p_name && (*e == ' ' || *e == '\0')) {
+        *e = '\0';
+        --e;
+    }
+    /* check for destination dir argument */
+    s = strchr(p_name, '>');
+    if (s) {
+        *s++ = '\0';
+        while (*s && (*s == ' ' || *s == '/'))
+            ++s;
+        p_path = *s ? s : NULL;
+    }
+    e = p_name + strlen(p_name);
+    while (e > p_name && *(e - 1) == ' ')
+        *--e = '\0';
+    if (!*p_name || strstr(p_name, "..")) {
+        /* prevent directory traversal */
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File batch upload %s failed, bad file pattern", p_name);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        snprintf(linebuf, sizeof(linebuf), "/ERROR Bad file name");
+        arim_arq_send_remote(linebuf);
+        arim_on_event(EV_ARQ_FILE_ERROR, 0);
+        return 0;
+    }
+    /* check for directory component in pattern */
+    snprintf(add_file_dir, sizeof(add_file_dir), "%s", p_name);
+    e = strrchr(add_file_dir, '/');
+    if (e) {
+        *e = '\0';
+        snprintf(dpath, sizeof(dpath), "%s/%s", g_arim_settings.files_dir, add_file_dir);
+        if (!ini_check_ac_files_dir(dpath) && !ini_check_add_files_dir(dpath)) {
+            /* directory not found */
+            numch = snprintf(linebuf, sizeof(linebuf),
+                             "ARQ: File batch upload %s failed, directory not found", p_name);
+            if (numch >= sizeof(linebuf))
+                ui_truncate_line(linebuf, sizeof(linebuf));
+            bufq_queue_debug_log(linebuf);
+            snprintf(linebuf, sizeof(linebuf), "/ERROR File not found");
+            arim_arq_send_remote(linebuf);
+            arim_on_event(EV_ARQ_FILE_ERROR, 0);
+            return 0;
+        }
+        /* check to see if this is an access controlled dir */
+        if (ini_check_ac_files_dir(dpath) && !arim_arq_auth_get_status()) {
+            /* auth required, send /A1 challenge */
+            arim_copy_remote_call(remote_call, sizeof(remote_call));
+            if (arim_arq_auth_on_send_a1(remote_call, "MFGET", p_name)) {
+                arim_on_event(EV_ARQ_AUTH_SEND_CMD, 1);
+            } else {
+                /* no access for remote call, send /EAUTH response */
+                snprintf(linebuf, sizeof(linebuf), "/EAUTH");
+                arim_arq_send_remote(linebuf);
+            }
+            return 1;
+        }
+    }
+    result = arim_arq_files_send_archive(p_name, p_path);
+    if (result == 1)
+        arim_on_event(EV_ARQ_FILE_SEND_CMD, 0);
+    else
+        arim_on_event(EV_ARQ_FILE_ERROR, 0);
+    return 1;
+}
+
+void arim_arq_files_send_ok()
+{
+    char linebuf[MAX_LOG_LINE_SIZE];
+
+    /* accept /FPUT, asking for the rest of a partial file if we have one */
+    if (file_in_offset)
+        snprintf(linebuf, sizeof(linebuf), "/OK -r:%zu", file_in_offset);
+    else
+        snprintf(linebuf, sizeof(linebuf), "/OK");
+    arim_arq_send_remote(linebuf);
+}
+
 int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role)
 {
     char *p_check, *p_name, *p_path, *p_size, *s, *e;
     char linebuf[MAX_LOG_LINE_SIZE], remote_call[TNC_MYCALL_SIZE];
-    char dpath[MAX_PATH_SIZE];
-    int numch;
+    char dpath[MAX_PATH_SIZE], fpath[MAX_PATH_SIZE*2];
+    size_t offset, fsize;
+    unsigned int check;
+    int numch, resume, zopt;
 
-    zoption = 0;
+    zoption = resume = file_in_archive = 0;
+    /* close partial file left over from an interrupted download, it
+       stays on disk and the next download of this file may resume it */
+    fstream_close(&stream_in);
+    file_in_offset = offset = 0;
     /* inbound file transfer, get parameters */
     p_size = p_check = p_path = NULL;
     s = cmd + 6;
     while (*s && *s == ' ')
         ++s;
     if (*s && (s == strstr(s, "-z"))) {
-        zoption = 1;
-        s += 2;
+        s += zdict_parse_opt(s, &zoption);
+        while (*s && *s == ' ')
+            ++s;
+    }
+    if (*s && (s == strstr(s, "-a"))) {
+        /* file is an archive sent in reply to /MFGET */
+        file_in_archive = 1;
+        s += strcspn(s, " ");
+        while (*s && *s == ' ')
+            ++s;
+    } else if (*s && (s == strstr(s, "-r"))) {
+        /* sender can resume, or is resuming at '-r:offset' */
+        resume = 1;
+        if (s[2] == ':' && 1 != sscanf(s + 3, "%zu", &offset))
+            offset = 0;
+        s += strcspn(s, " ");
         while (*s && *s == ' ')
             ++s;
     }
@@ -1359,6 +1897,54 @@ int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role)
             file_in.size = atoi(p_size);
             if (1 != sscanf(p_check, "%x", &file_in.check))
                 file_in.check = 0;
+            if (file_in.size > sizeof(file_in.data) &&
+                (file_in_archive ||
+                 file_in.size > (size_t)atoi(g_arim_settings.max_arq_file_size))) {
+                /* too large to buffer and streaming not allowed for this size */
+                numch = snprintf(linebuf, sizeof(linebuf),
+                                 "ARQ: File download %s failed, size %zu exceeds limit",
+                                     file_in.name, file_in.size);
+                if (numch >= sizeof(linebuf))
+                    ui_truncate_line(linebuf, sizeof(linebuf));
+                bufq_queue_debug_log(linebuf);
+                snprintf(linebuf, sizeof(linebuf), "/ERROR File size exceeds limit");
+                arim_arq_send_remote(linebuf);
+                arim_on_event(EV_ARQ_FILE_ERROR, 0);
+                return 0;
+            }
+            if (resume && file_in.size > sizeof(file_in.data) &&
+                !strstr(file_in.path, "..") && !strstr(file_in.name, "..")) {
+                /* look for a matching partial file from an earlier session */
+                snprintf(fpath, sizeof(fpath), "%s/%s/%s",
+                         g_arim_settings.files_dir, file_in.path, file_in.name);
+                file_in_offset = fstream_checkpoint(fpath, &zopt, &fsize, &check);
+                if (zopt != zoption || fsize != file_in.size || check != file_in.check)
+                    file_in_offset = 0;
+                if (arq_cs_role == ARQ_CLIENT_STN && offset && file_in_offset < offset)
+                    file_in_offset = 0; /* sender skipped data we don't have */
+                else if (arq_cs_role == ARQ_CLIENT_STN)
+                    file_in_offset = offset;
+            }
+            if (offset && file_in_offset != offset) {
+                numch = snprintf(linebuf, sizeof(linebuf),
+                                 "ARQ: File download %s failed, cannot resume at %zu",
+                                     file_in.name, offset);
+                if (numch >= sizeof(linebuf))
+                    ui_truncate_line(linebuf, sizeof(linebuf));
+                bufq_queue_debug_log(linebuf);
+                snprintf(linebuf, sizeof(linebuf), "/ERROR Cannot resume file");
+                arim_arq_send_remote(linebuf);
+                arim_on_event(EV_ARQ_FILE_ERROR, 0);
+                return 0;
+            }
+            if (file_in_offset) {
+                numch = snprintf(linebuf, sizeof(linebuf),
+                                 "ARQ: File download %s resuming at %zu of %zu bytes",
+                                     file_in.name, file_in_offset, file_in.size);
+                if (numch >= sizeof(linebuf))
+                    ui_truncate_line(linebuf, sizeof(linebuf));
+                bufq_queue_debug_log(linebuf);
+            }
             if (arq_cs_role == ARQ_SERVER_STN) {
                 if (p_path) {
                     snprintf(dpath, sizeof(dpath), "%s/%s", g_arim_settings.files_dir, p_path);
@@ -1387,8 +1973,7 @@ int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role)
                         }
                     } else {
                         /* no auth required or session previously authenticated */
-                        snprintf(linebuf, sizeof(linebuf), "/OK");
-                        arim_arq_send_remote(linebuf);
+                        arim_arq_files_send_ok();
                         arim_on_event(EV_ARQ_FILE_RCV_WAIT_OK, 0);
                         numch = snprintf(linebuf, sizeof(linebuf),
                                          "ARQ: File download %s to %s %zu %04X sending OK",
@@ -1397,15 +1982,14 @@ int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role)
                             ui_truncate_line(linebuf, sizeof(linebuf));
                         bufq_queue_debug_log(linebuf);
                         /* initialize count and start progress meter */
-                        file_in_cnt = 0;
-                        ui_status_xfer_start(0, file_in.size, STATUS_XFER_DIR_DOWN);
+                        file_in_cnt = file_in_offset;
+                        ui_status_xfer_start(file_in_offset, file_in.size, STATUS_XFER_DIR_DOWN);
                         /* start timer for file history list */
                         bufq_queue_ftable("S");
                     }
                 } else {
                     /* file located in root shared file dir */
-                    snprintf(linebuf, sizeof(linebuf), "/OK");
-                    arim_arq_send_remote(linebuf);
+                    arim_arq_files_send_ok();
                     arim_on_event(EV_ARQ_FILE_RCV_WAIT_OK, 0);
                     numch = snprintf(linebuf, sizeof(linebuf),
                                      "ARQ: File download %s to %s %zu %04X sending OK",
@@ -1414,8 +1998,8 @@ int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role)
                         ui_truncate_line(linebuf, sizeof(linebuf));
                     bufq_queue_debug_log(linebuf);
                     /* initialize count and start progress meter */
-                    file_in_cnt = 0;
-                    ui_status_xfer_start(0, file_in.size, STATUS_XFER_DIR_DOWN);
+                    file_in_cnt = file_in_offset;
+                    ui_status_xfer_start(file_in_offset, file_in.size, STATUS_XFER_DIR_DOWN);
                     /* start timer for file history list */
                     bufq_queue_ftable("S");
                 }
@@ -1429,8 +2013,8 @@ int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role)
                     ui_truncate_line(linebuf, sizeof(linebuf));
                 bufq_queue_debug_log(linebuf);
                 /* initialize count and start progress meter */
-                file_in_cnt = 0;
-                ui_status_xfer_start(0, file_in.size, STATUS_XFER_DIR_DOWN);
+                file_in_cnt = file_in_offset;
+                ui_status_xfer_start(file_in_offset, file_in.size, STATUS_XFER_DIR_DOWN);
                 /* cache any data remaining */
                 if ((cmd + size) > eol) {
                     arim_arq_files_on_rcv_frame(eol, size - (eol - cmd));
@@ -1462,10 +2046,13 @@ int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role)
 int arim_arq_files_on_client_fget(const char *cmd, const char *fn, const char *destdir, int use_zoption)
 {
     /* called from cmd processor when user issues /FGET at prompt */
-    char linebuf[MAX_LOG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE];
-    char *e, *f;
-    size_t len;
+    char linebuf[MAX_LOG_LINE_SIZE], rcmd[MAX_CMD_SIZE];
+    char fpath[MAX_PATH_SIZE], dpath[MAX_DIR_PATH_SIZE], ppath[MAX_PATH_SIZE*2];
+    char *e, *f, *d;
+    const char *s;
+    size_t len, offset, size;
+    unsigned int check;
+    int zopt, numch;
 
     snprintf(fpath, sizeof(fpath), "%s", fn);
     /* replace stray '>' characters in file name string */
@@ -1493,6 +2080,66 @@ int arim_arq_files_on_client_fget(const char *cmd, const char *fn, const char *d
         return 0;
     }
     arim_arq_auth_set_ha2_info("FGET", f);
+    /* ask to resume if part of this file is left from an earlier session */
+    snprintf(dpath, sizeof(dpath), "%s", destdir ? destdir : "");
+    d = dpath;
+    while (*d && (*d == ' ' || *d == '/'))
+        ++d;
+    e = d + strlen(d);
+    while (e > d && *(e - 1) == ' ')
+        *--e = '\0';
+    snprintf(ppath, sizeof(ppath), "%s/%s/%s", g_arim_settings.files_dir,
+             *d ? d : DEFAULT_DOWNLOAD_DIR, basename(f));
+    offset = fstream_checkpoint(ppath, &zopt, &size, &check);
+    if (offset && zopt == use_zoption) {
+        /* insert '-r:offset:checksum' after the compression option */
+        s = cmd + 5;
+        while (*s && *s == ' ')
+            ++s;
+        if (s == strstr(s, "-z")) {
+            s += strcspn(s, " ");
+            while (*s && *s == ' ')
+                ++s;
+        }
+        snprintf(rcmd, sizeof(rcmd), "/FGET%s -r:%zu:%04X %s",
+                 zdict_opt_str(use_zoption), offset, check, s);
+        cmd = rcmd;
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ARQ: File download %s asking to resume at %zu of %zu bytes",
+                             basename(f), offset, size);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+    }
+    arim_arq_send_remote(cmd);
+    arim_on_event(EV_ARQ_FILE_RCV_WAIT, 0);
+    return 1;
+}
+
+int arim_arq_files_on_client_mfget(const char *cmd, const char *pattern, const char *destdir, int use_zoption)
+{
+    /* called from cmd processor when user issues /MFGET at prompt */
+    char linebuf[MAX_LOG_LINE_SIZE];
+    char fpath[MAX_PATH_SIZE];
+    char *e, *f;
+
+    snprintf(fpath, sizeof(fpath), "%s", pattern);
+    /* trim leading and trailing spaces */
+    f = fpath;
+    while (*f && *f == ' ')
+        ++f;
+    e = f + strlen(f);
+    while (e > f && *(e - 1) == ' ')
+        *--e = '\0';
+    if (!strlen(f)) {
+        ui_show_dialog("\tCannot get files:\n"
+                       "\tbad file name pattern.\n \n\t[O]k", "oO \n");
+        snprintf(linebuf, sizeof(linebuf),
+                 "ARQ: File batch download failed, bad file name pattern");
+        bufq_queue_debug_log(linebuf);
+        return 0;
+    }
+    arim_arq_auth_set_ha2_info("MFGET", f);
     arim_arq_send_remote(cmd);
     arim_on_event(EV_ARQ_FILE_RCV_WAIT, 0);
     return 1;
@@ -25,11 +25,14 @@
 #define _ARIM_ARQ_FILES_H_INCLUDED_
 
 extern int arim_arq_files_on_send_cmd(void);
+extern void arim_arq_files_on_resume(const char *cmd);
 extern int arim_arq_files_on_fput(char *cmd, size_t size, char *eol, int arq_cs_role);
 extern int arim_arq_files_on_fget(char *cmd, size_t size, char *eol);
+extern int arim_arq_files_on_mfget(char *cmd, size_t size, char *eol);
 extern int arim_arq_files_on_flput(char *cmd, size_t size, char *eol);
 extern int arim_arq_files_on_flget(char *cmd, size_t size, char *eol);
 extern int arim_arq_files_on_client_fget(const char *cmd, const char *fn, const char *destdir, int use_zoption);
+extern int arim_arq_files_on_client_mfget(const char *cmd, const char *pattern, const char *destdir, int use_zoption);
 extern int arim_arq_files_on_client_fput(const char *fn, const char *destdir, int use_zoption);
 extern int arim_arq_files_on_client_flget(const char *cmd, const char *destdir, int use_zoption);
 extern int arim_arq_files_on_client_flist(const char *cmd);
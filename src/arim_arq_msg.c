@@ -37,6 +37,7 @@
 #include "log.h"
 #include "mbox.h"
 #include "zlib.h"
+#include "zdict.h"
 #include "datathread.h"
 #include "arim_arq.h"
 #include "arim_arq_auth.h"
@@ -46,7 +47,7 @@
 static MSGQUEUEITEM msg_in;
 static MSGQUEUEITEM msg_out;
 static size_t msg_in_cnt, msg_out_cnt;
-static char headers[MAX_MGET_HEADERS][MAX_MBOX_HDR_SIZE];
+static char headers[MAX_MGET_HEADERS][MAX_MBOX_HDR_SIZE+1];
 static int zoption, num_msgs, next_msg, send_done;
 
 int arim_arq_msg_on_send_cmd(const char *data, int use_zoption)
@@ -65,7 +66,7 @@ int arim_arq_msg_on_send_cmd(const char *data, int use_zoption)
         zs.next_in = (Bytef *)data;
         zs.avail_out = sizeof(msg_out.data);
         zs.next_out = (Bytef *)msg_out.data;
-        zret = deflateInit(&zs, Z_BEST_COMPRESSION);
+        zret = zdict_deflate_init(&zs, zoption);
         if (zret == Z_OK) {
             zret = deflate(&zs, Z_FINISH);
             deflateEnd(&zs);
@@ -94,7 +95,7 @@ int arim_arq_msg_on_send_cmd(const char *data, int use_zoption)
     arim_copy_remote_call(msg_out.call, sizeof(msg_out.call));
     /* enqueue command for TNC */
     snprintf(linebuf, sizeof(linebuf),
-        "%s %s %zu %04X", zoption ? "/MPUT -z" : "/MPUT",
+        "/MPUT%s %s %zu %04X", zdict_opt_str(zoption),
             msg_out.call, msg_out.size, msg_out.check);
     arim_arq_send_remote(linebuf);
     /* initialize count and start progress meter */
@@ -112,6 +113,7 @@ int arim_arq_msg_on_send_msg()
     pthread_mutex_lock(&mutex_msg_out);
     msgq_push(&g_msg_out_q, &msg_out);
     pthread_mutex_unlock(&mutex_msg_out);
+    bufq_notify(&g_data_out_notify);
     snprintf(linebuf, sizeof(linebuf), "ARQ: Message upload buffered for sending");
     bufq_queue_debug_log(linebuf);
     send_done = 0;
@@ -223,7 +225,7 @@ int arim_arq_msg_on_rcv_frame(const char *data, size_t size)
             zs.next_out = (Bytef *)zbuffer;
             zret = inflateInit(&zs);
             if (zret == Z_OK) {
-                zret = inflate(&zs, Z_FINISH);
+                zret = zdict_inflate(&zs);
                 inflateEnd(&zs);
                 if (zret != Z_STREAM_END) {
                     snprintf(linebuf, sizeof(linebuf),
@@ -263,9 +265,7 @@ int arim_arq_msg_on_rcv_frame(const char *data, size_t size)
             return 0;
         }
         /* add message header to recents list */
-        pthread_mutex_lock(&mutex_recents);
         cmdq_push(&g_recents_q, hdr);
-        pthread_mutex_unlock(&mutex_recents);
         snprintf(linebuf, sizeof(linebuf),
             "ARQ: Saved %s message %zu bytes, checksum %04X",
                zoption ? "compressed" : "uncompressed",  msg_in_cnt, check);
@@ -369,8 +369,7 @@ int arim_arq_msg_on_mget(char *cmd, size_t size, char *eol)
     while (*s && *s == ' ')
         ++s;
     if (*s && (s == strstr(s, "-z"))) {
-        zoption = 1;
-        s += 2;
+        s += zdict_parse_opt(s, &zoption);
         while (*s && *s == ' ')
             ++s;
     }
@@ -418,8 +417,7 @@ int arim_arq_msg_on_mput(char *cmd, size_t size, char *eol)
     while (*e && *e == ' ')
         ++e;
     if (*e && (e == strstr(e, "-z"))) {
-        zoption = 1;
-        e += 2;
+        e += zdict_parse_opt(e, &zoption);
         while (*e && *e == ' ')
             ++e;
     }
@@ -495,7 +493,7 @@ int arim_arq_msg_on_ok()
         zs.next_out = (Bytef *)zbuffer;
         zret = inflateInit(&zs);
         if (zret == Z_OK) {
-            zret = inflate(&zs, Z_FINISH);
+            zret = zdict_inflate(&zs);
             inflateEnd(&zs);
             if (zret != Z_STREAM_END) {
                 snprintf(linebuf, sizeof(linebuf),
@@ -191,9 +191,7 @@ int arim_recv_msg(const char *fm_call, const char *to_call,
             /* good checksum, store message into mbox, add to recents */
             hdr = mbox_add_msg(MBOX_INBOX_FNAME, fm_call, to_call, check, msg, 1);
             if (hdr != NULL) {
-                pthread_mutex_lock(&mutex_recents);
                 cmdq_push(&g_recents_q, hdr);
-                pthread_mutex_unlock(&mutex_recents);
             }
             if (is_netcall) {
                 snprintf(buffer, sizeof(buffer), "6[M] %-10s ", fm_call);
@@ -50,6 +50,7 @@
 #include "mbox.h"
 #include "tnc_attach.h"
 #include "datathread.h"
+#include "trace.h"
 
 pthread_mutex_t mutex_arim_state = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_send_repeats = PTHREAD_MUTEX_INITIALIZER;
@@ -435,6 +436,7 @@ int arim_get_state()
 void arim_set_state(int newstate)
 {
     char buffer[TNC_LISTEN_SIZE], cmd[MAX_CMD_SIZE];
+    int prevstate;
 
     if (newstate == ST_IDLE) {
         bufq_queue_cmd_out("PROTOCOLMODE FEC");
@@ -443,8 +445,14 @@ void arim_set_state(int newstate)
         bufq_queue_cmd_out(cmd);
     }
     pthread_mutex_lock(&mutex_arim_state);
+    prevstate = arim_state;
     arim_state = newstate;
     pthread_mutex_unlock(&mutex_arim_state);
+    trace_set_state(newstate);
+    if (newstate == ST_IDLE && prevstate != ST_IDLE) {
+        /* exchange done, good time to reclaim deleted message space */
+        mbox_on_idle();
+    }
 }
 
 void arim_reset_msg_rpt_state()
@@ -740,6 +748,7 @@ void arim_on_event(int event, int param)
     }
     next_state = arim_get_state();
     if (event != EV_PERIODIC || prev_state != next_state) {
+        trace_event(event, param, prev_state);
         snprintf(buffer, sizeof(buffer),
             "ARIM: Event %s, Param %d, State %s==>%s",
                 events[event], param, states[prev_state], states[next_state]);
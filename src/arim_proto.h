@@ -69,6 +69,7 @@
 #define ST_ARQ_FLIST_RCV                39
 #define ST_ARQ_FLIST_SEND_WAIT          40
 #define ST_ARQ_FLIST_SEND               41
+#define ST_NUM_STATES                   42
 
 #define EV_NULL                         0
 #define EV_PERIODIC                     1
@@ -133,9 +134,13 @@
 #define EV_ARQ_FLIST_RCV_DONE           60
 #define EV_ARQ_FLIST_SEND               61
 #define EV_ARQ_FLIST_SEND_CMD           62
+#define EV_NUM_EVENTS                   63
 
 #define MAX_ACKNAK_SIZE                 50
 
+extern const char *states[];
+extern const char *events[];
+
 extern void arim_on_event(int event, int param);
 extern int arim_is_idle(void);
 extern int arim_get_buffer_cnt(void);
@@ -111,7 +111,8 @@ extern void arim_proto_msg_acknak_pend(int event, int param)
         /* 1 to 2 second delay for sending ack/nak */
         t = time(NULL);
         if (t > prev_time + 2) {
-            bufq_queue_data_out(msg_acknak_buffer);
+            if (!bufq_queue_data_out(msg_acknak_buffer))
+                break; /* data queue full, try again next time */
             arim_set_state(ST_SEND_ACKNAK_BUF_WAIT);
             ui_set_status_dirty(STATUS_ACKNAK_SEND);
         }
@@ -157,8 +158,9 @@ extern void arim_proto_msg_acknak_wait(int event, int param)
             } else {
                 if (fecmode_downshift)
                     arim_fecmode_downshift();
-                bufq_queue_data_out(msg_buffer);
                 prev_time = t;
+                if (!bufq_queue_data_out(msg_buffer))
+                    break; /* data queue full, counts as a lost repeat */
                 arim_set_state(ST_SEND_MSG_BUF_WAIT);
                 /* start progress meter */
                 ui_status_xfer_start(0, msg_len, STATUS_XFER_DIR_UP);
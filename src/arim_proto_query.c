@@ -92,7 +92,8 @@ void arim_proto_query_resp_pend(int event, int param)
         /* 1 second delay for sending response to query */
         t = time(NULL);
         if (t > prev_time) {
-            bufq_queue_data_out(msg_buffer);
+            if (!bufq_queue_data_out(msg_buffer))
+                break; /* data queue full, try again next time */
             arim_set_state(ST_SEND_RESP_BUF_WAIT);
             ui_set_status_dirty(STATUS_RESP_SEND);
         }
@@ -120,9 +120,7 @@ int arim_recv_response(const char *fm_call, const char *to_call,
             /* good checksum, store message into mbox, add to recents */
             hdr = mbox_add_msg(MBOX_INBOX_FNAME, fm_call, to_call, check, msg, 1);
             if (hdr != NULL) {
-                pthread_mutex_lock(&mutex_recents);
                 cmdq_push(&g_recents_q, hdr);
-                pthread_mutex_unlock(&mutex_recents);
             }
             snprintf(buffer, sizeof(buffer), "3[R] %-10s ", fm_call);
         } else {
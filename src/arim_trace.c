@@ -0,0 +1,176 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+/*  arim-trace: decodes a binary trace dump written by ARIM into text,
+    merging the per-thread records into a single time ordered listing. */
+
+typedef struct trace_item {
+    TRACEREC rec;
+    uint32_t tid;
+} TRACEITEM;
+
+char **read_names(FILE *fp, uint32_t cnt)
+{
+    char **names, buf[256];
+    uint32_t i;
+    size_t len;
+    int ch;
+
+    names = calloc(cnt ? cnt : 1, sizeof(char *));
+    if (!names)
+        return NULL;
+    for (i = 0; i < cnt; i++) {
+        len = 0;
+        while ((ch = fgetc(fp)) != EOF && ch != '\0') {
+            if (len < sizeof(buf) - 1)
+                buf[len++] = ch;
+        }
+        if (ch == EOF)
+            return NULL;
+        buf[len] = '\0';
+        names[i] = strdup(buf);
+    }
+    return names;
+}
+
+const char *lookup_name(char **names, uint32_t cnt, unsigned int idx)
+{
+    return (idx < cnt && names[idx]) ? names[idx] : "?";
+}
+
+int compare_items(const void *a, const void *b)
+{
+    const TRACEITEM *ia = a, *ib = b;
+
+    if (ia->rec.usec < ib->rec.usec)
+        return -1;
+    return ia->rec.usec > ib->rec.usec ? 1 : 0;
+}
+
+void print_item(const TRACEITEM *item, char **events, uint32_t num_events,
+                    char **states, uint32_t num_states)
+{
+    const TRACEREC *rec = &item->rec;
+    time_t t;
+    struct tm tm;
+    char desc[256];
+
+    t = (time_t)(rec->usec / 1000000);
+    gmtime_r(&t, &tm);
+    switch (rec->type) {
+    case TRACE_EVENT:
+        snprintf(desc, sizeof(desc), "%s param %d, state %s==>%s",
+                 lookup_name(events, num_events, rec->id), rec->arg[0],
+                 lookup_name(states, num_states, rec->arg[1]),
+                 lookup_name(states, num_states, rec->state));
+        break;
+    case TRACE_DATA_TX:
+        snprintf(desc, sizeof(desc), "data tx frame %d bytes, item type %d, %d sent",
+                 rec->arg[0], rec->arg[1], rec->arg[2]);
+        break;
+    case TRACE_DATA_TX_WAIT:
+        snprintf(desc, sizeof(desc), "data tx port full at %d of %d bytes",
+                 rec->arg[0], rec->arg[1]);
+        break;
+    case TRACE_DATA_RX:
+        snprintf(desc, sizeof(desc), "data rx %c%c%c frame %d bytes",
+                 (rec->arg[1] >> 16) & 0xFF, (rec->arg[1] >> 8) & 0xFF,
+                 rec->arg[1] & 0xFF, rec->arg[0]);
+        break;
+    case TRACE_TNC_BUFFER:
+        snprintf(desc, sizeof(desc), "tnc BUFFER %d", rec->arg[0]);
+        break;
+    default:
+        snprintf(desc, sizeof(desc), "type %u id %u args %d %d %d %d",
+                 rec->type, rec->id, rec->arg[0], rec->arg[1], rec->arg[2], rec->arg[3]);
+        break;
+    }
+    printf("%04d-%02d-%02d %02d:%02d:%02d.%06u [%5u] %-30s %s\n",
+           tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+           tm.tm_sec, (unsigned int)(rec->usec % 1000000), item->tid,
+           lookup_name(states, num_states, rec->state), desc);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    TRACEHDR hdr;
+    TRACETHR thr;
+    TRACEITEM *items = NULL;
+    char magic[TRACE_MAGIC_SIZE], **events, **states;
+    size_t num_items = 0, i;
+    uint32_t n, j;
+
+    if (argc != 2) {
+        printf("Usage: %s FILE\n"
+               "Decode ARIM binary trace dump FILE to text on stdout.\n", argv[0]);
+        return 1;
+    }
+    fp = fopen(argv[1], "rb");
+    if (!fp) {
+        perror(argv[1]);
+        return 2;
+    }
+    if (fread(magic, sizeof(magic), 1, fp) != 1 ||
+        memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) ||
+        fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.rec_size != sizeof(TRACEREC)) {
+        fprintf(stderr, "%s: not an ARIM trace file\n", argv[1]);
+        fclose(fp);
+        return 3;
+    }
+    events = read_names(fp, hdr.num_events);
+    states = read_names(fp, hdr.num_states);
+    if (!events || !states) {
+        fprintf(stderr, "%s: truncated trace file\n", argv[1]);
+        fclose(fp);
+        return 3;
+    }
+    for (n = 0; n < hdr.num_threads; n++) {
+        if (fread(&thr, sizeof(thr), 1, fp) != 1 || thr.cnt > TRACE_RING_SIZE)
+            break;
+        items = realloc(items, (num_items + thr.cnt) * sizeof(TRACEITEM) + 1);
+        if (!items) {
+            fprintf(stderr, "%s: out of memory\n", argv[0]);
+            fclose(fp);
+            return 4;
+        }
+        for (j = 0; j < thr.cnt; j++) {
+            if (fread(&items[num_items].rec, sizeof(TRACEREC), 1, fp) != 1)
+                break;
+            items[num_items++].tid = thr.tid;
+        }
+    }
+    fclose(fp);
+    qsort(items, num_items, sizeof(TRACEITEM), compare_items);
+    for (i = 0; i < num_items; i++)
+        print_item(&items[i], events, hdr.num_events, states, hdr.num_states);
+    free(items);
+    return 0;
+}
+
@@ -0,0 +1,284 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "main.h"
+#include "zdict.h"
+
+/*  arim-zdict: builds a preset dictionary for the '-zd' compression option
+    from the messages in one or more mailbox files. Lines and words that
+    recur across messages are scored by the number of bytes they could save,
+    the best are kept up to the size limit and written out with the most
+    valuable last, where deflate reaches them with the shortest distance
+    codes. Install the output as the arim-zdict file in the ARIM directory
+    of each station that is to use it. */
+
+#define MIN_LINE_SIZE   8
+#define MAX_LINE_SIZE   128
+#define MIN_WORD_SIZE   3
+#define MAX_WORD_SIZE   32
+#define MAX_TEXT_LINE   4096
+
+typedef struct frag {
+    char *str;
+    size_t len;
+    unsigned int cnt;                   /* number of messages containing it */
+    unsigned int last_msg;              /* last message counted in */
+    double score;
+    int sel;                            /* chosen for the dictionary */
+} FRAG;
+
+static FRAG *frags;
+static size_t frags_cnt, frags_size;
+
+unsigned int hash_str(const char *s, size_t len)
+{
+    unsigned int h = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+int grow_frags()
+{
+    FRAG *old = frags;
+    size_t i, slot, old_size = frags_size;
+
+    frags_size = frags_size ? frags_size * 2 : 65536;
+    frags = calloc(frags_size, sizeof(FRAG));
+    if (!frags)
+        return 0;
+    for (i = 0; i < old_size; i++) {
+        if (!old[i].str)
+            continue;
+        slot = hash_str(old[i].str, old[i].len) & (frags_size - 1);
+        while (frags[slot].str)
+            slot = (slot + 1) & (frags_size - 1);
+        frags[slot] = old[i];
+    }
+    free(old);
+    return 1;
+}
+
+int add_frag(const char *s, size_t len, unsigned int msg)
+{
+    FRAG *f;
+    size_t slot;
+
+    if ((frags_cnt + 1) * 2 > frags_size && !grow_frags())
+        return 0;
+    slot = hash_str(s, len) & (frags_size - 1);
+    while (frags[slot].str) {
+        f = &frags[slot];
+        if (f->len == len && !memcmp(f->str, s, len)) {
+            if (f->last_msg != msg) {
+                f->last_msg = msg;
+                ++f->cnt;
+            }
+            return 1;
+        }
+        slot = (slot + 1) & (frags_size - 1);
+    }
+    f = &frags[slot];
+    f->str = malloc(len);
+    if (!f->str)
+        return 0;
+    memcpy(f->str, s, len);
+    f->len = len;
+    f->cnt = 1;
+    f->last_msg = msg;
+    ++frags_cnt;
+    return 1;
+}
+
+int add_line(const char *line, unsigned int msg)
+{
+    const char *p, *e;
+    size_t len;
+
+    /* the whole line, including its newline */
+    len = strlen(line);
+    if (len >= MIN_LINE_SIZE && len <= MAX_LINE_SIZE && !add_frag(line, len, msg))
+        return 0;
+    /* and each word in it with the space that follows */
+    p = line;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+            ++p;
+        e = p;
+        while (*e && *e != ' ' && *e != '\t' && *e != '\r' && *e != '\n')
+            ++e;
+        len = e - p;
+        if (*e == ' ')
+            ++len;
+        if (len >= MIN_WORD_SIZE && len <= MAX_WORD_SIZE && !add_frag(p, len, msg))
+            return 0;
+        p = e;
+    }
+    return 1;
+}
+
+int read_mbox(const char *fn, unsigned int *msgs)
+{
+    FILE *fp;
+    char line[MAX_TEXT_LINE];
+    const char *p;
+    int in_hdr = 0;
+
+    fp = fopen(fn, "r");
+    if (!fp) {
+        perror(fn);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (!strncmp(line, "From ", 5)) {
+            /* separator line, start of next message */
+            ++(*msgs);
+            in_hdr = 1;
+            continue;
+        }
+        if (!*msgs)
+            continue;
+        if (in_hdr) {
+            /* skip the From: and To: headers, they aren't transmitted */
+            if (!strncmp(line, "From: ", 6) || !strncmp(line, "To: ", 4))
+                continue;
+            in_hdr = 0;
+            if (!strcmp(line, "\n"))
+                continue;
+        }
+        /* undo escaping of body lines that begin with 'From ' */
+        p = line;
+        if (*p == '>') {
+            while (*p == '>')
+                ++p;
+            p = strncmp(p, "From ", 5) ? line : line + 1;
+        }
+        if (!add_line(p, *msgs)) {
+            fclose(fp);
+            fprintf(stderr, "%s: out of memory\n", fn);
+            return 0;
+        }
+    }
+    fclose(fp);
+    return 1;
+}
+
+int compare_frags(const void *a, const void *b)
+{
+    const FRAG *fa = a, *fb = b;
+
+    if (fa->score > fb->score)
+        return -1;
+    return fa->score < fb->score ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    unsigned char *dict;
+    const char *outfn = DEFAULT_ZDICT_FNAME;
+    size_t max = ZDICT_MAX_SIZE, size = 0, i, j, num_sel = 0;
+    unsigned int msgs = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "o:s:h")) != -1) {
+        switch (option) {
+        case 'o':
+            outfn = optarg;
+            break;
+        case 's':
+            max = atoi(optarg);
+            if (max < 256 || max > ZDICT_MAX_SIZE) {
+                fprintf(stderr, "%s: size must be 256 to %d bytes\n", argv[0], ZDICT_MAX_SIZE);
+                return 1;
+            }
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind >= argc) {
+        printf("Usage: %s [-o FILE] [-s SIZE] MBOX...\n"
+               "Build a '-zd' compression dictionary of up to SIZE bytes (default %d)\n"
+               "from the messages in mailbox files MBOX, written to FILE (default %s).\n",
+               argv[0], ZDICT_MAX_SIZE, DEFAULT_ZDICT_FNAME);
+        return 1;
+    }
+    for (; optind < argc; optind++) {
+        if (!read_mbox(argv[optind], &msgs))
+            return 2;
+    }
+    /* pack the table down to strings seen in more than one message */
+    for (i = 0, j = 0; i < frags_size; i++) {
+        if (frags[i].str && frags[i].cnt > 1) {
+            frags[j] = frags[i];
+            frags[j].score = (double)(frags[j].cnt - 1) * frags[j].len;
+            ++j;
+        }
+    }
+    qsort(frags, j, sizeof(FRAG), compare_frags);
+    /* take the best strings that fit */
+    for (i = 0; i < j && size < max; i++) {
+        if (size + frags[i].len <= max) {
+            size += frags[i].len;
+            frags[i].sel = 1;
+            num_sel = i + 1;
+        }
+    }
+    if (!size) {
+        fprintf(stderr, "%s: no repeated text found in %u messages\n", argv[0], msgs);
+        return 3;
+    }
+    dict = malloc(size);
+    if (!dict) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 4;
+    }
+    /* most valuable strings go at the end of the dictionary */
+    size = 0;
+    for (i = num_sel; i > 0; i--) {
+        if (frags[i - 1].sel) {
+            memcpy(dict + size, frags[i - 1].str, frags[i - 1].len);
+            size += frags[i - 1].len;
+        }
+    }
+    fp = fopen(outfn, "wb");
+    if (!fp || fwrite(dict, 1, size, fp) != size || fclose(fp) != 0) {
+        perror(outfn);
+        return 5;
+    }
+    printf("%s: %zu bytes from %u messages, dictionary id %08lX\n", outfn, size, msgs,
+           adler32(adler32(0L, Z_NULL, 0), dict, size));
+    free(dict);
+    return 0;
+}
+
@@ -0,0 +1,214 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "main.h"
+#include "ardop_data.h"
+
+/*  bench-ardop-data: replays a capture of the TNC data port byte stream
+    through the in-place frame decoder in ardop_data.c and reports the
+    decode rate for several socket read sizes. A capture holds the raw
+    bytes the TNC sends on its data port, e.g. as recorded by running
+    'socat -r CAPTURE TCP-LISTEN:8516,reuseaddr TCP:TNC-HOST:8516' and
+    pointing ARIM at port 8516. The -g option writes a synthetic capture
+    instead. Frame handlers outside the decoder are stubbed out here. */
+
+#define DEFAULT_REPLAY_BYTES  (64*1024*1024)
+
+pthread_mutex_t mutex_num_bytes = PTHREAD_MUTEX_INITIALIZER;
+static size_t num_frames;
+
+int arim_test_frame(char *data, size_t size) { return 0; }
+int arim_on_data(char *data, size_t size) { return 0; }
+void arim_on_event(int event, int param) { }
+int arim_get_state() { return 0; }
+void arim_copy_remote_call(char *call, size_t size) { snprintf(call, size, "N0CALL"); }
+int arim_arq_on_data(char *data, size_t size) { return 1; }
+int arim_arq_files_on_rcv_frame(const char *data, size_t size) { return 1; }
+int arim_arq_files_flist_on_rcv_frame(const char *data, size_t size) { return 1; }
+int arim_arq_msg_on_rcv_frame(const char *data, size_t size) { return 1; }
+void bufq_queue_data_in(const char *text) { }
+void bufq_queue_traffic_log(const char *text) { }
+void bufq_queue_debug_log(const char *text) { }
+void bufq_queue_heard(const char *text) { }
+void trace_record(int type, int arg0, int arg1, int arg2) { ++num_frames; }
+
+size_t put_frame(unsigned char *buf, const char *type, const char *text)
+{
+    size_t len;
+
+    len = strlen(type) + strlen(text);
+    buf[0] = (len >> 8) & 0xFF;
+    buf[1] = len & 0xFF;
+    memcpy(buf + 2, type, 3);
+    memcpy(buf + 5, text, len - 3);
+    return len + 2;
+}
+
+int write_capture(const char *fn, size_t size)
+{
+    FILE *fp;
+    unsigned char frame[MIN_DATA_BUF_SIZE];
+    char text[MAX_DATA_SIZE];
+    size_t total = 0, len, i;
+    unsigned int seed = 1;
+
+    fp = fopen(fn, "wb");
+    if (!fp) {
+        perror(fn);
+        return 0;
+    }
+    /* a mix of short ID frames, FEC frames of ARDOP sized payloads
+       and ARQ frames, as seen on a busy channel */
+    while (total < size) {
+        switch (rand_r(&seed) % 4) {
+        case 0:
+            len = put_frame(frame, "IDF", "ID: N0CALL [EM00aa]:");
+            break;
+        case 1:
+            len = 16 + rand_r(&seed) % 240;
+            for (i = 0; i < len; i++)
+                text[i] = ' ' + rand_r(&seed) % 95;
+            text[len] = '\0';
+            len = put_frame(frame, "FEC", text);
+            break;
+        default:
+            len = 64 + rand_r(&seed) % 1024;
+            for (i = 0; i < len; i++)
+                text[i] = ' ' + rand_r(&seed) % 95;
+            text[len] = '\0';
+            len = put_frame(frame, "ARQ", text);
+            break;
+        }
+        if (fwrite(frame, 1, len, fp) != len) {
+            perror(fn);
+            fclose(fp);
+            return 0;
+        }
+        total += len;
+    }
+    if (fclose(fp) != 0) {
+        perror(fn);
+        return 0;
+    }
+    printf("%s: wrote %zu bytes of synthetic data port capture\n", fn, total);
+    return 1;
+}
+
+unsigned char *read_capture(const char *fn, size_t *size)
+{
+    FILE *fp;
+    unsigned char *buf;
+    long len;
+
+    fp = fopen(fn, "rb");
+    if (!fp) {
+        perror(fn);
+        return NULL;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= 0) {
+        fprintf(stderr, "%s: empty or unreadable capture\n", fn);
+        fclose(fp);
+        return NULL;
+    }
+    rewind(fp);
+    buf = malloc(len);
+    if (!buf || fread(buf, 1, len, fp) != (size_t)len) {
+        fprintf(stderr, "%s: read failed\n", fn);
+        free(buf);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    *size = len;
+    return buf;
+}
+
+double elapsed_sec(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    static const size_t read_sizes[] = { 1, 17, 512, 4096, MIN_DATA_BUF_SIZE };
+    struct timespec start;
+    unsigned char *capture;
+    const char *genfn = NULL;
+    size_t size, replay = DEFAULT_REPLAY_BYTES, done, num, i;
+    double sec;
+    int option;
+
+    while ((option = getopt(argc, argv, "g:n:h")) != -1) {
+        switch (option) {
+        case 'g':
+            genfn = optarg;
+            break;
+        case 'n':
+            replay = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (genfn)
+        return write_capture(genfn, 1024 * 1024) ? 0 : 2;
+    if (optind >= argc || !replay) {
+        printf("Usage: %s [-n MB] CAPTURE\n"
+               "       %s -g CAPTURE\n"
+               "Replay about MB megabytes (default %d) of the data port capture file\n"
+               "CAPTURE through the frame decoder, or write a synthetic capture with -g.\n",
+               argv[0], argv[0], DEFAULT_REPLAY_BYTES / (1024 * 1024));
+        return 1;
+    }
+    capture = read_capture(argv[optind], &size);
+    if (!capture)
+        return 2;
+    for (i = 0; i < sizeof(read_sizes) / sizeof(read_sizes[0]); i++) {
+        ardop_data_reset_rx();
+        num_frames = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (done = 0; done < replay; ) {
+            /* feed the whole capture in reads of this size */
+            for (num = 0; num < size; num += read_sizes[i]) {
+                ardop_data_handle_data(capture + num,
+                    size - num < read_sizes[i] ? size - num : read_sizes[i]);
+            }
+            done += size;
+        }
+        sec = elapsed_sec(&start);
+        printf("read size %5zu: %8.1f MB/s, %9.0f frames/s, %zu frames\n",
+               read_sizes[i], done / sec / (1024 * 1024), num_frames / sec, num_frames);
+    }
+    free(capture);
+    return 0;
+}
+
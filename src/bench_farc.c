@@ -0,0 +1,281 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "zdict.h"
+#include "farc.h"
+
+/*  bench-farc: packs the files matching PATTERN in a directory into an
+    /MFGET archive with farc_pack(), and compares the size of the archive
+    deflated in one pass with the total of the files deflated one by one
+    as separate /FGET -z transfers would be, using '-zd' as well if there
+    is an arim-zdict file in the ARIM directory given. The archive is then
+    unpacked into a scratch directory and each file compared with the
+    original. A truncated archive, or one that would overwrite existing
+    files, must be rejected. By default a set of synthetic source files
+    is written and used. */
+
+#define DEFAULT_NUM_FILES       5
+#define DEFAULT_FILE_SIZE       9216
+
+char g_arim_path[MAX_PATH_SIZE];
+
+void bufq_queue_debug_log(const char *text) { }
+
+void ui_truncate_line(char *line, size_t size)
+{
+    line[size-1] = '\0';
+}
+
+static const char *stmts[] = {
+    "    snprintf(linebuf, sizeof(linebuf), \"%s\", p);\n",
+    "    if (numch >= sizeof(linebuf))\n        ui_truncate_line(linebuf, sizeof(linebuf));\n",
+    "    bufq_queue_debug_log(linebuf);\n",
+    "    pthread_mutex_lock(&mutex_df_load_cnt);\n",
+    "    pthread_mutex_unlock(&mutex_df_load_cnt);\n",
+    "    if (fp == NULL)\n        return 0;\n",
+    "    for (i = 0; i < cnt; i++) {\n        ++n;\n    }\n",
+    "    len = strlen(buffer);\n",
+    "    return 1;\n",
+};
+#define NUM_STMTS (sizeof(stmts) / sizeof(stmts[0]))
+
+int write_file(const char *fpath, size_t size, int n, unsigned int *seed)
+{
+    FILE *fp;
+    size_t len;
+    int i, f = 0;
+
+    fp = fopen(fpath, "w");
+    if (!fp) {
+        perror(fpath);
+        return 0;
+    }
+    len = fprintf(fp, "/* synthetic source file %d */\n\n#include <stdio.h>\n"
+                  "#include \"main.h\"\n\n", n + 1);
+    while (len < size) {
+        len += fprintf(fp, "int module%d_func%d(const char *p, size_t size)\n{\n", n, f++);
+        for (i = 2 + rand_r(seed) % 8; i > 0; i--) {
+            len += fprintf(fp, "%s", stmts[rand_r(seed) % NUM_STMTS]);
+            if (rand_r(seed) % 2)
+                len += fprintf(fp, "    n%d = 0x%04X;\n", rand_r(seed) % 10, rand_r(seed) & 0xFFFF);
+        }
+        len += fprintf(fp, "}\n\n");
+    }
+    if (fclose(fp) != 0) {
+        perror(fpath);
+        return 0;
+    }
+    return 1;
+}
+
+size_t deflate_buf(const char *data, size_t len, int zoption, unsigned char *out, size_t size)
+{
+    z_stream zs;
+
+    memset(&zs, 0, sizeof(zs));
+    if (zdict_deflate_init(&zs, zoption) != Z_OK)
+        return 0;
+    zs.next_in = (unsigned char *)data;
+    zs.avail_in = len;
+    zs.next_out = out;
+    zs.avail_out = size;
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&zs);
+        return 0;
+    }
+    deflateEnd(&zs);
+    return zs.total_out;
+}
+
+size_t deflate_files(const char *arc, int count, int zoption)
+{
+    static unsigned char out[MAX_UNCOMP_DATA_SIZE];
+    const char *p, *data;
+    size_t fsize, total = 0;
+    int i, numch;
+
+    /* each file on its own, data follows the manifest in entry order */
+    p = strchr(arc, '\n') + 1;
+    data = arc;
+    for (i = 0; i <= count; i++)
+        data = strchr(data, '\n') + 1;
+    for (i = 0; i < count; i++) {
+        if (1 != sscanf(p, "%zu %n", &fsize, &numch))
+            return 0;
+        total += deflate_buf(data, fsize, zoption, out, sizeof(out));
+        data += fsize;
+        p = strchr(p, '\n') + 1;
+    }
+    return total;
+}
+
+int compare_file(const char *a, const char *b)
+{
+    FILE *fa, *fb;
+    int ca, cb;
+
+    fa = fopen(a, "r");
+    fb = fopen(b, "r");
+    if (!fa || !fb) {
+        if (fa)
+            fclose(fa);
+        if (fb)
+            fclose(fb);
+        return 0;
+    }
+    do {
+        ca = fgetc(fa);
+        cb = fgetc(fb);
+    } while (ca == cb && ca != EOF);
+    fclose(fa);
+    fclose(fb);
+    return ca == cb;
+}
+
+int check_unpack(const char *arc, size_t size, int count,
+                     const char *srcdir, const char *dstdir)
+{
+    char src[MAX_PATH_SIZE*2+FARC_MAX_NAME_SIZE], dst[MAX_PATH_SIZE*2+FARC_MAX_NAME_SIZE];
+    char name[FARC_MAX_NAME_SIZE];
+    const char *p;
+    size_t fsize;
+    int i, n, numch, ok = 1;
+
+    n = 0;
+    if (farc_unpack(arc, size - 1, dstdir, &n) || n) {
+        printf("truncated archive: FAIL, accepted\n");
+        ok = 0;
+    } else {
+        printf("truncated archive: ok, rejected\n");
+    }
+    if (!farc_unpack(arc, size, dstdir, &n) || n != count) {
+        printf("unpack: FAIL\n");
+        return 0;
+    }
+    /* unpacking again must not overwrite the files now there */
+    if (farc_unpack(arc, size, dstdir, &n) != FARC_EXISTS || n) {
+        printf("existing files: FAIL, overwritten\n");
+        ok = 0;
+    } else {
+        printf("existing files: ok, refused\n");
+    }
+    p = strchr(arc, '\n') + 1;
+    for (i = 0; i < count; i++) {
+        if (2 != sscanf(p, "%zu %255[^\n]%n", &fsize, name, &numch))
+            return 0;
+        snprintf(src, sizeof(src), "%s/%s", srcdir, name);
+        snprintf(dst, sizeof(dst), "%s/%s", dstdir, name);
+        if (!compare_file(src, dst))
+            ok = 0;
+        unlink(dst);
+        p = strchr(p, '\n') + 1;
+    }
+    printf("unpack: %s\n", ok ? "ok, all files match" : "FAIL, files differ");
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    static char arc[MAX_UNCOMP_DATA_SIZE];
+    static unsigned char out[MAX_UNCOMP_DATA_SIZE];
+    char srctmp[] = "/tmp/bench-farc.XXXXXX", dsttmp[] = "/tmp/bench-farc.XXXXXX";
+    char fpath[MAX_PATH_SIZE*2];
+    const char *srcdir = NULL, *pattern = "*", *dstdir;
+    unsigned int seed = 1;
+    size_t size;
+    int i, option, count, skipped, zoption, ok = 1;
+
+    snprintf(g_arim_path, sizeof(g_arim_path), ".");
+    while ((option = getopt(argc, argv, "a:d:p:h")) != -1) {
+        switch (option) {
+        case 'a':
+            snprintf(g_arim_path, sizeof(g_arim_path), "%s", optarg);
+            break;
+        case 'd':
+            srcdir = optarg;
+            break;
+        case 'p':
+            pattern = optarg;
+            break;
+        default:
+            printf("Usage: %s [-a DIR] [-d SRCDIR [-p PATTERN]]\n"
+                   "Pack the files matching PATTERN (default *) in SRCDIR, or %d synthetic\n"
+                   "source files of %d bytes, into an /MFGET archive and compare its\n"
+                   "compressed size with the files compressed one by one, with '-z' and\n"
+                   "with '-zd' if there is a %s file in DIR (default .).\n",
+                   argv[0], DEFAULT_NUM_FILES, DEFAULT_FILE_SIZE, DEFAULT_ZDICT_FNAME);
+            return 1;
+        }
+    }
+    zdict_init();
+    if (!srcdir) {
+        srcdir = mkdtemp(srctmp);
+        if (!srcdir) {
+            perror(srctmp);
+            return 2;
+        }
+        for (i = 0; i < DEFAULT_NUM_FILES && ok; i++) {
+            snprintf(fpath, sizeof(fpath), "%s/file%d.c", srcdir, i + 1);
+            ok = write_file(fpath, DEFAULT_FILE_SIZE, i, &seed);
+        }
+    }
+    dstdir = mkdtemp(dsttmp);
+    if (!dstdir) {
+        perror(dsttmp);
+        ok = 0;
+    }
+    size = ok ? farc_pack(srcdir, pattern, arc, sizeof(arc), &count, &skipped) : 0;
+    if (size) {
+        printf("%s: %d files packed, %d skipped, archive %zu bytes\n",
+               srcdir, count, skipped, size);
+        for (zoption = ZOPT_ZLIB; zoption <= ZOPT_DICT; zoption++) {
+            if (zoption == ZOPT_DICT && !zdict_get_id())
+                continue;
+            printf("%-3s archive %6zu bytes, files one by one %6zu bytes\n",
+                   zoption == ZOPT_DICT ? "-zd" : "-z",
+                   deflate_buf(arc, size, zoption, out, sizeof(out)),
+                   deflate_files(arc, count, zoption));
+        }
+        ok = check_unpack(arc, size, count, srcdir, dstdir);
+    } else if (ok) {
+        printf("%s: no files matching %s\n", srcdir, pattern);
+        ok = 0;
+    }
+    if (dstdir)
+        rmdir(dstdir);
+    if (srcdir == srctmp) {
+        for (i = 0; i < DEFAULT_NUM_FILES; i++) {
+            snprintf(fpath, sizeof(fpath), "%s/file%d.c", srcdir, i + 1);
+            unlink(fpath);
+        }
+        rmdir(srcdir);
+    }
+    return ok ? 0 : 3;
+}
+
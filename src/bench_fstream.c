@@ -0,0 +1,329 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "main.h"
+#include "util.h"
+#include "zdict.h"
+#include "fstream.h"
+
+/*  bench-fstream: writes a text file of SIZE KB and a random data file
+    a tenth that size in a scratch directory, and streams each one
+    through fstream.c uncompressed, with '-z' and, if there is an
+    arim-zdict file in DIR, with '-zd'. The sender is read in random
+    block sizes up to a TNC data block, as the data thread does, and
+    the result is committed by the receiver and compared with the
+    original. Each is also sent with the link dropped part way through
+    and resumed from the receiver's checkpoint, once as is and once with
+    a byte of the partial file corrupted, which must be rejected. Then
+    checks that a stream cut short is rejected. */
+
+#define DEFAULT_FILE_SIZE       3072
+#define MAX_BLOCK_SIZE          2048    /* TNC_DATA_BLOCK_SIZE in datathread.c */
+
+char g_arim_path[MAX_PATH_SIZE];
+int g_ui_utc_time = 1;
+pthread_mutex_t mutex_time = PTHREAD_MUTEX_INITIALIZER;
+
+void bufq_queue_debug_log(const char *text) { }
+
+void ui_truncate_line(char *line, size_t size)
+{
+    line[size-1] = '\0';
+}
+
+static const char *words[] = { "QST", "net", "check-in", "bulletin", "ARES", "county",
+                               "station", "power", "antenna", "traffic", "relay", "73" };
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+static const char *zopt_names[] = { "none", "-z", "-zd" };
+
+int write_file(const char *fpath, size_t size, int text, unsigned int *seed)
+{
+    FILE *fp;
+    size_t len = 0;
+    int col = 0, numch;
+
+    fp = fopen(fpath, "w");
+    if (!fp) {
+        perror(fpath);
+        return 0;
+    }
+    while (len < size) {
+        if (!text) {
+            fputc(rand_r(seed) & 0xFF, fp);
+            ++len;
+        } else if (col > 60) {
+            fputc('\n', fp);
+            ++len;
+            col = 0;
+        } else {
+            numch = fprintf(fp, "%s %u ", words[rand_r(seed) % NUM_WORDS],
+                            rand_r(seed) % 1000);
+            col += numch;
+            len += numch;
+        }
+    }
+    if (fclose(fp) != 0) {
+        perror(fpath);
+        return 0;
+    }
+    return 1;
+}
+
+int compare_files(const char *a, const char *b)
+{
+    FILE *fa, *fb;
+    unsigned char bufa[FSTREAM_CHUNK_SIZE], bufb[FSTREAM_CHUNK_SIZE];
+    size_t lena, lenb;
+    int same = 1;
+
+    fa = fopen(a, "r");
+    fb = fopen(b, "r");
+    if (!fa || !fb) {
+        same = 0;
+    } else {
+        do {
+            lena = fread(bufa, 1, sizeof(bufa), fa);
+            lenb = fread(bufb, 1, sizeof(bufb), fb);
+            if (lena != lenb || memcmp(bufa, bufb, lena))
+                same = 0;
+        } while (same && lena);
+    }
+    if (fa)
+        fclose(fa);
+    if (fb)
+        fclose(fb);
+    return same;
+}
+
+int send_blocks(FSTREAM *rs, FSTREAM *ws, size_t stop, unsigned int *seed)
+{
+    static unsigned char block[MAX_BLOCK_SIZE];
+    size_t len;
+
+    /* as the data thread feeds the TNC and the receiver writes frames */
+    while (rs->cnt < stop) {
+        len = 1 + rand_r(seed) % MAX_BLOCK_SIZE;
+        if (len > stop - rs->cnt)
+            len = stop - rs->cnt;
+        len = fstream_read(rs, block, len);
+        if (!fstream_write(ws, block, len))
+            return 0;
+    }
+    return 1;
+}
+
+double elapsed_usec(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+int bench_transfer(const char *src, const char *dst, size_t fsize,
+                       int zoption, unsigned int *seed)
+{
+    static FSTREAM rs, ws;
+    struct timespec start;
+    unsigned int check;
+    double usec;
+    int ok;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!fstream_open(&rs, src, zoption))
+        return 0;
+    check = fstream_get_check(&rs);
+    ok = fstream_create(&ws, dst, zoption, rs.size, check, 0) &&
+         send_blocks(&rs, &ws, rs.size, seed) &&
+         fstream_commit(&ws, check) == 1;
+    usec = elapsed_usec(&start);
+    fstream_close(&rs);
+    ok = ok && compare_files(src, dst);
+    printf("  %-4s %9zu bytes sent, %7.1f MB/s, %s\n", zopt_names[zoption],
+           rs.size, fsize / usec, ok ? "ok" : "FAIL");
+    unlink(dst);
+    return ok;
+}
+
+int corrupt_part(const char *dst)
+{
+    FILE *fp;
+    char part[MAX_PATH_SIZE*2+16];
+    int c;
+
+    snprintf(part, sizeof(part), "%s%s", dst, FSTREAM_PART_EXT);
+    fp = fopen(part, "r+");
+    if (!fp)
+        return 0;
+    c = fgetc(fp);
+    rewind(fp);
+    fputc(c ^ 0x01, fp);
+    return fclose(fp) == 0;
+}
+
+int bench_resume(const char *src, const char *dst, int zoption,
+                     int corrupt, unsigned int *seed)
+{
+    static FSTREAM rs, ws;
+    unsigned int check, ckpt_check;
+    size_t stop, offset, ckpt_size;
+    int ckpt_zoption, result;
+
+    /* first session, the link drops after a random number of bytes */
+    if (!fstream_open(&rs, src, zoption))
+        return 0;
+    check = fstream_get_check(&rs);
+    stop = 1 + rand_r(seed) % (rs.size - 1);
+    if (!fstream_create(&ws, dst, zoption, rs.size, check, 0) ||
+        !send_blocks(&rs, &ws, stop, seed)) {
+        fstream_close(&rs);
+        fstream_discard(&ws);
+        return 0;
+    }
+    fstream_close(&ws);
+    fstream_close(&rs);
+    if (corrupt && !corrupt_part(dst))
+        return 0;
+    /* second session, resume from what the receiver holds */
+    offset = fstream_checkpoint(dst, &ckpt_zoption, &ckpt_size, &ckpt_check);
+    if (offset != stop || ckpt_zoption != zoption || ckpt_check != check) {
+        fstream_discard(&ws);
+        return 0;
+    }
+    if (!fstream_open(&rs, src, zoption) || fstream_get_check(&rs) != ckpt_check ||
+        !fstream_skip(&rs, offset) ||
+        !fstream_create(&ws, dst, ckpt_zoption, ckpt_size, ckpt_check, offset) ||
+        !send_blocks(&rs, &ws, rs.size, seed)) {
+        fstream_close(&rs);
+        fstream_discard(&ws);
+        return 0;
+    }
+    fstream_close(&rs);
+    result = fstream_commit(&ws, ckpt_check);
+    if (corrupt) {
+        printf("  %-4s resumed at %9zu, corrupted, %s\n", zopt_names[zoption], offset,
+               result == -1 ? "ok, rejected" : "FAIL, accepted");
+        return result == -1;
+    }
+    result = result == 1 && compare_files(src, dst);
+    printf("  %-4s resumed at %9zu, %s\n", zopt_names[zoption], offset,
+           result ? "ok" : "FAIL");
+    unlink(dst);
+    return result;
+}
+
+int check_truncated(const char *src, const char *dst, unsigned int *seed)
+{
+    static FSTREAM rs, ws;
+    unsigned int check;
+    int result;
+
+    /* the last block never arrives */
+    if (!fstream_open(&rs, src, ZOPT_ZLIB))
+        return 0;
+    check = fstream_get_check(&rs);
+    if (!fstream_create(&ws, dst, ZOPT_ZLIB, rs.size, check, 0) ||
+        !send_blocks(&rs, &ws, rs.size - 1, seed)) {
+        fstream_close(&rs);
+        fstream_discard(&ws);
+        return 0;
+    }
+    fstream_close(&rs);
+    result = fstream_commit(&ws, check);
+    printf("truncated stream: %s\n", result == -1 ? "ok, rejected" : "FAIL, accepted");
+    unlink(dst);
+    return result == -1;
+}
+
+int main(int argc, char *argv[])
+{
+    char tmpdir[] = "/tmp/bench-fstream.XXXXXX";
+    char src[MAX_PATH_SIZE*2], dst[MAX_PATH_SIZE*2+16];
+    const char *dir = ".", *tmp;
+    struct stat st;
+    unsigned int seed = 1;
+    size_t fsize = DEFAULT_FILE_SIZE * 1024;
+    int i, text, zoption, option, ok = 1;
+
+    while ((option = getopt(argc, argv, "d:s:h")) != -1) {
+        switch (option) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 's':
+            fsize = (size_t)atoi(optarg) * 1024;
+            break;
+        default:
+            fsize = 0;
+            break;
+        }
+    }
+    if (!fsize) {
+        printf("Usage: %s [-d DIR] [-s SIZE]\n"
+               "Stream a text file of SIZE KB (default %d) and a random file a tenth\n"
+               "that size through a sender and receiver, uncompressed, with '-z' and\n"
+               "with '-zd' if there is a %s file in DIR (default .), in one\n"
+               "session and resumed after a dropped link.\n",
+               argv[0], DEFAULT_FILE_SIZE, DEFAULT_ZDICT_FNAME);
+        return 1;
+    }
+    snprintf(g_arim_path, sizeof(g_arim_path), "%s", dir);
+    zdict_init();
+    tmp = mkdtemp(tmpdir);
+    if (!tmp) {
+        perror(tmpdir);
+        return 2;
+    }
+    snprintf(dst, sizeof(dst), "%s/received", tmp);
+    for (i = 0; i < 2 && ok; i++) {
+        text = (i == 0);
+        snprintf(src, sizeof(src), "%s/%s", tmp, text ? "text" : "random");
+        if (!write_file(src, text ? fsize : fsize / 10, text, &seed)) {
+            ok = 0;
+            break;
+        }
+        stat(src, &st);
+        printf("%s file, %lld bytes\n", text ? "text" : "random", (long long)st.st_size);
+        for (zoption = ZOPT_NONE; zoption <= ZOPT_DICT && ok; zoption++) {
+            if (zoption == ZOPT_DICT && !zdict_get_id())
+                continue;
+            ok = bench_transfer(src, dst, st.st_size, zoption, &seed) &&
+                 bench_resume(src, dst, zoption, 0, &seed) &&
+                 bench_resume(src, dst, zoption, 1, &seed);
+        }
+        if (text && ok)
+            ok = check_truncated(src, dst, &seed);
+        unlink(src);
+    }
+    rmdir(tmp);
+    return ok ? 0 : 3;
+}
+
@@ -0,0 +1,228 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include "main.h"
+#include "bufq.h"
+#include "util.h"
+
+/*  bench-log: times util_timestamp_usec() and bufq_queue_debug_log() per
+    call, from one or more threads logging at once while a consumer thread
+    drains the debug log queue as the log thread does. The "before" columns
+    use copies of the earlier versions: a timestamp formatted with snprintf
+    under mutex_time, and a debug log queue pushed under its own mutex. */
+
+#define MAX_THREADS             16
+#define DEFAULT_NUM_CALLS       1000000
+#define MAX_OLDQ_LEN            128
+
+int g_debug_log_enable = 1;
+int g_tncpi9k6_log_enable = 0;
+int g_traffic_log_enable = 0;
+int g_ui_utc_time = 0;
+int mon_timestamp = 0;
+pthread_mutex_t mutex_time = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct old_q {
+    int head, tail;
+    int size;
+    char data[MAX_OLDQ_LEN][MAX_CMD_SIZE];
+} OLDQUEUE;
+
+static OLDQUEUE old_debug_log_q;
+static pthread_mutex_t mutex_debug_log = PTHREAD_MUTEX_INITIALIZER;
+static volatile int consumer_stop;
+static int num_calls, use_old;
+
+char *old_timestamp_usec(char *buffer, size_t maxsize)
+{
+    struct timeval tv;
+    struct tm *cur_time;
+
+    pthread_mutex_lock(&mutex_time);
+    gettimeofday(&tv, NULL);
+    if (g_ui_utc_time)
+        cur_time = gmtime(&tv.tv_sec);
+    else
+        cur_time = localtime(&tv.tv_sec);
+    snprintf(buffer, maxsize, "%02d:%02d:%02d.%06ld",
+                cur_time->tm_hour, cur_time->tm_min, cur_time->tm_sec, tv.tv_usec);
+    pthread_mutex_unlock(&mutex_time);
+    return buffer;
+}
+
+void old_queue_debug_log(const char *text)
+{
+    char buffer[MAX_CMD_SIZE];
+    char timestamp[MAX_TIMESTAMP_SIZE];
+    OLDQUEUE *q = &old_debug_log_q;
+
+    if (g_debug_log_enable) {
+        snprintf(buffer, sizeof(buffer), "[%s] %s",
+                old_timestamp_usec(timestamp, sizeof(timestamp)), text);
+        pthread_mutex_lock(&mutex_debug_log);
+        /* the old cmdq_push(), overwrites oldest entry when full */
+        snprintf(q->data[q->head], sizeof(q->data[q->head]), "%s", buffer);
+        if (++q->head == MAX_OLDQ_LEN)
+            q->head = 0;
+        q->size = q->head - q->tail;
+        if (q->size <= 0)
+            q->size += MAX_OLDQ_LEN;
+        pthread_mutex_unlock(&mutex_debug_log);
+    }
+}
+
+int old_pop_debug_log(char *buffer, size_t size)
+{
+    OLDQUEUE *q = &old_debug_log_q;
+
+    pthread_mutex_lock(&mutex_debug_log);
+    if (!q->size) {
+        pthread_mutex_unlock(&mutex_debug_log);
+        return 0;
+    }
+    snprintf(buffer, size, "%s", q->data[q->tail]);
+    if (++q->tail >= MAX_OLDQ_LEN)
+        q->tail = 0;
+    q->size = q->head - q->tail;
+    if (q->size < 0)
+        q->size += MAX_OLDQ_LEN;
+    pthread_mutex_unlock(&mutex_debug_log);
+    return 1;
+}
+
+void *consumer(void *data)
+{
+    char buffer[MAX_CMD_SIZE];
+    int got;
+
+    /* stands in for the log thread, which writes each line to a file */
+    while (!consumer_stop) {
+        if (use_old)
+            got = old_pop_debug_log(buffer, sizeof(buffer));
+        else
+            got = cmdq_pop(&g_debug_log_q) != NULL;
+        if (!got)
+            sched_yield();
+    }
+    return NULL;
+}
+
+void *stamp_producer(void *data)
+{
+    char timestamp[MAX_TIMESTAMP_SIZE];
+    int i;
+
+    for (i = 0; i < num_calls; i++) {
+        if (use_old)
+            old_timestamp_usec(timestamp, sizeof(timestamp));
+        else
+            util_timestamp_usec(timestamp, sizeof(timestamp));
+    }
+    return NULL;
+}
+
+void *log_producer(void *data)
+{
+    int i;
+
+    for (i = 0; i < num_calls; i++) {
+        if (use_old)
+            old_queue_debug_log("Data thread: writing block of data to socket");
+        else
+            bufq_queue_debug_log("Data thread: writing block of data to socket");
+    }
+    return NULL;
+}
+
+double run(void *(*producer)(void *), int old, int threads)
+{
+    pthread_t tid[MAX_THREADS], ctid;
+    struct timespec start, end;
+    int i;
+
+    use_old = old;
+    consumer_stop = 0;
+    pthread_create(&ctid, NULL, consumer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++)
+        pthread_create(&tid[i], NULL, producer, NULL);
+    for (i = 0; i < threads; i++)
+        pthread_join(tid[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    consumer_stop = 1;
+    pthread_join(ctid, NULL);
+    /* time per call as seen by each calling thread */
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / num_calls;
+}
+
+int main(int argc, char *argv[])
+{
+    int option, threads, max_threads = 4;
+
+    num_calls = DEFAULT_NUM_CALLS;
+    while ((option = getopt(argc, argv, "n:t:uh")) != -1) {
+        switch (option) {
+        case 'n':
+            num_calls = atoi(optarg);
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'u':
+            g_ui_utc_time = 1;
+            break;
+        default:
+            num_calls = 0;
+            break;
+        }
+    }
+    if (num_calls <= 0 || max_threads < 1 || max_threads > MAX_THREADS) {
+        printf("Usage: %s [-n NUM] [-t MAX] [-u]\n"
+               "Make NUM calls (default %d) from each of 1 to MAX threads (default 4,\n"
+               "up to %d), using UTC timestamps if -u is given.\n",
+               argv[0], DEFAULT_NUM_CALLS, MAX_THREADS);
+        return 1;
+    }
+    bufq_init();
+    printf("                util_timestamp_usec    bufq_queue_debug_log\n");
+    printf("threads     before ns  after ns      before ns  after ns\n");
+    for (threads = 1; ; threads *= 2) {
+        if (threads > max_threads)
+            threads = max_threads;
+        printf("%7d  %12.1f %9.1f   %12.1f %9.1f\n", threads,
+               run(stamp_producer, 1, threads), run(stamp_producer, 0, threads),
+                   run(log_producer, 1, threads), run(log_producer, 0, threads));
+        if (threads == max_threads)
+            break;
+    }
+    return 0;
+}
+
@@ -0,0 +1,298 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "main.h"
+#include "ini.h"
+#include "mbox.h"
+#include "mbox_idx.h"
+
+/*  bench-mbox: builds a synthetic mailbox of MSGS messages, or of SIZE
+    megabytes, in a scratch directory and times mailbox operations on it
+    through mbox.c: index build, list page reads, message reads, flag
+    updates and purging of old messages. */
+
+#define DEFAULT_NUM_MSGS        5000
+#define DEFAULT_NUM_OPS         2000
+#define DEFAULT_PAGE_ROWS       40
+#define BENCH_MBOX_FNAME        "bench.mbox"
+
+ARIM_SET g_arim_settings;
+char g_arim_path[MAX_PATH_SIZE];
+int g_ui_utc_time = 1;
+int msg_view_restart;
+pthread_mutex_t mutex_mbox = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mutex_time = PTHREAD_MUTEX_INITIALIZER;
+
+void bufq_queue_debug_log(const char *text) { }
+
+void ui_truncate_line(char *line, size_t size)
+{
+    line[size-1] = '\0';
+}
+
+static const char *calls[] = { "N0CALL", "W1AW", "K7ABC", "VE3XYZ", "G4ABC", "DL1ZZ" };
+#define NUM_CALLS (sizeof(calls) / sizeof(calls[0]))
+
+int write_mbox(const char *fpath, int num_msgs, size_t max_size, unsigned int *seed)
+{
+    static const char *days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    FILE *fp;
+    char body[2048];
+    struct tm tm;
+    time_t t;
+    int i, j, len;
+
+    fp = fopen(fpath, "w");
+    if (!fp) {
+        perror(fpath);
+        return 0;
+    }
+    /* one message every 10 minutes up to now, as written by mbox_add_msg() */
+    if (max_size)
+        num_msgs = max_size / 700; /* messages average 700 bytes */
+    t = time(NULL) - (time_t)num_msgs * 600;
+    for (i = 0; i < num_msgs; i++, t += 600) {
+        gmtime_r(&t, &tm);
+        len = 200 + rand_r(seed) % 800;
+        for (j = 0; j < len; j++)
+            body[j] = (j % 64 == 63) ? '\n' : 'a' + rand_r(seed) % 26;
+        body[len] = '\0';
+        fprintf(fp, "From %-10s %s %s %2d %02d:%02d:%02d 2%03d To %-10s %5d %04X ----",
+                calls[rand_r(seed) % NUM_CALLS], days[tm.tm_wday], months[tm.tm_mon],
+                    tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_year - 100,
+                        calls[i % NUM_CALLS], len, i & 0xFFFF);
+        fprintf(fp, "\nFrom: %s\nTo: %s\n\n%s\n\n", calls[0], calls[i % NUM_CALLS], body);
+    }
+    if (fclose(fp) != 0) {
+        perror(fpath);
+        return 0;
+    }
+    return num_msgs;
+}
+
+double elapsed_usec(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+void bench_index(const char *dir)
+{
+    struct timespec start;
+    char fpath[MAX_PATH_SIZE*2];
+    double usec;
+    int cnt;
+
+    /* full scan of the mailbox, no sidecar index file */
+    snprintf(fpath, sizeof(fpath), "%s/%s.idx", dir, BENCH_MBOX_FNAME);
+    unlink(fpath);
+    mbox_idx_invalidate(BENCH_MBOX_FNAME);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cnt = mbox_get_msg_cnt(BENCH_MBOX_FNAME);
+    usec = elapsed_usec(&start);
+    printf("index build:     %8.1f ms, %d messages\n", usec / 1000, cnt);
+    /* reload from the sidecar index file written by the build */
+    mbox_idx_invalidate(BENCH_MBOX_FNAME);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbox_get_msg_cnt(BENCH_MBOX_FNAME);
+    usec = elapsed_usec(&start);
+    printf("index load:      %8.1f ms\n", usec / 1000);
+}
+
+void bench_page(int num_msgs, int num_ops, int rows, unsigned int *seed)
+{
+    static char list[MAX_MBOX_LIST_LEN][MAX_MBOX_HDR_SIZE];
+    struct timespec start;
+    double usec = 0;
+    int i, j, top;
+
+    /* read a page of headers the way the message list view does,
+       newest first from a random top row */
+    for (i = 0; i < num_ops; i++) {
+        top = rand_r(seed) % num_msgs;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (j = 0; j < rows && top - j >= 0; j++) {
+            if (!mbox_get_header(list[j], MAX_MBOX_HDR_SIZE, BENCH_MBOX_FNAME, top - j))
+                break;
+        }
+        usec += elapsed_usec(&start);
+    }
+    printf("list page:       %8.1f us per %d rows\n", usec / num_ops, rows);
+}
+
+void bench_read(int num_msgs, int num_ops, unsigned int *seed)
+{
+    static char msgbuffer[MAX_UNCOMP_DATA_SIZE];
+    struct timespec start;
+    char hdr[MAX_MBOX_HDR_SIZE];
+    double usec = 0;
+    int i, cnt = 0;
+
+    for (i = 0; i < num_ops; i++) {
+        if (!mbox_get_header(hdr, sizeof(hdr), BENCH_MBOX_FNAME, rand_r(seed) % num_msgs))
+            continue;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        mbox_get_msg(msgbuffer, sizeof(msgbuffer), BENCH_MBOX_FNAME, hdr, 0);
+        usec += elapsed_usec(&start);
+        ++cnt;
+    }
+    if (cnt)
+        printf("mbox_get_msg:    %8.1f us per call\n", usec / cnt);
+}
+
+void bench_flags(int num_msgs, int num_ops, unsigned int *seed)
+{
+    struct timespec start;
+    char hdr[MAX_MBOX_HDR_SIZE];
+    double set_usec = 0, clear_usec = 0;
+    int i, n, cnt = 0;
+
+    for (i = 0; i < num_ops; i++) {
+        n = rand_r(seed) % num_msgs;
+        if (!mbox_get_header(hdr, sizeof(hdr), BENCH_MBOX_FNAME, n))
+            continue;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        mbox_set_flag(BENCH_MBOX_FNAME, hdr, 'R');
+        set_usec += elapsed_usec(&start);
+        mbox_get_header(hdr, sizeof(hdr), BENCH_MBOX_FNAME, n);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        mbox_clear_flag(BENCH_MBOX_FNAME, hdr, 'R');
+        clear_usec += elapsed_usec(&start);
+        ++cnt;
+    }
+    if (cnt)
+        printf("mbox_set_flag:   %8.1f us per call\n"
+               "mbox_clear_flag: %8.1f us per call\n", set_usec / cnt, clear_usec / cnt);
+}
+
+void bench_purge(int num_msgs)
+{
+    struct timespec start;
+    double usec;
+    int cnt, days;
+
+    /* messages are 10 minutes apart, first with nothing aged out so
+       only the index dates are checked, then purge the older half */
+    days = num_msgs / 144 + 2;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbox_purge(BENCH_MBOX_FNAME, days);
+    usec = elapsed_usec(&start);
+    printf("purge, none old: %8.1f ms\n", usec / 1000);
+    days = num_msgs / 288;
+    if (!days)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mbox_purge(BENCH_MBOX_FNAME, days);
+    usec = elapsed_usec(&start);
+    cnt = mbox_get_msg_cnt(BENCH_MBOX_FNAME);
+    printf("purge, %4d days: %7.1f ms, %d messages removed\n",
+           days, usec / 1000, num_msgs - cnt);
+}
+
+int main(int argc, char *argv[])
+{
+    char tmpdir[] = "/tmp/bench-mbox.XXXXXX", fpath[MAX_PATH_SIZE*2];
+    struct stat st;
+    const char *dir = NULL;
+    unsigned int seed = 1;
+    int made_dir = 0;
+    int option, num_msgs = DEFAULT_NUM_MSGS, num_ops = DEFAULT_NUM_OPS;
+    int rows = DEFAULT_PAGE_ROWS;
+    size_t max_size = 0;
+
+    while ((option = getopt(argc, argv, "d:m:n:r:s:h")) != -1) {
+        switch (option) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'm':
+            num_msgs = atoi(optarg);
+            break;
+        case 'n':
+            num_ops = atoi(optarg);
+            break;
+        case 'r':
+            rows = atoi(optarg);
+            if (rows <= 0 || rows > MAX_MBOX_LIST_LEN)
+                num_msgs = 0;
+            break;
+        case 's':
+            max_size = (size_t)atoi(optarg) * 1024 * 1024;
+            if (!max_size)
+                num_msgs = 0;
+            break;
+        default:
+            num_msgs = 0;
+            break;
+        }
+    }
+    if (num_msgs <= 0 || num_ops <= 0) {
+        printf("Usage: %s [-d DIR] [-m MSGS | -s SIZE] [-n OPS] [-r ROWS]\n"
+               "Build a mailbox of MSGS messages (default %d) or SIZE megabytes in DIR\n"
+               "(default a new directory in /tmp), then time its index build and OPS\n"
+               "(default %d) list pages of ROWS (default %d, max %d) headers, message\n"
+               "reads and flag updates, then purge the older half of the messages.\n",
+               argv[0], DEFAULT_NUM_MSGS, DEFAULT_NUM_OPS, DEFAULT_PAGE_ROWS,
+                   MAX_MBOX_LIST_LEN);
+        return 1;
+    }
+    if (!dir) {
+        dir = mkdtemp(tmpdir);
+        if (!dir) {
+            perror(tmpdir);
+            return 2;
+        }
+        made_dir = 1;
+    }
+    snprintf(mbox_dir_path, MAX_PATH_SIZE, "%s", dir);
+    snprintf(g_arim_path, sizeof(g_arim_path), "%s", dir);
+    snprintf(g_arim_settings.max_msg_days, sizeof(g_arim_settings.max_msg_days), "0");
+    snprintf(fpath, sizeof(fpath), "%s/%s", dir, BENCH_MBOX_FNAME);
+    num_msgs = write_mbox(fpath, num_msgs, max_size, &seed);
+    if (!num_msgs || stat(fpath, &st) != 0)
+        return 2;
+    printf("%s: %d messages, %lld bytes\n", fpath, num_msgs, (long long)st.st_size);
+    bench_index(dir);
+    bench_page(num_msgs, num_ops, rows, &seed);
+    bench_read(num_msgs, num_ops, &seed);
+    bench_flags(num_msgs, num_ops, &seed);
+    bench_purge(num_msgs);
+    unlink(fpath);
+    snprintf(fpath, sizeof(fpath), "%s/%s.idx", dir, BENCH_MBOX_FNAME);
+    unlink(fpath);
+    if (made_dir)
+        rmdir(dir);
+    return 0;
+}
+
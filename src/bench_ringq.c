@@ -0,0 +1,225 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include "main.h"
+#include "ringq.h"
+
+/*  bench-ringq: times multi-producer push and single consumer pop of
+    log-line sized records through the lock-free ring queue used by bufq,
+    against the mutex protected array queue it replaced. The old queue
+    overwrote its oldest record when full; here its producers wait for
+    room instead, so both queues deliver every record and the times are
+    comparable. */
+
+#define MAX_PRODUCERS           16
+#define DEFAULT_NUM_RECS        1000000
+#define MAX_MUTEXQ_LEN          128
+
+typedef struct mutex_q {
+    int head, tail;
+    int size;
+    char data[MAX_MUTEXQ_LEN][MAX_CMD_SIZE];
+} MUTEXQ;
+
+static RINGQ ringq;
+static _Alignas(RINGQ_HDR_SIZE) unsigned char ringq_buf[MAX_MUTEXQ_LEN*MAX_CMD_SIZE];
+static MUTEXQ mutexq;
+static pthread_mutex_t mutex_q = PTHREAD_MUTEX_INITIALIZER;
+static int num_recs;
+
+/* the old cmdq_push() and cmdq_pop(), called with mutex_q held */
+
+int mutexq_push(MUTEXQ *q, const char *data)
+{
+    snprintf(q->data[q->head], sizeof(q->data[q->head]), "%s", data);
+    if (++q->head == MAX_MUTEXQ_LEN)
+        q->head = 0;
+    q->size = q->head - q->tail;
+    if (q->size <= 0)
+        q->size += MAX_MUTEXQ_LEN;
+    return q->size;
+}
+
+char *mutexq_pop(MUTEXQ *q)
+{
+    int p;
+
+    if (!q->size)
+        return NULL;
+    p = q->tail;
+    if (++q->tail >= MAX_MUTEXQ_LEN)
+        q->tail = 0;
+    q->size = q->head - q->tail;
+    if (q->size < 0)
+        q->size += MAX_MUTEXQ_LEN;
+    return q->data[p];
+}
+
+void make_rec(char *buf, size_t size, long id, int i)
+{
+    /* 40 to 120 chars, like a debug log line */
+    snprintf(buf, size, "[12:34:56.%06d] Thread %ld: %.*s", i % 1000000, id,
+             20 + i % 80, "................................................"
+             "................................................");
+}
+
+void *ring_producer(void *data)
+{
+    char buf[MAX_CMD_SIZE];
+    long id = (long)data;
+    int i;
+
+    for (i = 0; i < num_recs; i++) {
+        make_rec(buf, sizeof(buf), id, i);
+        while (!ringq_push(&ringq, buf, strlen(buf) + 1))
+            sched_yield();
+    }
+    return NULL;
+}
+
+void *mutex_producer(void *data)
+{
+    char buf[MAX_CMD_SIZE];
+    long id = (long)data;
+    int i;
+
+    for (i = 0; i < num_recs; i++) {
+        make_rec(buf, sizeof(buf), id, i);
+        for (;;) {
+            pthread_mutex_lock(&mutex_q);
+            if (mutexq.size < MAX_MUTEXQ_LEN - 1)
+                break;
+            pthread_mutex_unlock(&mutex_q);
+            sched_yield();
+        }
+        mutexq_push(&mutexq, buf);
+        pthread_mutex_unlock(&mutex_q);
+    }
+    return NULL;
+}
+
+long ring_consume(long total)
+{
+    char buf[MAX_CMD_SIZE];
+    long n = 0, bytes = 0;
+    int len;
+
+    while (n < total) {
+        len = ringq_pop(&ringq, buf, sizeof(buf));
+        if (len < 0) {
+            sched_yield();
+            continue;
+        }
+        bytes += len;
+        ++n;
+    }
+    return bytes;
+}
+
+long mutex_consume(long total)
+{
+    char buf[MAX_CMD_SIZE], *p;
+    long n = 0, bytes = 0;
+
+    while (n < total) {
+        pthread_mutex_lock(&mutex_q);
+        p = mutexq_pop(&mutexq);
+        if (p)
+            snprintf(buf, sizeof(buf), "%s", p);
+        pthread_mutex_unlock(&mutex_q);
+        if (!p) {
+            sched_yield();
+            continue;
+        }
+        bytes += strlen(buf) + 1;
+        ++n;
+    }
+    return bytes;
+}
+
+double run(int use_ring, int producers)
+{
+    pthread_t tid[MAX_PRODUCERS];
+    struct timespec start, end;
+    long i, total;
+
+    memset(ringq_buf, 0, sizeof(ringq_buf));
+    ringq_init(&ringq, ringq_buf, sizeof(ringq_buf), RINGQ_MP, RINGQ_DROP_NEWEST);
+    memset(&mutexq, 0, sizeof(mutexq));
+    total = (long)num_recs * producers;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < producers; i++)
+        pthread_create(&tid[i], NULL, use_ring ? ring_producer : mutex_producer, (void *)i);
+    if (use_ring)
+        ring_consume(total);
+    else
+        mutex_consume(total);
+    for (i = 0; i < producers; i++)
+        pthread_join(tid[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / total;
+}
+
+int main(int argc, char *argv[])
+{
+    int option, producers, max_producers = 4;
+
+    num_recs = DEFAULT_NUM_RECS;
+    while ((option = getopt(argc, argv, "n:p:h")) != -1) {
+        switch (option) {
+        case 'n':
+            num_recs = atoi(optarg);
+            break;
+        case 'p':
+            max_producers = atoi(optarg);
+            break;
+        default:
+            num_recs = 0;
+            break;
+        }
+    }
+    if (num_recs <= 0 || max_producers < 1 || max_producers > MAX_PRODUCERS) {
+        printf("Usage: %s [-n NUM] [-p MAX]\n"
+               "Push NUM records (default %d) from each of 1 to MAX producer threads\n"
+               "(default 4, up to %d) through the ring and mutex queues.\n",
+               argv[0], DEFAULT_NUM_RECS, MAX_PRODUCERS);
+        return 1;
+    }
+    printf("producers   ring ns/rec  mutex ns/rec\n");
+    for (producers = 1; ; producers *= 2) {
+        if (producers > max_producers)
+            producers = max_producers;
+        printf("%9d  %12.1f  %12.1f\n", producers, run(1, producers), run(0, producers));
+        if (producers == max_producers)
+            break;
+    }
+    return 0;
+}
+
@@ -0,0 +1,346 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <utime.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "main.h"
+#include "ini.h"
+#include "util.h"
+#include "zdict.h"
+#include "zcache.h"
+
+/*  bench-zcache: writes FILES shared files of SIZE bytes of text in a
+    scratch files directory and serves OPS '-z' requests for them the
+    way arim_arq_files_send_file() does, once with the compressed file
+    cache disabled and once with it enabled. Then checks that a changed
+    file misses, also when rewritten within the same second at the same
+    size or replaced by a file with the same mtime, that a small budget
+    evicts, and that persisted entries are reloaded after the memory
+    cache is dropped. */
+
+#define DEFAULT_NUM_FILES       8
+#define DEFAULT_FILE_SIZE       8192
+#define DEFAULT_NUM_OPS         2000
+
+ARIM_SET g_arim_settings;
+char g_arim_path[MAX_PATH_SIZE];
+int g_ui_utc_time = 1;
+pthread_mutex_t mutex_time = PTHREAD_MUTEX_INITIALIZER;
+
+void bufq_queue_debug_log(const char *text) { }
+
+void ui_truncate_line(char *line, size_t size)
+{
+    line[size-1] = '\0';
+}
+
+static const char *words[] = { "QST", "net", "check-in", "bulletin", "ARES", "county",
+                               "station", "power", "antenna", "traffic", "relay", "73" };
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+int write_file(const char *fpath, size_t size, unsigned int *seed)
+{
+    FILE *fp;
+    size_t len = 0;
+    int col = 0, numch;
+
+    fp = fopen(fpath, "w");
+    if (!fp) {
+        perror(fpath);
+        return 0;
+    }
+    while (len < size) {
+        if (col > 60) {
+            fputc('\n', fp);
+            ++len;
+            col = 0;
+            continue;
+        }
+        numch = fprintf(fp, "%s ", words[rand_r(seed) % NUM_WORDS]);
+        if (rand_r(seed) % 4 == 0)
+            numch += fprintf(fp, "%u ", rand_r(seed) % 1000);
+        col += numch;
+        len += numch;
+    }
+    if (fclose(fp) != 0) {
+        perror(fpath);
+        return 0;
+    }
+    return 1;
+}
+
+int send_file(const char *dir, const char *fn, int *cached)
+{
+    FILE *fp;
+    struct stat st;
+    z_stream zs;
+    static unsigned char filebuf[MAX_UNCOMP_DATA_SIZE], data[MAX_FILE_SIZE];
+    char fpath[MAX_PATH_SIZE*2];
+    size_t filesize, size;
+    unsigned int check;
+
+    /* the part of arim_arq_files_send_file() that the cache skips */
+    snprintf(fpath, sizeof(fpath), "%s/%s", dir, fn);
+    fp = fopen(fpath, "r");
+    if (!fp || fstat(fileno(fp), &st)) {
+        if (fp)
+            fclose(fp);
+        return 0;
+    }
+    *cached = zcache_get(fn, &st, ZOPT_ZLIB, data, sizeof(data), &size, &check);
+    if (*cached) {
+        fclose(fp);
+        return 1;
+    }
+    filesize = fread(filebuf, 1, sizeof(filebuf), fp);
+    fclose(fp);
+    memset(&zs, 0, sizeof(zs));
+    if (zdict_deflate_init(&zs, ZOPT_ZLIB) != Z_OK)
+        return 0;
+    zs.next_in = filebuf;
+    zs.avail_in = filesize;
+    zs.next_out = data;
+    zs.avail_out = sizeof(data);
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&zs);
+        return 0;
+    }
+    deflateEnd(&zs);
+    size = zs.total_out;
+    check = ccitt_crc16(data, size);
+    zcache_put(fn, &st, ZOPT_ZLIB, data, size, check);
+    return 1;
+}
+
+double elapsed_usec(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+int bench_requests(const char *dir, int num_files, int num_ops,
+                       const char *size_kb, unsigned int *seed)
+{
+    struct timespec start;
+    char fn[MAX_FILE_NAME_SIZE];
+    double usec;
+    int i, cached, hits = 0;
+
+    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), "%s", size_kb);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_ops; i++) {
+        snprintf(fn, sizeof(fn), "file%d.txt", rand_r(seed) % num_files);
+        if (!send_file(dir, fn, &cached))
+            return -1;
+        hits += cached;
+    }
+    usec = elapsed_usec(&start);
+    printf("zcache-size %4s: %8.1f us per request, %d of %d hits\n",
+           size_kb, usec / num_ops, hits, num_ops);
+    return hits;
+}
+
+int rewrite_file(const char *fpath, int replace)
+{
+    FILE *fp;
+    struct stat st;
+    struct timespec times[2];
+    static unsigned char buf[MAX_UNCOMP_DATA_SIZE];
+    char tmp[MAX_PATH_SIZE*2+8];
+    size_t len;
+
+    /* change a byte keeping the size and mtime seconds, the file is
+       either rewritten in place with a later mtime in nanoseconds, or
+       replaced by a new file with the same mtime renamed over it */
+    if (stat(fpath, &st) == -1 || !(fp = fopen(fpath, "r")))
+        return 0;
+    len = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    if (!len)
+        return 0;
+    buf[0] ^= 0x01;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", fpath);
+    fp = fopen(replace ? tmp : fpath, "w");
+    if (!fp)
+        return 0;
+    if (fwrite(buf, 1, len, fp) != len) {
+        fclose(fp);
+        return 0;
+    }
+    if (fclose(fp) != 0 || (replace && rename(tmp, fpath) == -1))
+        return 0;
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+    if (!replace)
+        times[1].tv_nsec = (times[1].tv_nsec + 1) % 1000000000;
+    return utimensat(AT_FDCWD, fpath, times, 0) == 0;
+}
+
+int check_cache(const char *dir, int num_files)
+{
+    struct utimbuf ut;
+    char fn[MAX_FILE_NAME_SIZE], fpath[MAX_PATH_SIZE*2];
+    int i, cached, ok = 1;
+
+    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), "256");
+    /* a file touched since it was cached must be compressed again */
+    send_file(dir, "file0.txt", &cached);
+    snprintf(fpath, sizeof(fpath), "%s/file0.txt", dir);
+    ut.actime = ut.modtime = time(NULL) + 60;
+    utime(fpath, &ut);
+    send_file(dir, "file0.txt", &cached);
+    printf("changed file:    %s\n", cached ? "FAIL, served from cache" : "ok, missed");
+    ok = ok && !cached;
+    /* rewritten within the same second at the same size */
+    send_file(dir, "file0.txt", &cached);
+    rewrite_file(fpath, 0);
+    send_file(dir, "file0.txt", &cached);
+    printf("same second:     %s\n", cached ? "FAIL, served from cache" : "ok, missed");
+    ok = ok && !cached;
+    /* replaced by another file with the same size and mtime */
+    rewrite_file(fpath, 1);
+    send_file(dir, "file0.txt", &cached);
+    printf("replaced file:   %s\n", cached ? "FAIL, served from cache" : "ok, missed");
+    ok = ok && !cached;
+    /* with room for only one entry the first file is evicted */
+    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), "4");
+    send_file(dir, "file0.txt", &cached);
+    send_file(dir, "file1.txt", &cached);
+    send_file(dir, "file0.txt", &cached);
+    printf("eviction:        %s\n", cached ? "FAIL, not evicted" : "ok, missed");
+    ok = ok && !cached;
+    /* persisted entries survive dropping the memory cache */
+    snprintf(g_arim_settings.zcache_persist, sizeof(g_arim_settings.zcache_persist), "TRUE");
+    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), "256");
+    for (i = 0; i < num_files; i++) {
+        snprintf(fn, sizeof(fn), "file%d.txt", i);
+        send_file(dir, fn, &cached);
+    }
+    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), "0");
+    send_file(dir, "file0.txt", &cached);
+    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), "256");
+    for (i = 0; i < num_files; i++) {
+        snprintf(fn, sizeof(fn), "file%d.txt", i);
+        send_file(dir, fn, &cached);
+        if (!cached)
+            break;
+    }
+    printf("reload:          %s\n", i < num_files ? "FAIL, not reloaded" : "ok, all hits");
+    ok = ok && i == num_files;
+    snprintf(g_arim_settings.zcache_persist, sizeof(g_arim_settings.zcache_persist), "FALSE");
+    return ok;
+}
+
+void clean_up(const char *dir, int num_files)
+{
+    char fpath[MAX_PATH_SIZE*2];
+    struct stat st;
+    unsigned int h;
+    const char *p;
+    int i;
+
+    for (i = 0; i < num_files; i++) {
+        snprintf(fpath, sizeof(fpath), "%s/file%d.txt", dir, i);
+        unlink(fpath);
+        /* cache file names as made by zcache_file_path() */
+        h = 2166136261U;
+        snprintf(fpath, sizeof(fpath), "file%d.txt", i);
+        for (p = fpath; *p; p++)
+            h = (h ^ (unsigned char)*p) * 16777619U;
+        snprintf(fpath, sizeof(fpath), "%s/%s/%08X.z%d", dir, DEFAULT_ZCACHE_DIR, h, ZOPT_ZLIB);
+        unlink(fpath);
+    }
+    snprintf(fpath, sizeof(fpath), "%s/%s", dir, DEFAULT_ZCACHE_DIR);
+    if (stat(fpath, &st) == 0)
+        rmdir(fpath);
+    rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    char tmpdir[] = "/tmp/bench-zcache.XXXXXX", fpath[MAX_PATH_SIZE*2];
+    const char *dir;
+    unsigned int seed = 1;
+    int i, option, ok;
+    int num_files = DEFAULT_NUM_FILES, num_ops = DEFAULT_NUM_OPS;
+    size_t file_size = DEFAULT_FILE_SIZE;
+
+    while ((option = getopt(argc, argv, "f:n:s:h")) != -1) {
+        switch (option) {
+        case 'f':
+            num_files = atoi(optarg);
+            break;
+        case 'n':
+            num_ops = atoi(optarg);
+            break;
+        case 's':
+            file_size = (size_t)atoi(optarg);
+            if (file_size > MAX_UNCOMP_DATA_SIZE)
+                file_size = 0;
+            break;
+        default:
+            num_files = 0;
+            break;
+        }
+    }
+    if (num_files < 2 || num_ops <= 0 || !file_size) {
+        printf("Usage: %s [-f FILES] [-s SIZE] [-n OPS]\n"
+               "Write FILES (default %d, min 2) text files of SIZE bytes (default %d,\n"
+               "max %d) and time OPS (default %d) '-z' requests for them with and\n"
+               "without the compressed file cache, then check cache invalidation,\n"
+               "eviction and reload from disk.\n",
+               argv[0], DEFAULT_NUM_FILES, DEFAULT_FILE_SIZE, MAX_UNCOMP_DATA_SIZE,
+                   DEFAULT_NUM_OPS);
+        return 1;
+    }
+    dir = mkdtemp(tmpdir);
+    if (!dir) {
+        perror(tmpdir);
+        return 2;
+    }
+    snprintf(g_arim_settings.files_dir, sizeof(g_arim_settings.files_dir), "%s", dir);
+    snprintf(g_arim_settings.zcache_persist, sizeof(g_arim_settings.zcache_persist), "FALSE");
+    for (i = 0; i < num_files; i++) {
+        snprintf(fpath, sizeof(fpath), "%s/file%d.txt", dir, i);
+        if (!write_file(fpath, file_size, &seed)) {
+            clean_up(dir, num_files);
+            return 2;
+        }
+    }
+    printf("%d files of %zu bytes in %s\n", num_files, file_size, dir);
+    ok = bench_requests(dir, num_files, num_ops, "0", &seed) == 0 &&
+         bench_requests(dir, num_files, num_ops, "256", &seed) > 0 &&
+         check_cache(dir, num_files);
+    clean_up(dir, num_files);
+    return ok ? 0 : 3;
+}
+
@@ -0,0 +1,266 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "main.h"
+#include "zdict.h"
+
+/*  bench-zdict: compresses each message in a mailbox file as an ARQ
+    message is sent, with '-z' and with '-zd' using the arim-zdict file
+    in DIR, checks that both round-trip and totals the compressed sizes.
+    With -g it writes a synthetic mailbox of net traffic to compress or
+    to build a dictionary from with arim-zdict. */
+
+#define DEFAULT_NUM_MSGS        50
+#define MAX_BENCH_MSG_SIZE      MAX_UNCOMP_DATA_SIZE
+
+char g_arim_path[MAX_PATH_SIZE];
+
+void bufq_queue_debug_log(const char *text)
+{
+    printf("%s\n", text);
+}
+
+void ui_truncate_line(char *line, size_t size)
+{
+    line[size-1] = '\0';
+}
+
+static const char *calls[] = { "N0CALL", "W1AW", "K7ABC", "VE3XYZ", "KD9QRS",
+                               "N5TX", "AB1CD", "WA6ZZZ", "K0NE", "W7EMC" };
+#define NUM_CALLS (sizeof(calls) / sizeof(calls[0]))
+
+static const char *nets[] = { "ARES Digital Net", "County EmComm Net",
+                              "Section Traffic Net", "NBEMS Practice Net" };
+#define NUM_NETS (sizeof(nets) / sizeof(nets[0]))
+
+static const char *lines[] = {
+    "Station is on emergency power, battery at 12.6 V.\n",
+    "All stations please check in with call, name and location.\n",
+    "Signal report 599, good copy on ARDOP 500 Hz.\n",
+    "Will relay traffic for the EOC on the next session.\n",
+    "No traffic at this time, standing by.\n",
+    "Antenna is an end fed half wave at 30 feet.\n",
+    "Power outage in the north end of the county since 0600.\n",
+    "Requesting an update on shelter status and supplies.\n",
+    "Roads open, no damage to report in this area.\n",
+    "Please acknowledge receipt of this message.\n",
+    "Thanks for the net, see you next week.\n",
+    "QSL, message received and passed to the served agency.\n",
+};
+#define NUM_LINES (sizeof(lines) / sizeof(lines[0]))
+
+size_t make_msg(char *buf, size_t size, int n, unsigned int *seed)
+{
+    const char *net = nets[rand_r(seed) % NUM_NETS];
+    const char *fm = calls[rand_r(seed) % NUM_CALLS];
+    const char *to = calls[rand_r(seed) % NUM_CALLS];
+    size_t len;
+    int i, num_lines;
+
+    len = snprintf(buf, size, "QST %s check-in %d\n%s de %s\n\n",
+                   net, n + 1, to, fm);
+    num_lines = 2 + rand_r(seed) % 6;
+    for (i = 0; i < num_lines && len < size; i++)
+        len += snprintf(buf + len, size - len, "%s", lines[rand_r(seed) % NUM_LINES]);
+    if (len < size)
+        len += snprintf(buf + len, size - len, "\nGrid EM%02u, %u in net.\n73 de %s\n",
+                        rand_r(seed) % 100, 5 + rand_r(seed) % 30, fm);
+    return len < size ? len : size - 1;
+}
+
+int write_mbox(const char *fn, int num_msgs, unsigned int seed)
+{
+    FILE *fp;
+    char msg[MAX_BENCH_MSG_SIZE], date[64];
+    time_t t;
+    int i;
+
+    fp = fopen(fn, "w");
+    if (!fp) {
+        perror(fn);
+        return 0;
+    }
+    t = time(NULL) - (time_t)num_msgs * 600;
+    for (i = 0; i < num_msgs; i++, t += 600) {
+        strftime(date, sizeof(date), "%a %b %e %H:%M:%S %Y", gmtime(&t));
+        make_msg(msg, sizeof(msg), i, &seed);
+        fprintf(fp, "From %-10s %s To %-10s %5zu %04X ----\n", calls[i % NUM_CALLS],
+                date, calls[0], strlen(msg), i & 0xFFFF);
+        fprintf(fp, "From: %s\nTo: %s\n\n%s\n", calls[i % NUM_CALLS], calls[0], msg);
+    }
+    if (fclose(fp) != 0) {
+        perror(fn);
+        return 0;
+    }
+    return 1;
+}
+
+size_t compress_msg(const char *msg, size_t len, int zoption,
+                        unsigned char *zbuf, size_t zsize)
+{
+    z_stream zs;
+    unsigned char out[MAX_BENCH_MSG_SIZE];
+    size_t zlen;
+
+    /* deflate like arim_arq_msg_on_send_cmd(), then inflate to check */
+    memset(&zs, 0, sizeof(zs));
+    if (zdict_deflate_init(&zs, zoption) != Z_OK)
+        return 0;
+    zs.next_in = (unsigned char *)msg;
+    zs.avail_in = len;
+    zs.next_out = zbuf;
+    zs.avail_out = zsize;
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&zs);
+        return 0;
+    }
+    zlen = zs.total_out;
+    deflateEnd(&zs);
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK)
+        return 0;
+    zs.next_in = zbuf;
+    zs.avail_in = zlen;
+    zs.next_out = out;
+    zs.avail_out = sizeof(out);
+    if (zdict_inflate(&zs) != Z_STREAM_END || zs.total_out != len ||
+        memcmp(out, msg, len)) {
+        inflateEnd(&zs);
+        return 0;
+    }
+    inflateEnd(&zs);
+    return zlen;
+}
+
+int bench_mbox(const char *fn, int use_dict)
+{
+    FILE *fp;
+    static char msg[MAX_BENCH_MSG_SIZE];
+    unsigned char zbuf[MAX_BENCH_MSG_SIZE];
+    char line[MAX_BENCH_MSG_SIZE];
+    size_t len = 0, zlen, raw = 0, zsize = 0, zdsize = 0;
+    int num_msgs = 0, in_msg = 0, errs = 0, in_hdr = 0, done = 0;
+
+    fp = fopen(fn, "r");
+    if (!fp) {
+        perror(fn);
+        return 0;
+    }
+    while (!done) {
+        if (!fgets(line, sizeof(line), fp)) {
+            done = 1;
+            line[0] = '\0';
+        }
+        if (done || !strncmp(line, "From ", 5)) {
+            /* separator line, compress the previous message */
+            if (in_msg && len) {
+                /* drop the blank line mbox_add_msg() appends */
+                if (len > 1 && msg[len - 1] == '\n' && msg[len - 2] == '\n')
+                    --len;
+                raw += len;
+                zlen = compress_msg(msg, len, ZOPT_ZLIB, zbuf, sizeof(zbuf));
+                zsize += zlen;
+                errs += !zlen;
+                if (use_dict) {
+                    zlen = compress_msg(msg, len, ZOPT_DICT, zbuf, sizeof(zbuf));
+                    zdsize += zlen;
+                    errs += !zlen;
+                }
+                ++num_msgs;
+            }
+            in_msg = in_hdr = 1;
+            len = 0;
+            continue;
+        }
+        if (!in_msg)
+            continue;
+        if (in_hdr) {
+            /* the From: and To: headers aren't transmitted */
+            if (!strncmp(line, "From: ", 6) || !strncmp(line, "To: ", 4))
+                continue;
+            in_hdr = 0;
+            if (!strcmp(line, "\n"))
+                continue;
+        }
+        len += snprintf(msg + len, sizeof(msg) - len, "%s", line);
+        if (len >= sizeof(msg))
+            len = sizeof(msg) - 1;
+    }
+    fclose(fp);
+    printf("%s: %d messages, %zu bytes\n", fn, num_msgs, raw);
+    printf("-z:  %8zu bytes\n", zsize);
+    if (use_dict)
+        printf("-zd: %8zu bytes, dictionary %08lX\n", zdsize, zdict_get_id());
+    if (errs)
+        printf("%d messages failed to round-trip\n", errs);
+    return !errs;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = ".", *genfn = NULL;
+    unsigned int seed = 1;
+    int option, num_msgs = DEFAULT_NUM_MSGS, use_dict;
+
+    while ((option = getopt(argc, argv, "d:g:m:r:h")) != -1) {
+        switch (option) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'g':
+            genfn = optarg;
+            break;
+        case 'm':
+            num_msgs = atoi(optarg);
+            break;
+        case 'r':
+            seed = (unsigned int)atoi(optarg);
+            break;
+        default:
+            num_msgs = 0;
+            break;
+        }
+    }
+    if (num_msgs <= 0 || (!genfn && optind >= argc)) {
+        printf("Usage: %s -g FILE [-m MSGS] [-r SEED]\n"
+               "       %s [-d DIR] MBOX\n"
+               "Write a synthetic mailbox of MSGS (default %d) net traffic messages\n"
+               "to FILE, or compress the messages in mailbox file MBOX with '-z' and\n"
+               "with '-zd' using the %s file in DIR (default .).\n",
+               argv[0], argv[0], DEFAULT_NUM_MSGS, DEFAULT_ZDICT_FNAME);
+        return 1;
+    }
+    if (genfn)
+        return write_mbox(genfn, num_msgs, seed) ? 0 : 2;
+    snprintf(g_arim_path, sizeof(g_arim_path), "%s", dir);
+    use_dict = zdict_init();
+    if (!use_dict)
+        printf("No dictionary in %s, '-zd' not tested\n", dir);
+    return bench_mbox(argv[optind], use_dict) ? 0 : 3;
+}
+
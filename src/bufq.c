@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
+#include <errno.h>
 #include "main.h"
 #include "bufq.h"
 #include "util.h"
@@ -46,84 +48,175 @@ CMDQUEUE g_tncpi9k6_log_q;
 FILEQUEUE g_file_out_q;
 MSGQUEUE g_msg_out_q;
 
-void cmdq_init(CMDQUEUE *q)
+/* self-pipes used to wake the TNC i/o threads when outbound data is queued */
+NOTIFYPIPE g_cmd_out_notify = { { -1, -1 }, PTHREAD_MUTEX_INITIALIZER };
+NOTIFYPIPE g_data_out_notify = { { -1, -1 }, PTHREAD_MUTEX_INITIALIZER };
+
+void bufq_init()
 {
-    memset(q, 0, sizeof(CMDQUEUE));
+    /*  all queues have a single consumer, most have several producers.
+        Commands and data for the TNC must not be lost, so producers wait
+        for room, except the thread that drains the queue; its pushes fail
+        at once when the queue is full and the caller handles it. Display
+        queues keep the newest entries, logs keep the
+        oldest so that what's written is a contiguous record. */
+    cmdq_init(&g_cmd_in_q, RINGQ_MP, RINGQ_DROP_OLDEST);
+    cmdq_init(&g_cmd_out_q, RINGQ_MP, RINGQ_BLOCK);
+    dataq_init(&g_data_in_q, RINGQ_MP, RINGQ_DROP_OLDEST);
+    dataq_init(&g_data_out_q, RINGQ_MP, RINGQ_BLOCK);
+    dataq_init(&g_traffic_log_q, RINGQ_MP, RINGQ_DROP_NEWEST);
+    cmdq_init(&g_heard_q, RINGQ_MP, RINGQ_DROP_OLDEST);
+    cmdq_init(&g_recents_q, RINGQ_MP, RINGQ_DROP_OLDEST);
+    cmdq_init(&g_ptable_q, RINGQ_MP, RINGQ_DROP_OLDEST);
+    cmdq_init(&g_ctable_q, RINGQ_MP, RINGQ_DROP_OLDEST);
+    cmdq_init(&g_ftable_q, RINGQ_MP, RINGQ_DROP_OLDEST);
+    cmdq_init(&g_debug_log_q, RINGQ_MP, RINGQ_DROP_NEWEST);
+    cmdq_init(&g_tncpi9k6_log_q, RINGQ_SP, RINGQ_DROP_NEWEST); /* serial thread only */
+    fileq_init(&g_file_out_q);
+    msgq_init(&g_msg_out_q);
+}
+
+typedef struct bufq_stat {
+    const char *name;
+    RINGQ *ring;
+} BUFQSTAT;
+
+BUFQSTAT bufq_stats[] = {
+    { "cmd in",      &g_cmd_in_q.ring },
+    { "cmd out",     &g_cmd_out_q.ring },
+    { "data in",     &g_data_in_q.ring },
+    { "data out",    &g_data_out_q.ring },
+    { "traffic log", &g_traffic_log_q.ring },
+    { "debug log",   &g_debug_log_q.ring },
+    { "heard",       &g_heard_q.ring },
+    { "recents",     &g_recents_q.ring },
+    { "ping hist",   &g_ptable_q.ring },
+    { "conn hist",   &g_ctable_q.ring },
+    { "file hist",   &g_ftable_q.ring },
+    { "pi9k6 log",   &g_tncpi9k6_log_q.ring },
+};
+
+#define BUFQ_NUM_STATS  (sizeof(bufq_stats) / sizeof(bufq_stats[0]))
+
+size_t bufq_report(char *buffer, size_t size)
+{
+    size_t i, len = 0;
+    int numch;
+
+    /*  one line per queue: depth in records, bytes used, high water mark in
+        bytes, capacity and number of records dropped on overflow */
+    for (i = 0; i < BUFQ_NUM_STATS && len < size; i++) {
+        numch = snprintf(buffer + len, size - len, "%11s %4d %6zu %6zu %4zuK %6lu\n",
+                         bufq_stats[i].name, ringq_get_count(bufq_stats[i].ring),
+                             ringq_get_bytes(bufq_stats[i].ring),
+                                 ringq_get_peak_bytes(bufq_stats[i].ring),
+                                     bufq_stats[i].ring->cap / 1024,
+                                         ringq_get_drops(bufq_stats[i].ring));
+        if (numch < 0)
+            break;
+        len += numch;
+    }
+    return len < size ? len : size - 1;
+}
+
+unsigned long bufq_check_drops(char *buffer, size_t size)
+{
+    static unsigned long prev_drops[BUFQ_NUM_STATS];
+    unsigned long drops, total = 0;
+    size_t i, len = 0;
+    int numch;
+
+    /*  report queues which dropped records since last call,
+        returns total number of records dropped */
+    buffer[0] = '\0';
+    for (i = 0; i < BUFQ_NUM_STATS; i++) {
+        drops = ringq_get_drops(bufq_stats[i].ring);
+        if (drops == prev_drops[i])
+            continue;
+        numch = snprintf(buffer + len, size - len, "%s%s: %lu (peak %d recs)",
+                         total ? ", " : "Queue overflow, records dropped: ",
+                             bufq_stats[i].name, drops - prev_drops[i],
+                                 ringq_get_peak_count(bufq_stats[i].ring));
+        if (numch > 0 && len + numch < size)
+            len += numch;
+        total += drops - prev_drops[i];
+        prev_drops[i] = drops;
+    }
+    return total;
+}
+
+void cmdq_init(CMDQUEUE *q, int mp, int policy)
+{
+    ringq_init(&q->ring, q->buf, sizeof(q->buf), mp, policy);
+}
+
+void cmdq_set_consumer(CMDQUEUE *q)
+{
+    ringq_set_consumer(&q->ring);
 }
 
 int cmdq_get_size(CMDQUEUE *q)
 {
-    return q->size;
+    return ringq_get_count(&q->ring);
 }
 
 int cmdq_push(CMDQUEUE *q, const char *data)
 {
-    snprintf(q->data[q->head], sizeof(q->data[q->head]), "%s", data);
-    if (++q->head == MAX_CMDQUEUE_LEN)
-        q->head = 0;
-    /* calculate size */
-    q->size = q->head - q->tail;
-    /* when head catches up to tail buffer holds MAX_CMDQUEUE_LEN elements */
-    if (q->size <= 0)
-        q->size += MAX_CMDQUEUE_LEN;
-    return q->size;
+    size_t len;
+
+    /* store string with its terminating nul, truncated to fit record */
+    len = strlen(data);
+    if (len >= MAX_CMD_SIZE)
+        len = MAX_CMD_SIZE - 1;
+    return ringq_push(&q->ring, data, len + 1);
 }
 
 char *cmdq_pop(CMDQUEUE *q)
 {
-    int p;
+    int len;
 
-    if (!q->size)
+    len = ringq_pop(&q->ring, q->rec, sizeof(q->rec));
+    if (len <= 0)
         return NULL;
-    p = q->tail;
-    if (++q->tail >= MAX_CMDQUEUE_LEN)
-        q->tail = 0;
-    /* calculate size */
-    q->size = q->head - q->tail;
-    /* when tail catches up to head buffer holds 0 elements */
-    if (q->size < 0)
-        q->size += MAX_CMDQUEUE_LEN;
-    return q->data[p];
+    q->rec[len - 1] = '\0';
+    return q->rec;
+}
+
+void dataq_init(DATAQUEUE *q, int mp, int policy)
+{
+    ringq_init(&q->ring, q->buf, sizeof(q->buf), mp, policy);
 }
 
-void dataq_init(DATAQUEUE *q)
+void dataq_set_consumer(DATAQUEUE *q)
 {
-    memset(q, 0, sizeof(DATAQUEUE));
+    ringq_set_consumer(&q->ring);
 }
 
 int dataq_get_size(DATAQUEUE *q)
 {
-    return q->size;
+    return ringq_get_count(&q->ring);
 }
 
 int dataq_push(DATAQUEUE *q, const char *data)
 {
-    snprintf(q->data[q->head], sizeof(q->data[q->head]), "%s", data);
-    if (++q->head == MAX_DATAQUEUE_LEN)
-        q->head = 0;
-    /* calculate size */
-    q->size = q->head - q->tail;
-    /* when head catches up to tail buffer holds MAX_DATAQUEUE_LEN elements */
-    if (q->size <= 0)
-        q->size += MAX_DATAQUEUE_LEN;
-    return q->size;
+    size_t len;
+
+    /* store string with its terminating nul, truncated to fit record */
+    len = strlen(data);
+    if (len >= MIN_DATA_BUF_SIZE)
+        len = MIN_DATA_BUF_SIZE - 1;
+    return ringq_push(&q->ring, data, len + 1);
 }
 
 char *dataq_pop(DATAQUEUE *q)
 {
-    int p;
+    int len;
 
-    if (!q->size)
+    len = ringq_pop(&q->ring, q->rec, sizeof(q->rec));
+    if (len <= 0)
         return NULL;
-    p = q->tail;
-    if (++q->tail >= MAX_DATAQUEUE_LEN)
-        q->tail = 0;
-    /* calculate size */
-    q->size = q->head - q->tail;
-    /* when tail catches up to head buffer holds 0 elements */
-    if (q->size < 0)
-        q->size = MAX_DATAQUEUE_LEN;
-    return q->data[p];
+    q->rec[len - 1] = '\0';
+    return q->rec;
 }
 
 void fileq_init(FILEQUEUE *q)
@@ -208,9 +301,7 @@ MSGQUEUEITEM *msgq_pop(MSGQUEUE *q)
 
 void bufq_queue_heard(const char *text)
 {
-    pthread_mutex_lock(&mutex_heard);
     cmdq_push(&g_heard_q, text);
-    pthread_mutex_unlock(&mutex_heard);
 }
 
 void bufq_queue_traffic_log(const char *text)
@@ -221,9 +312,7 @@ void bufq_queue_traffic_log(const char *text)
     if (g_traffic_log_enable) {
         snprintf(buffer, sizeof(buffer), "[%s] %s",
                 util_timestamp(timestamp, sizeof(timestamp)), text);
-        pthread_mutex_lock(&mutex_traffic_log);
         dataq_push(&g_traffic_log_q, buffer);
-        pthread_mutex_unlock(&mutex_traffic_log);
     }
 }
 
@@ -235,9 +324,7 @@ void bufq_queue_debug_log(const char *text)
     if (g_debug_log_enable) {
         snprintf(buffer, sizeof(buffer), "[%s] %s",
                 util_timestamp_usec(timestamp, sizeof(timestamp)), text);
-        pthread_mutex_lock(&mutex_debug_log);
         cmdq_push(&g_debug_log_q, buffer);
-        pthread_mutex_unlock(&mutex_debug_log);
     }
 }
 
@@ -249,27 +336,27 @@ void bufq_queue_tncpi9k6_log(const char *text)
     if (g_tncpi9k6_log_enable) {
         snprintf(buffer, sizeof(buffer), "[%s] %s",
                 util_timestamp_usec(timestamp, sizeof(timestamp)), text);
-        pthread_mutex_lock(&mutex_tncpi9k6_log);
         cmdq_push(&g_tncpi9k6_log_q, buffer);
-        pthread_mutex_unlock(&mutex_tncpi9k6_log);
     }
 }
 
 void bufq_queue_cmd_in(const char *text)
 {
-    pthread_mutex_lock(&mutex_cmd_in);
     cmdq_push(&g_cmd_in_q, text);
-    pthread_mutex_unlock(&mutex_cmd_in);
 }
 
-void bufq_queue_cmd_out(const char *text)
+int bufq_queue_cmd_out(const char *text)
 {
     char inbuffer[MAX_CMD_SIZE];
 
+    /* returns 0 if the command was dropped because the queue is full */
     snprintf(inbuffer, sizeof(inbuffer), "%s\r", text);
-    pthread_mutex_lock(&mutex_cmd_out);
-    cmdq_push(&g_cmd_out_q, text);
-    pthread_mutex_unlock(&mutex_cmd_out);
+    if (!cmdq_push(&g_cmd_out_q, text)) {
+        bufq_queue_debug_log("Queue full: command for TNC dropped");
+        return 0;
+    }
+    bufq_notify(&g_cmd_out_notify);
+    return 1;
 }
 
 void bufq_queue_data_in(const char *text)
@@ -277,7 +364,6 @@ void bufq_queue_data_in(const char *text)
     char buffer[MIN_MSG_BUF_SIZE+MAX_TIMESTAMP_SIZE];
     char timestamp[MAX_TIMESTAMP_SIZE];
 
-    pthread_mutex_lock(&mutex_data_in);
     if (mon_timestamp) {
         snprintf(buffer, sizeof(buffer), "[%s] %s",
                 util_timestamp(timestamp, sizeof(timestamp)), text);
@@ -285,34 +371,85 @@ void bufq_queue_data_in(const char *text)
     } else {
         dataq_push(&g_data_in_q, text);
     }
-    pthread_mutex_unlock(&mutex_data_in);
 }
 
-void bufq_queue_data_out(const char *text)
+int bufq_queue_data_out(const char *text)
 {
-    pthread_mutex_lock(&mutex_data_out);
-    dataq_push(&g_data_out_q, text);
-    pthread_mutex_unlock(&mutex_data_out);
+    /* returns 0 if the data was dropped because the queue is full */
+    if (!dataq_push(&g_data_out_q, text)) {
+        bufq_queue_debug_log("Queue full: data for TNC dropped");
+        return 0;
+    }
+    bufq_notify(&g_data_out_notify);
+    return 1;
 }
 
 void bufq_queue_ptable(const char *text)
 {
-    pthread_mutex_lock(&mutex_ptable);
     cmdq_push(&g_ptable_q, text);
-    pthread_mutex_unlock(&mutex_ptable);
 }
 
 void bufq_queue_ctable(const char *text)
 {
-    pthread_mutex_lock(&mutex_ctable);
     cmdq_push(&g_ctable_q, text);
-    pthread_mutex_unlock(&mutex_ctable);
 }
 
 void bufq_queue_ftable(const char *text)
 {
-    pthread_mutex_lock(&mutex_ftable);
     cmdq_push(&g_ftable_q, text);
-    pthread_mutex_unlock(&mutex_ftable);
+}
+
+int bufq_notify_open(NOTIFYPIPE *n)
+{
+    int i;
+
+    pthread_mutex_lock(&n->mutex);
+    if (n->fd[0] == -1) {
+        if (pipe(n->fd) == -1) {
+            n->fd[0] = n->fd[1] = -1;
+        } else {
+            /* non-blocking at both ends, a full pipe means a wakeup is already pending */
+            for (i = 0; i < 2; i++)
+                fcntl(n->fd[i], F_SETFL, fcntl(n->fd[i], F_GETFL) | O_NONBLOCK);
+        }
+    }
+    pthread_mutex_unlock(&n->mutex);
+    return n->fd[0];
+}
+
+void bufq_notify_close(NOTIFYPIPE *n)
+{
+    /* lock out producers so none writes to a stale descriptor */
+    pthread_mutex_lock(&n->mutex);
+    if (n->fd[1] != -1)
+        close(n->fd[1]);
+    if (n->fd[0] != -1)
+        close(n->fd[0]);
+    n->fd[0] = n->fd[1] = -1;
+    pthread_mutex_unlock(&n->mutex);
+}
+
+void bufq_notify(NOTIFYPIPE *n)
+{
+    char c = 1;
+    ssize_t result;
+
+    pthread_mutex_lock(&n->mutex);
+    if (n->fd[1] != -1) {
+        do {
+            result = write(n->fd[1], &c, 1);
+        } while (result == -1 && errno == EINTR);
+    }
+    pthread_mutex_unlock(&n->mutex);
+}
+
+void bufq_notify_clear(NOTIFYPIPE *n)
+{
+    char buffer[64];
+
+    if (n->fd[0] != -1) {
+        while (read(n->fd[0], buffer, sizeof(buffer)) > 0)
+            ;
+    }
 }
 
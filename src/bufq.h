@@ -30,17 +30,25 @@
 #define MAX_MSGQUEUE_LEN      4
 
 #include "main.h"
+#include "ringq.h"
+
+/*  ring buffer sizes in bytes, must be powers of 2. Records are stored at
+    their actual length, most are short status or log lines, so a data queue
+    ring holds many more records than MAX_DATAQUEUE_LEN; it has room for at
+    least 7 records of the maximum size. */
+#define DATAQUEUE_RING_SIZE   (128*1024)
+#define CMDQUEUE_RING_SIZE    (MAX_CMDQUEUE_LEN*MAX_CMD_SIZE)
 
 typedef struct data_q {
-    int head, tail;
-    int size;
-    char data[MAX_DATAQUEUE_LEN][MIN_DATA_BUF_SIZE];
+    RINGQ ring;
+    char rec[MIN_DATA_BUF_SIZE]; /* last record popped, owned by consumer */
+    _Alignas(RINGQ_HDR_SIZE) unsigned char buf[DATAQUEUE_RING_SIZE];
 } DATAQUEUE;
 
 typedef struct cmd_q {
-    int head, tail;
-    int size;
-    char data[MAX_CMDQUEUE_LEN][MAX_CMD_SIZE];
+    RINGQ ring;
+    char rec[MAX_CMD_SIZE]; /* last record popped, owned by consumer */
+    _Alignas(RINGQ_HDR_SIZE) unsigned char buf[CMDQUEUE_RING_SIZE];
 } CMDQUEUE;
 
 typedef struct fileq_item {
@@ -49,6 +57,7 @@ typedef struct fileq_item {
     char name[MAX_DIR_PATH_SIZE];
     char path[MAX_DIR_PATH_SIZE];
     unsigned char data[MAX_FILE_SIZE];
+    struct fstream *stream; /* if not NULL, data is read from stream instead */
 } FILEQUEUEITEM;
 
 typedef struct file_q {
@@ -64,6 +73,11 @@ typedef struct msgq_item {
     char data[MIN_MSG_BUF_SIZE];
 } MSGQUEUEITEM;
 
+typedef struct notify_pipe {
+    int fd[2];
+    pthread_mutex_t mutex;
+} NOTIFYPIPE;
+
 typedef struct msg_q {
     int head, tail;
     int size;
@@ -84,13 +98,21 @@ extern CMDQUEUE g_debug_log_q;
 extern CMDQUEUE g_tncpi9k6_log_q;
 extern FILEQUEUE g_file_out_q;
 extern MSGQUEUE g_msg_out_q;
+extern NOTIFYPIPE g_cmd_out_notify;
+extern NOTIFYPIPE g_data_out_notify;
 
-extern void cmdq_init(CMDQUEUE *q);
+extern void bufq_init(void);
+extern size_t bufq_report(char *buffer, size_t size);
+extern unsigned long bufq_check_drops(char *buffer, size_t size);
+
+extern void cmdq_init(CMDQUEUE *q, int mp, int policy);
+extern void cmdq_set_consumer(CMDQUEUE *q);
 extern int cmdq_get_size(CMDQUEUE *q);
 extern int cmdq_push(CMDQUEUE *q, const char *data);
 extern char *cmdq_pop(CMDQUEUE *q);
 
-extern void dataq_init(DATAQUEUE *q);
+extern void dataq_init(DATAQUEUE *q, int mp, int policy);
+extern void dataq_set_consumer(DATAQUEUE *q);
 extern int dataq_get_size(DATAQUEUE *q);
 extern int dataq_push(DATAQUEUE *q, const char *data);
 extern char *dataq_pop(DATAQUEUE *q);
@@ -110,12 +132,17 @@ extern void bufq_queue_traffic_log(const char *text);
 extern void bufq_queue_debug_log(const char *text);
 extern void bufq_queue_tncpi9k6_log(const char *text);
 extern void bufq_queue_cmd_in(const char *text);
-extern void bufq_queue_cmd_out(const char *text);
+extern int bufq_queue_cmd_out(const char *text);
 extern void bufq_queue_data_in(const char *text);
-extern void bufq_queue_data_out(const char *text);
+extern int bufq_queue_data_out(const char *text);
 extern void bufq_queue_ptable(const char *text);
 extern void bufq_queue_ctable(const char *text);
 extern void bufq_queue_ftable(const char *text);
 
+extern int bufq_notify_open(NOTIFYPIPE *n);
+extern void bufq_notify_close(NOTIFYPIPE *n);
+extern void bufq_notify(NOTIFYPIPE *n);
+extern void bufq_notify_clear(NOTIFYPIPE *n);
+
 #endif
 
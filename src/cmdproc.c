@@ -56,6 +56,8 @@
 #include "bufq.h"
 #include "cmdproc.h"
 #include "tnc_attach.h"
+#include "trace.h"
+#include "zdict.h"
 
 #define MSG_SEND_FAIL_PROMPT_SAVE   1
 
@@ -64,9 +66,11 @@ int cmdproc_cmd(const char *cmd)
     static char prevbuf[MAX_CMD_SIZE];
     int state, result1, result2, numch, zoption = 0;
     char *t, *fn, *destdir, buffer[MAX_CMD_SIZE], sendcr[TNC_ARQ_SENDCR_SIZE];
+    char zcmd[MAX_CMD_SIZE];
     char msgbuffer[MAX_UNCOMP_DATA_SIZE], status[MAX_STATUS_BAR_SIZE];
-    char call1[TNC_MYCALL_SIZE], call2[TNC_MYCALL_SIZE];
+    char call1[TNC_MYCALL_SIZE], call2[TNC_MYCALL_SIZE], fpath[MAX_PATH_SIZE];
     const char *p;
+    size_t len;
 
     state = arim_get_state();
     switch (state) {
@@ -123,19 +127,21 @@ int cmdproc_cmd(const char *cmd)
                 arim_arq_send_disconn_req();
         } else {
             if (!strncasecmp(cmd, "/FGET", 5)) {
-                arim_arq_cache_cmd(cmd);
                 /* check for -z option */
                 snprintf(msgbuffer, sizeof(msgbuffer), "%s", cmd + 5);
                 fn = msgbuffer;
                 while (*fn && *fn == ' ')
                     ++fn;
-                if (*fn && (fn == strstr(fn, "-z"))) {
-                    zoption = 1;
-                    fn += 2;
+                if (*fn && (len = zdict_parse_opt(fn, &zoption))) {
+                    fn += len;
+                    /* remote needs the dictionary id for -zd */
+                    snprintf(zcmd, sizeof(zcmd), "/FGET%s%s", zdict_opt_str(zoption), fn);
+                    cmd = zcmd;
                 } else {
                     /* -z option not found, back up to start */
                     fn = msgbuffer;
                 }
+                arim_arq_cache_cmd(cmd);
                 /* check for destination dir path */
                 destdir = fn;
                 while (*destdir && *destdir != '>')
@@ -153,9 +159,8 @@ int cmdproc_cmd(const char *cmd)
                 fn = msgbuffer;
                 while (*fn && *fn == ' ')
                     ++fn;
-                if (*fn && (fn == strstr(fn, "-z"))) {
-                    zoption = 1;
-                    fn += 2;
+                if (*fn && (len = zdict_parse_opt(fn, &zoption))) {
+                    fn += len;
                 } else {
                     /* -z option not found, back up to start */
                     fn = msgbuffer;
@@ -170,35 +175,65 @@ int cmdproc_cmd(const char *cmd)
                     destdir = NULL;
                 arim_arq_files_on_client_fput(fn, destdir, zoption);
                 return 1;
-            } else if (!strncasecmp(cmd, "/MGET", 5)) {
+            } else if (!strncasecmp(cmd, "/MFGET", 6)) {
+                /* check for -z option */
+                snprintf(msgbuffer, sizeof(msgbuffer), "%s", cmd + 6);
+                fn = msgbuffer;
+                while (*fn && *fn == ' ')
+                    ++fn;
+                if (*fn && (len = zdict_parse_opt(fn, &zoption))) {
+                    fn += len;
+                    /* remote needs the dictionary id for -zd */
+                    snprintf(zcmd, sizeof(zcmd), "/MFGET%s%s", zdict_opt_str(zoption), fn);
+                    cmd = zcmd;
+                } else {
+                    /* -z option not found, back up to start */
+                    fn = msgbuffer;
+                }
                 arim_arq_cache_cmd(cmd);
+                /* check for destination dir path */
+                destdir = fn;
+                while (*destdir && *destdir != '>')
+                    ++destdir;
+                if (*destdir == '>')
+                    *destdir++ = '\0';
+                else
+                    destdir = NULL;
+                arim_arq_files_on_client_mfget(cmd, fn, destdir, zoption);
+                return 1;
+            } else if (!strncasecmp(cmd, "/MGET", 5)) {
                 /* check for -z option */
                 snprintf(msgbuffer, sizeof(msgbuffer), "%s", cmd + 5);
                 t = msgbuffer;
                 while (*t && *t == ' ')
                     ++t;
-                if (*t && (t == strstr(t, "-z"))) {
-                    zoption = 1;
-                    t += 2;
+                if (*t && (len = zdict_parse_opt(t, &zoption))) {
+                    t += len;
+                    /* remote needs the dictionary id for -zd */
+                    snprintf(zcmd, sizeof(zcmd), "/MGET%s%s", zdict_opt_str(zoption), t);
+                    cmd = zcmd;
                 } else {
                     /* -z option not found, back up to start */
                     t = msgbuffer;
                 }
+                arim_arq_cache_cmd(cmd);
                 arim_arq_msg_on_client_mget(cmd, t, zoption);
                 return 1;
             } else if (!strncasecmp(cmd, "/FLGET", 6)) {
-                arim_arq_cache_cmd(cmd);
                 /* check for -z option */
                 snprintf(buffer, sizeof(buffer), "%s", cmd + 6);
                 t = buffer;
                 while (*t && (*t == ' ' || *t == '/'))
                     ++t;
-                if (*t && (t == strstr(t, "-z"))) {
-                    zoption = 1;
-                    t += 2;
+                if (*t && (len = zdict_parse_opt(t, &zoption))) {
+                    t += len;
                     while (*t && (*t == ' ' || *t == '/'))
                         ++t;
+                    /* remote needs the dictionary id for -zd */
+                    snprintf(zcmd, sizeof(zcmd), "/FLGET%s %s", zdict_opt_str(zoption), t);
+                    cmd = zcmd;
                 }
+                arim_arq_cache_cmd(cmd);
                 /* check for dir path */
                 destdir = (*t) ? t : NULL;
                 arim_arq_files_on_client_flget(cmd, destdir, zoption);
@@ -225,9 +260,8 @@ int cmdproc_cmd(const char *cmd)
                 p = cmd + 3;
                 while (*p && *p == ' ')
                     ++p;
-                if (*p && (p == strstr(p, "-z"))) {
-                    zoption = 1;
-                    p += 2;
+                if (*p && (len = zdict_parse_opt(p, &zoption))) {
+                    p += len;
                 } else {
                     /* -z option not found, back up to start */
                     p = cmd + 3;
@@ -332,7 +366,7 @@ int cmdproc_cmd(const char *cmd)
             ui_list_shared_files();
         } else if (!strncasecmp(t, "sm", 2)) {
             t = strtok(NULL, " \t");
-            if (t && !strcmp(t, "-z")) {
+            if (t && !strncmp(t, "-z", 2)) {
                 ui_print_status("Send msg: -z option not supported in FEC mode", 1);
                 break;
             }
@@ -1018,6 +1052,21 @@ int cmdproc_cmd(const char *cmd)
             } else {
                 ui_print_status("Cannot send beacon: no TNC attached", 1);
             }
+        } else if (!strncasecmp(t, "qstat", 5)) {
+            numch = snprintf(msgbuffer, sizeof(msgbuffer),
+                             "\tMESSAGE QUEUE STATUS\n \n"
+                             "      queue recs  bytes   peak   cap  drops\n");
+            numch += bufq_report(msgbuffer + numch, sizeof(msgbuffer) - numch);
+            snprintf(msgbuffer + numch, sizeof(msgbuffer) - numch, " \n\t[O]k");
+            ui_show_dialog(msgbuffer, " oO\n");
+        } else if (!strncasecmp(t, "trace", 5)) {
+            if (trace_dump(fpath, sizeof(fpath)))
+                numch = snprintf(status, sizeof(status), "Trace dumped to %s", fpath);
+            else
+                numch = snprintf(status, sizeof(status), "Failed to dump trace to %s", fpath);
+            if (numch >= sizeof(status))
+                ui_truncate_line(status, sizeof(status));
+            ui_print_status(status, 1);
         } else if (!strncasecmp(t, "clrmon", 6)) {
             ui_clear_data_in();
             ui_print_status("Traffic Monitor view cleared", 1);
@@ -38,14 +38,12 @@
 #include "ardop_cmds.h"
 #include "tnc_attach.h"
 
-void cmdthread_next_cmd_out(int sock)
+int cmdthread_next_cmd_out(int sock)
 {
     char *cmd, inbuffer[MAX_CMD_SIZE];
     int sent;
 
-    pthread_mutex_lock(&mutex_cmd_out);
     cmd = cmdq_pop(&g_cmd_out_q);
-    pthread_mutex_unlock(&mutex_cmd_out);
     if (cmd) {
         snprintf(inbuffer, sizeof(inbuffer), "%s\r", cmd);
         sent = write(sock, inbuffer, strlen(inbuffer));
@@ -56,20 +54,24 @@ void cmdthread_next_cmd_out(int sock)
             bufq_queue_cmd_in(inbuffer);
             bufq_queue_debug_log(inbuffer);
         }
+        return 1;
     }
+    return 0;
 }
 
-void *cmdthread_func(void *data)
+void cmdthread_drain_cmd_out(int sock)
+{
+    /* send everything queued so far, a burst of commands
+       shouldn't trickle out at one per select timeout */
+    while (cmdthread_next_cmd_out(sock))
+        ;
+}
+
+int cmdthread_connect()
 {
-    int cmdsock;
-    char buffer[MAX_CMD_SIZE];
     struct addrinfo hints, *res = NULL;
-    fd_set cmdreadfds, cmderrorfds;
-    struct timeval timeout;
-    ssize_t rsize;
-    int result;
+    int cmdsock;
 
-    bufq_queue_debug_log("Cmd thread: initializing");
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_UNSPEC;  /* IPv4 or IPv6 */
     hints.ai_socktype = SOCK_STREAM;
@@ -77,16 +79,55 @@ void *cmdthread_func(void *data)
     if (!res)
     {
         bufq_queue_debug_log("Cmd thread: failed to resolve IP address");
-        g_cmdthread_stop = 1;
-        pthread_exit(data);
+        return -1;
     }
     cmdsock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
     if (connect(cmdsock, res->ai_addr, res->ai_addrlen) == -1) {
         bufq_queue_debug_log("Cmd thread: failed to open TCP socket");
+        freeaddrinfo(res);
+        close(cmdsock);
+        return -1;
+    }
+    freeaddrinfo(res);
+    return cmdsock;
+}
+
+void cmdthread_on_read(int sock)
+{
+    char buffer[MAX_CMD_SIZE];
+    ssize_t rsize;
+
+    rsize = read(sock, buffer, sizeof(buffer) - 1);
+    if (rsize == 0) {
+        bufq_queue_debug_log("Cmd thread: Socket closed by TNC");
+        tnc_detach(); /* close TCP connection to TNC */
+    } else if (rsize == -1) {
+        bufq_queue_debug_log("Cmd thread: Socket read error (-1)");
+    } else {
+        ardop_cmds_proc_resp(buffer, rsize);
+    }
+}
+
+void *cmdthread_func(void *data)
+{
+    int cmdsock, notifyfd, maxfd;
+    fd_set cmdreadfds, cmderrorfds;
+    struct timeval timeout;
+    int result;
+
+    bufq_queue_debug_log("Cmd thread: initializing");
+    cmdsock = cmdthread_connect();
+    if (cmdsock == -1) {
         g_cmdthread_stop = 1;
         pthread_exit(data);
     }
-    freeaddrinfo(res);
+    /* this thread drains the cmd queue, it mustn't block pushing to it */
+    cmdq_set_consumer(&g_cmd_out_q);
+    /* wakeup pipe signalled when commands are queued */
+    notifyfd = bufq_notify_open(&g_cmd_out_notify);
+    if (notifyfd == -1)
+        bufq_queue_debug_log("Cmd thread: failed to open notify pipe, polling cmd queue");
+    maxfd = notifyfd > cmdsock ? notifyfd : cmdsock;
     g_cmdthread_ready = 1;
     snprintf(g_tnc_settings[g_cur_tnc].busy,
         sizeof(g_tnc_settings[g_cur_tnc].busy), "%s", "FALSE");
@@ -96,28 +137,27 @@ void *cmdthread_func(void *data)
         FD_ZERO(&cmderrorfds);
         FD_SET(cmdsock, &cmdreadfds);
         FD_SET(cmdsock, &cmderrorfds);
+        if (notifyfd != -1)
+            FD_SET(notifyfd, &cmdreadfds);
         timeout.tv_sec = 0;
         timeout.tv_usec = 200000;
-        result = select(cmdsock + 1, &cmdreadfds, (fd_set *)0, &cmderrorfds, &timeout);
+        result = select(maxfd + 1, &cmdreadfds, (fd_set *)0, &cmderrorfds, &timeout);
         switch (result) {
         case 0:
-            cmdthread_next_cmd_out(cmdsock);
+            /* fallback in case a wakeup was missed */
+            cmdthread_drain_cmd_out(cmdsock);
             break;
         case -1:
             bufq_queue_debug_log("Cmd thread: Socket select error (-1)");
             break;
         default:
-            if (FD_ISSET(cmdsock, &cmdreadfds)) {
-                rsize = read(cmdsock, buffer, sizeof(buffer) - 1);
-                if (rsize == 0) {
-                    bufq_queue_debug_log("Cmd thread: Socket closed by TNC");
-                    tnc_detach(); /* close TCP connection to TNC */
-                } else if (rsize == -1) {
-                    bufq_queue_debug_log("Cmd thread: Socket read error (-1)");
-                } else {
-                    ardop_cmds_proc_resp(buffer, rsize);
-                }
+            if (notifyfd != -1 && FD_ISSET(notifyfd, &cmdreadfds)) {
+                /* clear wakeup before draining so later pushes aren't lost */
+                bufq_notify_clear(&g_cmd_out_notify);
+                cmdthread_drain_cmd_out(cmdsock);
             }
+            if (FD_ISSET(cmdsock, &cmdreadfds))
+                cmdthread_on_read(cmdsock);
             if (FD_ISSET(cmdsock, &cmderrorfds)) {
                 bufq_queue_debug_log("Cmd thread: Socket select error (FD_ISSET)");
                 break;
@@ -131,6 +171,7 @@ void *cmdthread_func(void *data)
         sizeof(g_tnc_settings[g_cur_tnc].busy), "%s", "FALSE");
     bufq_queue_debug_log("Cmd thread: terminating");
     sleep(2);
+    bufq_notify_close(&g_cmd_out_notify);
     close(cmdsock);
     return data;
 }
@@ -25,6 +25,9 @@
 #define _CMDTHREAD_H_INCLUDED_
 
 extern void *cmdthread_func(void *data);
+extern int cmdthread_connect(void);
+extern void cmdthread_on_read(int sock);
+extern void cmdthread_drain_cmd_out(int sock);
 
 #endif
 
@@ -34,6 +34,8 @@
 #include <time.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
 #include <ctype.h>
 #include "main.h"
 #include "datathread.h"
@@ -43,15 +45,45 @@
 #include "bufq.h"
 #include "ardop_data.h"
 #include "tnc_attach.h"
+#include "tnc_flow.h"
+#include "trace.h"
+#include "fstream.h"
 
-/* 10 second wait before next check of TNC's BUFFER count */
-#define TNC_BUFFER_UPDATE_WAIT  50
 #define TNC_DATA_BLOCK_SIZE     2048
 
-static size_t data_send_nrem, file_send_nrem, msg_send_nrem, send_bytes_buffered;
-static int data_send_nblk, data_send_timer;
-static int file_send_nblk, file_send_timer;
-static int msg_send_nblk, msg_send_timer;
+/*  Outbound work item types. Items are taken from the queues in order of
+    priority whenever the previous item has been completely written to the
+    TNC; an item is never preempted part way through since the ARQ data
+    stream would be corrupted by interleaving another item's bytes. */
+#define OUT_ITEM_NONE           0
+#define OUT_ITEM_ARQ_LINE       1
+#define OUT_ITEM_FEC_FRAME      2
+#define OUT_ITEM_MSG            3
+#define OUT_ITEM_FILE           4
+
+typedef struct out_item {
+    int type;
+    const unsigned char *data;
+    FSTREAM *stream;
+    size_t size;
+    size_t sent;
+} OUTITEM;
+
+static OUTITEM out_item;
+static size_t send_bytes_buffered;
+/* set when a FECSEND command couldn't be queued, it's retried on the next pass */
+static int fecsend_pending;
+/* block of a streamed file being written, see fstream.c */
+static unsigned char stream_block[TNC_DATA_BLOCK_SIZE];
+
+/*  Frame being written to the data port. The 2 byte ARDOP length header is
+    sent together with the payload, which stays in place in the queued item,
+    by writev(). The socket is non-blocking, so a frame may be written in
+    several parts; frame_off counts header and payload bytes sent so far. */
+static int frame_pending;
+static unsigned char frame_hdr[2];
+static const unsigned char *frame_data;
+static size_t frame_len, frame_off;
 
 size_t datathread_get_num_bytes_buffered()
 {
@@ -61,167 +93,32 @@ size_t datathread_get_num_bytes_buffered()
 void datathread_cancel_send_data_out()
 {
     /* reset TNC transmit data buffering state */
-    data_send_nrem = file_send_nrem = msg_send_nrem = send_bytes_buffered = 0;
-    data_send_nblk = file_send_nblk = msg_send_nblk = 0;
-    data_send_timer = file_send_timer = msg_send_timer = 0;
+    memset(&out_item, 0, sizeof(out_item));
+    send_bytes_buffered = 0;
+    fecsend_pending = 0;
+    /* a partly written frame must be finished to keep data port framing intact */
+    if (!frame_off)
+        frame_pending = 0;
+    tnc_flow_reset();
 }
 
-void datathread_send_file_out(int sock)
+int datathread_write_pending()
 {
-    static FILEQUEUEITEM *item;
-    static char *p, buffer[MAX_FILE_SIZE+4];
-    static unsigned char *s;
-    size_t sent;
-
-    if (msg_send_nblk || msg_send_nrem || data_send_nblk || data_send_nrem)
-        return;
-    if (!file_send_nblk && !file_send_nrem) {
-        pthread_mutex_lock(&mutex_file_out);
-        item = fileq_pop(&g_file_out_q);
-        pthread_mutex_unlock(&mutex_file_out);
-        if (!item)
-            return;
-        bufq_queue_debug_log("Data thread: sending file to TNC");
-        p = buffer;
-        s = item->data;
-        file_send_nblk = item->size / TNC_DATA_BLOCK_SIZE;
-        file_send_nrem = item->size % TNC_DATA_BLOCK_SIZE;
-        send_bytes_buffered = 0;
-        file_send_timer = 0;
-    }
-    /*  BUFFER notifications from TNC are several seconds apart when transmitting.
-        Don't proceed until timer has expired to save the overhead of checking
-        the BUFFER value every time function is called (multiple times per sec). */
-    if (file_send_timer && --file_send_timer > 0)
-        return;
-    if (file_send_nblk) {
-        if (arim_get_buffer_cnt() >= TNC_DATA_BLOCK_SIZE) {
-            file_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-            return;
-        }
-        bufq_queue_debug_log("Data thread: writing block of data to socket");
-        *p++ = (TNC_DATA_BLOCK_SIZE >> 8) & 0xFF;
-        *p++ = TNC_DATA_BLOCK_SIZE & 0xFF;
-        memcpy(p, s, TNC_DATA_BLOCK_SIZE);
-        sent = write(sock, buffer, TNC_DATA_BLOCK_SIZE + 2);
-        if (sent < 0) {
-            bufq_queue_debug_log("Data thread: write to socket failed");
-            datathread_cancel_send_data_out();
-            return;
-        }
-        s += TNC_DATA_BLOCK_SIZE;
-        p = buffer;
-        ardop_data_inc_num_bytes_out(TNC_DATA_BLOCK_SIZE);
-        send_bytes_buffered += TNC_DATA_BLOCK_SIZE;
-        --file_send_nblk;
-        file_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-        return;
-    }
-    if (!file_send_nblk && file_send_nrem) {
-        if (arim_get_buffer_cnt() >= TNC_DATA_BLOCK_SIZE) {
-            file_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-            return;
-        }
-        bufq_queue_debug_log("Data thread: writing remainder of data to socket");
-        *p++ = (file_send_nrem >> 8) & 0xFF;
-        *p++ = file_send_nrem & 0xFF;
-        memcpy(p, s, file_send_nrem);
-        sent = write(sock, buffer, file_send_nrem + 2);
-        if (sent < 0) {
-            bufq_queue_debug_log("Data thread: write to socket failed");
-            datathread_cancel_send_data_out();
-            return;
-        }
-        ardop_data_inc_num_bytes_out(file_send_nrem + 2);
-        send_bytes_buffered += file_send_nrem;
-        file_send_nrem = 0;
-    }
+    return frame_pending;
 }
 
-void datathread_send_msg_out(int sock)
+int datathread_next_item(OUTITEM *item)
 {
-    static MSGQUEUEITEM *item;
-    static char *p, *s, buffer[MIN_MSG_BUF_SIZE];
-    size_t sent;
-
-    if (file_send_nblk || file_send_nrem || data_send_nblk || data_send_nrem)
-        return;
-    if (!msg_send_nblk && !msg_send_nrem) {
-        pthread_mutex_lock(&mutex_msg_out);
-        item = msgq_pop(&g_msg_out_q);
-        pthread_mutex_unlock(&mutex_msg_out);
-        if (!item)
-            return;
-        bufq_queue_debug_log("Data thread: sending message to TNC");
-        p = buffer;
-        s = item->data;
-        msg_send_nblk = item->size / TNC_DATA_BLOCK_SIZE;
-        msg_send_nrem = item->size % TNC_DATA_BLOCK_SIZE;
-        send_bytes_buffered = 0;
-        msg_send_timer = 0;
-    }
-    /*  BUFFER notifications from TNC are several seconds apart when transmitting.
-        Don't proceed until timer has expired to save the overhead of checking
-        the BUFFER value every time function is called (multiple times per sec). */
-    if (msg_send_timer && --msg_send_timer > 0)
-        return;
-    if (msg_send_nblk) {
-        if (arim_get_buffer_cnt() >= TNC_DATA_BLOCK_SIZE) {
-            msg_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-            return;
-        }
-        bufq_queue_debug_log("Data thread: writing block of data to socket");
-        *p++ = (TNC_DATA_BLOCK_SIZE >> 8) & 0xFF;
-        *p++ = TNC_DATA_BLOCK_SIZE & 0xFF;
-        memcpy(p, s, TNC_DATA_BLOCK_SIZE);
-        sent = write(sock, buffer, TNC_DATA_BLOCK_SIZE + 2);
-        if (sent < 0) {
-            bufq_queue_debug_log("Data thread: write to socket failed");
-            datathread_cancel_send_data_out();
-            return;
-        }
-        s += TNC_DATA_BLOCK_SIZE;
-        p = buffer;
-        ardop_data_inc_num_bytes_out(TNC_DATA_BLOCK_SIZE);
-        send_bytes_buffered += TNC_DATA_BLOCK_SIZE;
-        --msg_send_nblk;
-        msg_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-        return;
-    }
-    if (!msg_send_nblk && msg_send_nrem) {
-        if (arim_get_buffer_cnt() >= TNC_DATA_BLOCK_SIZE) {
-            msg_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-            return;
-        }
-        bufq_queue_debug_log("Data thread: writing remainder of data to socket");
-        *p++ = (msg_send_nrem >> 8) & 0xFF;
-        *p++ = msg_send_nrem & 0xFF;
-        memcpy(p, s, msg_send_nrem);
-        sent = write(sock, buffer, msg_send_nrem + 2);
-        if (sent < 0) {
-            bufq_queue_debug_log("Data thread: write to socket failed");
-            datathread_cancel_send_data_out();
-            return;
-        }
-        ardop_data_inc_num_bytes_out(msg_send_nrem + 2);
-        send_bytes_buffered += msg_send_nrem;
-        msg_send_nrem = 0;
-    }
-}
+    static char buffer[MIN_DATA_BUF_SIZE];
+    FILEQUEUEITEM *fitem;
+    MSGQUEUEITEM *mitem;
+    char *data;
+    size_t len;
 
-void datathread_send_data_out(int sock)
-{
-    static char *p, *s, *data, buffer[MIN_DATA_BUF_SIZE];
-    size_t len, sent;
-
-    if (file_send_nblk || file_send_nrem || msg_send_nblk || msg_send_nrem)
-        return;
-    if (!data_send_nblk && !data_send_nrem) {
-        pthread_mutex_lock(&mutex_data_out);
-        data = dataq_pop(&g_data_out_q);
-        pthread_mutex_unlock(&mutex_data_out);
-        if (!data)
-            return;
+    /* ARQ control lines and FEC frames go first, they're short and
+       the remote station may be waiting for them */
+    data = dataq_pop(&g_data_out_q);
+    if (data) {
         bufq_queue_debug_log("Data thread: sending data to TNC");
         len = strlen(data);
         if (arim_test_frame(data, len))
@@ -232,141 +129,268 @@ void datathread_send_data_out(int sock)
             snprintf(buffer, sizeof(buffer), "<< [U] %s", data);
         bufq_queue_data_in(buffer);
         bufq_queue_traffic_log(buffer);
-        p = buffer;
-        s = data;
-        data_send_nblk = len / TNC_DATA_BLOCK_SIZE;
-        data_send_nrem = len % TNC_DATA_BLOCK_SIZE;
-        send_bytes_buffered = 0;
-        data_send_timer = 0;
+        item->type = arim_is_arq_state() ? OUT_ITEM_ARQ_LINE : OUT_ITEM_FEC_FRAME;
+        item->data = (unsigned char *)data;
+        item->stream = NULL;
+        item->size = len;
+        item->sent = 0;
+        return 1;
     }
-    if (data_send_timer && --data_send_timer > 0)
-        return;
-    if (data_send_nblk) {
-        if (arim_get_buffer_cnt() >= TNC_DATA_BLOCK_SIZE) {
-            data_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-            return;
+    pthread_mutex_lock(&mutex_msg_out);
+    mitem = msgq_pop(&g_msg_out_q);
+    pthread_mutex_unlock(&mutex_msg_out);
+    if (mitem) {
+        bufq_queue_debug_log("Data thread: sending message to TNC");
+        item->type = OUT_ITEM_MSG;
+        item->data = (unsigned char *)mitem->data;
+        item->stream = NULL;
+        item->size = mitem->size;
+        item->sent = 0;
+        return 1;
+    }
+    pthread_mutex_lock(&mutex_file_out);
+    fitem = fileq_pop(&g_file_out_q);
+    pthread_mutex_unlock(&mutex_file_out);
+    if (fitem) {
+        bufq_queue_debug_log("Data thread: sending file to TNC");
+        item->type = OUT_ITEM_FILE;
+        item->data = fitem->data;
+        item->stream = fitem->stream;
+        item->size = fitem->size;
+        item->sent = 0;
+        return 1;
+    }
+    return 0;
+}
+
+size_t datathread_next_block_size(size_t nrem)
+{
+    size_t credit;
+
+    /* limit block size to the credit granted by TNC flow control */
+    credit = tnc_flow_get_credit();
+    if (credit > TNC_DATA_BLOCK_SIZE)
+        credit = TNC_DATA_BLOCK_SIZE;
+    return nrem < credit ? nrem : credit;
+}
+
+void datathread_start_frame(const unsigned char *s, size_t len)
+{
+    frame_hdr[0] = (len >> 8) & 0xFF;
+    frame_hdr[1] = len & 0xFF;
+    frame_data = s;
+    frame_len = len;
+    frame_off = 0;
+    frame_pending = 1;
+    trace_record(TRACE_DATA_TX, (int)len, out_item.type, (int)out_item.sent);
+    /* bytes are committed to the TNC's buffer as soon as the frame is started */
+    tnc_flow_on_write(len);
+}
+
+int datathread_flush_frame(int sock)
+{
+    struct iovec iov[2];
+    ssize_t sent;
+    int iovcnt;
+
+    while (frame_off < frame_len + 2) {
+        if (frame_off < 2) {
+            iov[0].iov_base = frame_hdr + frame_off;
+            iov[0].iov_len = 2 - frame_off;
+            iov[1].iov_base = (void *)frame_data;
+            iov[1].iov_len = frame_len;
+            iovcnt = 2;
+        } else {
+            iov[0].iov_base = (void *)(frame_data + frame_off - 2);
+            iov[0].iov_len = frame_len + 2 - frame_off;
+            iovcnt = 1;
         }
-        bufq_queue_debug_log("Data thread: writing block of data to socket");
-        *p++ = (TNC_DATA_BLOCK_SIZE >> 8) & 0xFF;
-        *p++ = TNC_DATA_BLOCK_SIZE & 0xFF;
-        memcpy(p, s, TNC_DATA_BLOCK_SIZE);
-        sent = write(sock, buffer, TNC_DATA_BLOCK_SIZE + 2);
+        sent = writev(sock, iov, iovcnt);
         if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                trace_record(TRACE_DATA_TX_WAIT, (int)frame_off, (int)frame_len + 2, 0);
+                return 0; /* socket full, resume when writable */
+            }
             bufq_queue_debug_log("Data thread: write to socket failed");
+            frame_pending = frame_off = 0;
             datathread_cancel_send_data_out();
-            return;
+            return -1;
         }
-        s += TNC_DATA_BLOCK_SIZE;
-        p = buffer;
-        ardop_data_inc_num_bytes_out(TNC_DATA_BLOCK_SIZE);
-        send_bytes_buffered += TNC_DATA_BLOCK_SIZE;
-        --data_send_nblk;
-        if (!arim_is_arq_state())
-            bufq_queue_cmd_out("FECSEND TRUE");
-        data_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-        return;
+        frame_off += sent;
     }
-    if (!data_send_nblk && data_send_nrem) {
-        if (arim_get_buffer_cnt() >= TNC_DATA_BLOCK_SIZE) {
-            data_send_timer = TNC_BUFFER_UPDATE_WAIT; /* wait for next BUFFER notification */
-            return;
+    frame_pending = frame_off = 0;
+    ardop_data_inc_num_bytes_out(frame_len);
+    return 1;
+}
+
+void datathread_send_out(int sock)
+{
+    size_t len;
+
+    if (fecsend_pending && bufq_queue_cmd_out("FECSEND TRUE"))
+        fecsend_pending = 0;
+    while (1) {
+        if (frame_pending) {
+            if (datathread_flush_frame(sock) <= 0)
+                return;
+            if (out_item.type == OUT_ITEM_NONE)
+                continue; /* send was cancelled while frame was in progress */
+            out_item.sent += frame_len;
+            send_bytes_buffered += frame_len;
+            if (out_item.type == OUT_ITEM_FEC_FRAME && !bufq_queue_cmd_out("FECSEND TRUE"))
+                fecsend_pending = 1;
         }
-        bufq_queue_debug_log("Data thread: writing remainder of data to socket");
-        *p++ = (data_send_nrem >> 8) & 0xFF;
-        *p++ = data_send_nrem & 0xFF;
-        memcpy(p, s, data_send_nrem);
-        sent = write(sock, buffer, data_send_nrem + 2);
-        if (sent < 0) {
-            bufq_queue_debug_log("Data thread: write to socket failed");
-            datathread_cancel_send_data_out();
+        if (out_item.type == OUT_ITEM_NONE) {
+            if (!datathread_next_item(&out_item))
+                return;
+            send_bytes_buffered = 0;
+            tnc_flow_xfer_begin();
+        }
+        if (out_item.sent == out_item.size) {
+            tnc_flow_xfer_end();
+            out_item.type = OUT_ITEM_NONE;
+            continue;
+        }
+        /* refill TNC's buffer up to its high water mark, then wait
+           for a BUFFER notification to wake the thread again */
+        len = datathread_next_block_size(out_item.size - out_item.sent);
+        if (!len)
             return;
+        bufq_queue_debug_log("Data thread: writing block of data to socket");
+        if (out_item.stream) {
+            /* large file, read and compress next block on demand */
+            len = fstream_read(out_item.stream, stream_block, len);
+            datathread_start_frame(stream_block, len);
+        } else {
+            datathread_start_frame(out_item.data + out_item.sent, len);
         }
-        ardop_data_inc_num_bytes_out(data_send_nrem + 2);
-        send_bytes_buffered += data_send_nrem;
-        data_send_nrem = 0;
-        if (!arim_is_arq_state())
-            bufq_queue_cmd_out("FECSEND TRUE");
     }
 }
 
-void *datathread_func(void *data)
+int datathread_connect()
 {
-    unsigned char buffer[MIN_DATA_BUF_SIZE];
+    char portstr[12]; /* room for any int */
     struct addrinfo hints, *res = NULL;
-    fd_set datareadfds, dataerrorfds;
-    struct timeval timeout;
-    ssize_t rsize;
-    int result, portnum, datasock, arim_timeout;
-    time_t cur_time;
+    int portnum, datasock;
 
     memset(&hints, 0, sizeof hints);
-    bufq_queue_debug_log("Data thread: initializing");
     hints.ai_family = AF_UNSPEC;  /* IPv4 or IPv6 */
     hints.ai_socktype = SOCK_STREAM;
     portnum = atoi(g_tnc_settings[g_cur_tnc].port) + 1;
-    snprintf((char *)buffer, sizeof(buffer), "%d", portnum);
-    getaddrinfo(g_tnc_settings[g_cur_tnc].ipaddr, (char *)buffer, &hints, &res);
+    snprintf(portstr, sizeof(portstr), "%d", portnum);
+    getaddrinfo(g_tnc_settings[g_cur_tnc].ipaddr, portstr, &hints, &res);
     if (!res)
     {
         bufq_queue_debug_log("Data thread: failed to resolve IP address");
-        g_datathread_stop = 1;
-        pthread_exit(data);
+        return -1;
     }
     datasock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
     if (connect(datasock, res->ai_addr, res->ai_addrlen) == -1) {
         bufq_queue_debug_log("Data thread: failed to open TCP socket");
+        freeaddrinfo(res);
+        close(datasock);
+        return -1;
+    }
+    freeaddrinfo(res);
+    ardop_data_reset_rx();
+    /* writes are resumed when the socket is writable, see datathread_flush_frame() */
+    fcntl(datasock, F_SETFL, fcntl(datasock, F_GETFL, 0) | O_NONBLOCK);
+    return datasock;
+}
+
+void datathread_on_read(int sock)
+{
+    unsigned char buffer[MIN_DATA_BUF_SIZE];
+    ssize_t rsize;
+
+    rsize = read(sock, buffer, sizeof(buffer) - 1);
+    if (rsize == 0) {
+        bufq_queue_debug_log("Data thread: Socket closed by TNC");
+        tnc_detach(); /* close TCP connection to TNC */
+    } else if (rsize == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            bufq_queue_debug_log("Data thread: Socket read error (-1)");
+    } else {
+        ardop_data_handle_data(buffer, rsize);
+    }
+}
+
+void datathread_on_periodic(int sock, int arim_timeout)
+{
+    time_t cur_time;
+
+    arim_on_event(EV_PERIODIC, 0);
+    datathread_send_out(sock);
+    if (arim_data_waiting) {
+        cur_time = time(NULL);
+        if (cur_time - arim_start_time > arim_timeout) {
+            /* timeout, reset arim state */
+            arim_reset();
+            arim_data_waiting = arim_start_time = 0;
+            bufq_queue_debug_log("Data thread: ARIM frame time out");
+            arim_on_event(EV_FRAME_TO, 0);
+        }
+    }
+    /* pump outbound and inbound arq line queues */
+    arim_arq_on_cmd(NULL, 0);
+    arim_arq_on_resp(NULL, 0);
+}
+
+void *datathread_func(void *data)
+{
+    fd_set datareadfds, datawritefds, dataerrorfds;
+    struct timeval timeout;
+    int result, datasock, notifyfd, maxfd, arim_timeout;
+
+    bufq_queue_debug_log("Data thread: initializing");
+    datasock = datathread_connect();
+    if (datasock == -1) {
         g_datathread_stop = 1;
         pthread_exit(data);
     }
-    freeaddrinfo(res);
+    /* this thread drains the data queue, it mustn't block pushing to it */
+    dataq_set_consumer(&g_data_out_q);
+    /* wakeup pipe signalled when data is queued or TNC's buffer drains */
+    notifyfd = bufq_notify_open(&g_data_out_notify);
+    if (notifyfd == -1)
+        bufq_queue_debug_log("Data thread: failed to open notify pipe, polling data queues");
+    maxfd = notifyfd > datasock ? notifyfd : datasock;
     g_datathread_ready = 1;
     /* timeout specified in secs */
     arim_timeout = atoi(g_arim_settings.frame_timeout);
     arim_reset();
     while (1) {
         FD_ZERO(&datareadfds);
+        FD_ZERO(&datawritefds);
         FD_ZERO(&dataerrorfds);
         FD_SET(datasock, &datareadfds);
         FD_SET(datasock, &dataerrorfds);
+        if (datathread_write_pending())
+            FD_SET(datasock, &datawritefds);
+        if (notifyfd != -1)
+            FD_SET(notifyfd, &datareadfds);
         timeout.tv_sec = 0;
         timeout.tv_usec = 200000;
-        result = select(datasock + 1, &datareadfds, (fd_set *)0, &dataerrorfds, &timeout);
+        result = select(maxfd + 1, &datareadfds, &datawritefds, &dataerrorfds, &timeout);
         switch (result) {
         case 0:
             /* select timeout */
-            arim_on_event(EV_PERIODIC, 0);
-            datathread_send_data_out(datasock);
-            datathread_send_file_out(datasock);
-            datathread_send_msg_out(datasock);
-            if (arim_data_waiting) {
-                cur_time = time(NULL);
-                if (cur_time - arim_start_time > arim_timeout) {
-                    /* timeout, reset arim state */
-                    arim_reset();
-                    arim_data_waiting = arim_start_time = 0;
-                    bufq_queue_debug_log("Data thread: ARIM frame time out");
-                    arim_on_event(EV_FRAME_TO, 0);
-                }
-            }
-            /* pump outbound and inbound arq line queues */
-            arim_arq_on_cmd(NULL, 0);
-            arim_arq_on_resp(NULL, 0);
+            datathread_on_periodic(datasock, arim_timeout);
             break;
         case -1:
             bufq_queue_debug_log("Data thread: Socket select error (-1)");
             break;
         default:
-            if (FD_ISSET(datasock, &datareadfds)) {
-                rsize = read(datasock, buffer, sizeof(buffer) - 1);
-                if (rsize == 0) {
-                    bufq_queue_debug_log("Data thread: Socket closed by TNC");
-                    tnc_detach(); /* close TCP connection to TNC */
-                } else if (rsize == -1) {
-                    bufq_queue_debug_log("Data thread: Socket read error (-1)");
-                } else {
-                    ardop_data_handle_data(buffer, rsize);
-                }
+            if (notifyfd != -1 && FD_ISSET(notifyfd, &datareadfds)) {
+                bufq_notify_clear(&g_data_out_notify);
+                datathread_send_out(datasock);
             }
+            if (FD_ISSET(datasock, &datawritefds))
+                datathread_send_out(datasock);
+            if (FD_ISSET(datasock, &datareadfds))
+                datathread_on_read(datasock);
             if (FD_ISSET(datasock, &dataerrorfds)) {
                 bufq_queue_debug_log("Data thread: Socket select error (FD_ISSET)");
                 break;
@@ -378,6 +402,7 @@ void *datathread_func(void *data)
     }
     bufq_queue_debug_log("Data thread: terminating");
     sleep(2);
+    bufq_notify_close(&g_data_out_notify);
     close(datasock);
     return data;
 }
@@ -30,6 +30,11 @@ extern size_t datathread_get_num_bytes_out(void);
 extern void datathread_reset_num_bytes(void);
 extern void datathread_cancel_send_data_out(void);
 extern size_t datathread_get_num_bytes_buffered(void);
+extern int datathread_connect(void);
+extern void datathread_on_read(int sock);
+extern void datathread_on_periodic(int sock, int arim_timeout);
+extern void datathread_send_out(int sock);
+extern int datathread_write_pending(void);
 
 #endif
 
@@ -0,0 +1,205 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "fstream.h"
+#include "farc.h"
+
+/*  File archives for batched /MFGET transfers. The files matching a
+    pattern are packed into one buffer behind a small text manifest,
+    so they go out as a single /FPUT sharing one compression context
+    and one set of handshakes:
+
+        FARC1 <count>\n
+        <size> <name>\n         (one line per file)
+        <file data>             (concatenated in manifest order)
+
+    Names are base names only, the receiver unpacks into its download
+    directory or the one named in the command. */
+
+typedef struct farc_entry {
+    char name[FARC_MAX_NAME_SIZE];
+    size_t size;
+} FARC_ENTRY;
+
+int farc_cmp_entry(const void *a, const void *b)
+{
+    return strcmp(((const FARC_ENTRY *)a)->name, ((const FARC_ENTRY *)b)->name);
+}
+
+int farc_check_name(const char *name)
+{
+    size_t len;
+
+    /* no paths, hidden files, partial downloads or password digest */
+    len = strlen(name);
+    if (!len || len >= FARC_MAX_NAME_SIZE || name[0] == '.' ||
+        strchr(name, '/') || strchr(name, '\n') ||
+        strstr(name, DEFAULT_DIGEST_FNAME))
+        return 0;
+    if (len > strlen(FSTREAM_PART_EXT) &&
+        !strcmp(name + len - strlen(FSTREAM_PART_EXT), FSTREAM_PART_EXT))
+        return 0;
+    if (len > strlen(FSTREAM_CKPT_EXT) &&
+        !strcmp(name + len - strlen(FSTREAM_CKPT_EXT), FSTREAM_CKPT_EXT))
+        return 0;
+    return 1;
+}
+
+size_t farc_pack(const char *dpath, const char *pattern,
+                     char *buf, size_t size, int *count, int *skipped)
+{
+    static FARC_ENTRY entries[FARC_MAX_FILES];
+    DIR *dirp;
+    FILE *fp;
+    struct dirent *dent;
+    struct stat st;
+    char fpath[MAX_PATH_SIZE*2+FARC_MAX_NAME_SIZE];
+    size_t len, total;
+    int i, n = 0, numch;
+
+    *count = *skipped = 0;
+    dirp = opendir(dpath);
+    if (!dirp)
+        return 0;
+    /* room for the first manifest line, entry lines are added below */
+    total = strlen(FARC_MAGIC) + 8;
+    while ((dent = readdir(dirp)) != NULL) {
+        if (!farc_check_name(dent->d_name) || fnmatch(pattern, dent->d_name, 0))
+            continue;
+        numch = snprintf(fpath, sizeof(fpath), "%s/%s", dpath, dent->d_name);
+        if (numch >= sizeof(fpath) || stat(fpath, &st) == -1 || !S_ISREG(st.st_mode))
+            continue;
+        /* skip files that won't fit, smaller ones later on may still fit */
+        len = strlen(dent->d_name) + 24 + st.st_size;
+        if (n == FARC_MAX_FILES || total + len > size) {
+            ++(*skipped);
+            continue;
+        }
+        snprintf(entries[n].name, sizeof(entries[n].name), "%s", dent->d_name);
+        entries[n].size = st.st_size;
+        total += len;
+        ++n;
+    }
+    closedir(dirp);
+    if (!n)
+        return 0;
+    /* sort by name so the archive doesn't depend on directory order */
+    qsort(entries, n, sizeof(FARC_ENTRY), farc_cmp_entry);
+    total = snprintf(buf, size, "%s %d\n", FARC_MAGIC, n);
+    for (i = 0; i < n; i++)
+        total += snprintf(buf + total, size - total, "%zu %s\n",
+                          entries[i].size, entries[i].name);
+    for (i = 0; i < n; i++) {
+        numch = snprintf(fpath, sizeof(fpath), "%s/%s", dpath, entries[i].name);
+        if (numch >= sizeof(fpath))
+            return 0;
+        fp = fopen(fpath, "r");
+        if (fp == NULL)
+            return 0;
+        len = fread(buf + total, 1, entries[i].size, fp);
+        fclose(fp);
+        if (len != entries[i].size)
+            return 0; /* file changed since listed */
+        total += len;
+    }
+    *count = n;
+    return total;
+}
+
+int farc_unpack(const char *buf, size_t size, const char *dpath, int *count)
+{
+    static FARC_ENTRY entries[FARC_MAX_FILES];
+    FILE *fp;
+    char fpath[MAX_PATH_SIZE*2+FARC_MAX_NAME_SIZE], line[FARC_MAX_NAME_SIZE+32];
+    const char *p, *e, *end;
+    size_t total = 0;
+    int i, j, n, numch;
+
+    *count = 0;
+    end = buf + size;
+    p = buf;
+    /* parse manifest, validate everything before writing any file */
+    e = memchr(p, '\n', end - p);
+    if (!e || (size_t)(e - p) >= sizeof(line))
+        return 0;
+    snprintf(line, sizeof(line), "%.*s", (int)(e - p), p);
+    if (1 != sscanf(line, FARC_MAGIC " %d", &n) || n < 1 || n > FARC_MAX_FILES)
+        return 0;
+    p = e + 1;
+    for (i = 0; i < n; i++) {
+        e = memchr(p, '\n', end - p);
+        if (!e || (size_t)(e - p) >= sizeof(line))
+            return 0;
+        snprintf(line, sizeof(line), "%.*s", (int)(e - p), p);
+        numch = 0;
+        if (1 != sscanf(line, "%zu %n", &entries[i].size, &numch) || !numch)
+            return 0;
+        snprintf(entries[i].name, sizeof(entries[i].name), "%s", line + numch);
+        if (!farc_check_name(entries[i].name) || entries[i].size > size)
+            return 0;
+        total += entries[i].size;
+        p = e + 1;
+    }
+    if (total != (size_t)(end - p))
+        return 0;
+    /* never write to a truncated path or over an existing file, and
+       don't let one entry overwrite another */
+    for (i = 0; i < n; i++) {
+        numch = snprintf(fpath, sizeof(fpath), "%s/%s", dpath, entries[i].name);
+        if (numch >= sizeof(fpath))
+            return 0;
+        if (access(fpath, F_OK) == 0)
+            return FARC_EXISTS;
+        for (j = 0; j < i; j++) {
+            if (!strcmp(entries[i].name, entries[j].name))
+                return 0;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        numch = snprintf(fpath, sizeof(fpath), "%s/%s", dpath, entries[i].name);
+        if (numch >= sizeof(fpath))
+            return 0;
+        /* exclusive create, in case a file appeared since the check */
+        fp = fopen(fpath, "wx");
+        if (fp == NULL)
+            return 0;
+        if (fwrite(p, 1, entries[i].size, fp) != entries[i].size) {
+            fclose(fp);
+            return 0;
+        }
+        if (fclose(fp) != 0)
+            return 0;
+        p += entries[i].size;
+        ++(*count);
+    }
+    return 1;
+}
+
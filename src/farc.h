@@ -0,0 +1,37 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _FARC_H_INCLUDED_
+#define _FARC_H_INCLUDED_
+
+#define FARC_MAGIC          "FARC1"
+#define FARC_MAX_FILES      64
+#define FARC_MAX_NAME_SIZE  256
+#define FARC_EXISTS         -1      /* farc_unpack() result, file already there */
+
+extern size_t farc_pack(const char *dpath, const char *pattern,
+                            char *buf, size_t size, int *count, int *skipped);
+extern int farc_unpack(const char *buf, size_t size, const char *dpath, int *count);
+
+#endif
+
@@ -0,0 +1,368 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "util.h"
+#include "zdict.h"
+#include "fstream.h"
+
+/*  Streaming file transfer engine for ARQ files too large to hold in a
+    FILEQUEUEITEM. A read stream is opened by the sender and read by the
+    data thread one TNC block at a time, deflating the file on demand
+    as the TNC's buffer drains. The /FPUT header needs the size and
+    checksum of the data as sent before the first byte goes out, so
+    fstream_open() makes a first pass over the file to find them, then
+    rewinds. Deflate is fed identical input chunks on both passes so it
+    produces the same bytes, and fstream_skip() relies on the same
+    property to resume a transfer part way through. A write stream is
+    opened by the receiver, appending the data as sent to a .part file,
+    flushed after every block, with a .part.ckpt file recording the size,
+    checksum and compression option promised in /FPUT. If the link drops
+    the .part file is kept, fstream_checkpoint() finds how much of it
+    arrived and the transfer picks up from there. fstream_commit() checks
+    the whole .part file against the promised checksum, then inflates or
+    renames it into place. Memory use is the chunk buffer plus zlib's
+    state, whatever the file size. */
+
+int fstream_is_open(FSTREAM *fs)
+{
+    return fs->fp != NULL;
+}
+
+void fstream_close(FSTREAM *fs)
+{
+    /* a partial download is left in place to be resumed later */
+    if (fs->zinit) {
+        deflateEnd(&fs->zs);
+        fs->zinit = 0;
+    }
+    if (fs->fp) {
+        fclose(fs->fp);
+        fs->fp = NULL;
+    }
+    fs->mode = 0;
+}
+
+void fstream_discard(FSTREAM *fs)
+{
+    char part[MAX_PATH_SIZE*2+16];
+    int mode;
+
+    mode = fs->mode;
+    fstream_close(fs);
+    if (mode == FSTREAM_MODE_WRITE) {
+        snprintf(part, sizeof(part), "%s%s", fs->path, FSTREAM_PART_EXT);
+        unlink(part);
+        snprintf(part, sizeof(part), "%s%s", fs->path, FSTREAM_CKPT_EXT);
+        unlink(part);
+    }
+}
+
+int fstream_rewind(FSTREAM *fs)
+{
+    rewind(fs->fp);
+    fs->cnt = 0;
+    fs->zend = 0;
+    if (fs->zinit) {
+        deflateEnd(&fs->zs);
+        fs->zinit = 0;
+    }
+    if (fs->zoption) {
+        memset(&fs->zs, 0, sizeof(fs->zs));
+        fs->zs.zalloc = Z_NULL;
+        fs->zs.zfree = Z_NULL;
+        fs->zs.opaque = Z_NULL;
+        if (zdict_deflate_init(&fs->zs, fs->zoption) != Z_OK)
+            return 0;
+        fs->zinit = 1;
+    }
+    return 1;
+}
+
+size_t fstream_produce(FSTREAM *fs, unsigned char *data, size_t size)
+{
+    int zret;
+
+    if (!fs->zoption)
+        return fread(data, 1, size, fs->fp);
+    fs->zs.next_out = data;
+    fs->zs.avail_out = size;
+    while (fs->zs.avail_out && !fs->zend) {
+        if (!fs->zs.avail_in && !feof(fs->fp)) {
+            /* always read whole chunks so both passes match */
+            fs->zs.avail_in = fread(fs->buf, 1, sizeof(fs->buf), fs->fp);
+            fs->zs.next_in = fs->buf;
+            if (ferror(fs->fp))
+                break;
+        }
+        zret = deflate(&fs->zs, feof(fs->fp) ? Z_FINISH : Z_NO_FLUSH);
+        if (zret == Z_STREAM_END)
+            fs->zend = 1;
+        else if (zret != Z_OK && zret != Z_BUF_ERROR)
+            break;
+    }
+    return size - fs->zs.avail_out;
+}
+
+int fstream_open(FSTREAM *fs, const char *fpath, int zoption)
+{
+    unsigned char data[FSTREAM_CHUNK_SIZE];
+    size_t len;
+
+    fstream_close(fs);
+    fs->fp = fopen(fpath, "r");
+    if (fs->fp == NULL)
+        return 0;
+    fs->mode = FSTREAM_MODE_READ;
+    fs->zoption = zoption;
+    snprintf(fs->path, sizeof(fs->path), "%s", fpath);
+    if (!fstream_rewind(fs)) {
+        fstream_close(fs);
+        return 0;
+    }
+    /* first pass, find size and checksum of the data as sent */
+    fs->size = 0;
+    fs->crc = CCITT_CRC16_INIT;
+    while ((len = fstream_produce(fs, data, sizeof(data))) > 0) {
+        fs->crc = ccitt_crc16_update(fs->crc, data, len);
+        fs->size += len;
+    }
+    if (ferror(fs->fp) || (zoption && !fs->zend) || !fs->size || !fstream_rewind(fs)) {
+        fstream_close(fs);
+        return 0;
+    }
+    return 1;
+}
+
+size_t fstream_read(FSTREAM *fs, unsigned char *data, size_t size)
+{
+    size_t len;
+
+    len = fs->fp ? fstream_produce(fs, data, size) : 0;
+    if (len < size) {
+        /* file changed or stream closed since fstream_open(), pad to the
+           size promised in /FPUT and let the receiver's checksum reject it */
+        memset(data + len, 0, size - len);
+    }
+    fs->cnt += size;
+    return size;
+}
+
+int fstream_skip(FSTREAM *fs, size_t offset)
+{
+    unsigned char data[FSTREAM_CHUNK_SIZE];
+    size_t len;
+
+    /* regenerate and drop data already held by the receiver */
+    if (fs->fp == NULL || fs->mode != FSTREAM_MODE_READ || offset > fs->size)
+        return 0;
+    if (!fs->zoption) {
+        if (fseek(fs->fp, offset, SEEK_SET) == -1)
+            return 0;
+        fs->cnt = offset;
+        return 1;
+    }
+    while (fs->cnt < offset) {
+        len = offset - fs->cnt;
+        if (len > sizeof(data))
+            len = sizeof(data);
+        if (fstream_produce(fs, data, len) != len)
+            return 0;
+        fs->cnt += len;
+    }
+    return 1;
+}
+
+size_t fstream_checkpoint(const char *fpath, int *zoption, size_t *size, unsigned int *check)
+{
+    FILE *fp;
+    char part[MAX_PATH_SIZE*2+16];
+    struct stat st;
+    int n;
+
+    /* returns number of bytes of a resumable partial download */
+    snprintf(part, sizeof(part), "%s%s", fpath, FSTREAM_CKPT_EXT);
+    fp = fopen(part, "r");
+    if (fp == NULL)
+        return 0;
+    n = fscanf(fp, "FSTREAM1 %zu %x %d", size, check, zoption);
+    fclose(fp);
+    if (n != 3)
+        return 0;
+    snprintf(part, sizeof(part), "%s%s", fpath, FSTREAM_PART_EXT);
+    if (stat(part, &st) == -1 || (size_t)st.st_size >= *size)
+        return 0;
+    return st.st_size;
+}
+
+int fstream_create(FSTREAM *fs, const char *fpath, int zoption,
+                       size_t size, unsigned int check, size_t offset)
+{
+    FILE *fp;
+    char part[MAX_PATH_SIZE*2+16];
+
+    fstream_close(fs);
+    snprintf(fs->path, sizeof(fs->path), "%s", fpath);
+    snprintf(part, sizeof(part), "%s%s", fpath, FSTREAM_PART_EXT);
+    if (offset) {
+        /* resume, drop anything past the offset agreed with the sender */
+        if (truncate(part, offset) == -1)
+            return 0;
+        fs->fp = fopen(part, "a");
+    } else {
+        fs->fp = fopen(part, "w");
+    }
+    if (fs->fp == NULL)
+        return 0;
+    fs->mode = FSTREAM_MODE_WRITE;
+    fs->zoption = zoption;
+    fs->size = size;
+    fs->cnt = offset;
+    if (!offset) {
+        /* record what the sender promised so a later session can resume */
+        snprintf(part, sizeof(part), "%s%s", fpath, FSTREAM_CKPT_EXT);
+        fp = fopen(part, "w");
+        if (fp == NULL) {
+            fstream_discard(fs);
+            return 0;
+        }
+        fprintf(fp, "FSTREAM1 %zu %04X %d\n", size, check, zoption);
+        if (fclose(fp) != 0) {
+            fstream_discard(fs);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int fstream_write(FSTREAM *fs, const unsigned char *data, size_t size)
+{
+    if (fs->fp == NULL || fs->mode != FSTREAM_MODE_WRITE)
+        return 0;
+    if (fwrite(data, 1, size, fs->fp) != size)
+        return 0;
+    /* flush every block so the .part file is a valid checkpoint */
+    if (fflush(fs->fp) != 0)
+        return 0;
+    fs->cnt += size;
+    return 1;
+}
+
+unsigned int fstream_get_check(FSTREAM *fs)
+{
+    return ccitt_crc16_final(fs->crc);
+}
+
+int fstream_inflate(FILE *in, FILE *out)
+{
+    unsigned char inbuf[FSTREAM_CHUNK_SIZE], outbuf[FSTREAM_CHUNK_SIZE];
+    z_stream zs;
+    size_t len;
+    int zret;
+
+    memset(&zs, 0, sizeof(zs));
+    zs.zalloc = Z_NULL;
+    zs.zfree = Z_NULL;
+    zs.opaque = Z_NULL;
+    if (inflateInit(&zs) != Z_OK)
+        return 0;
+    zret = Z_OK;
+    while (zret != Z_STREAM_END) {
+        zs.avail_in = fread(inbuf, 1, sizeof(inbuf), in);
+        zs.next_in = inbuf;
+        if (!zs.avail_in || ferror(in))
+            break;
+        do {
+            zs.next_out = outbuf;
+            zs.avail_out = sizeof(outbuf);
+            zret = zdict_inflate_flush(&zs, Z_NO_FLUSH);
+            if (zret != Z_OK && zret != Z_STREAM_END && zret != Z_BUF_ERROR) {
+                inflateEnd(&zs);
+                return 0;
+            }
+            len = sizeof(outbuf) - zs.avail_out;
+            if (len && fwrite(outbuf, 1, len, out) != len) {
+                inflateEnd(&zs);
+                return 0;
+            }
+        } while (zret == Z_OK && (zs.avail_in || !zs.avail_out));
+    }
+    inflateEnd(&zs);
+    return zret == Z_STREAM_END;
+}
+
+int fstream_commit(FSTREAM *fs, unsigned int check)
+{
+    FILE *fp, *tmp;
+    char part[MAX_PATH_SIZE*2+16], tpath[MAX_PATH_SIZE*2+16];
+    size_t len, total = 0;
+    int ok, err;
+
+    /* returns 1 on success, -1 if the checksum is bad, 0 on other errors */
+    if (fs->fp == NULL || fs->mode != FSTREAM_MODE_WRITE)
+        return 0;
+    ok = (fclose(fs->fp) == 0);
+    fs->fp = NULL;
+    snprintf(part, sizeof(part), "%s%s", fs->path, FSTREAM_PART_EXT);
+    fp = ok ? fopen(part, "r") : NULL;
+    if (fp == NULL) {
+        fstream_discard(fs);
+        return 0;
+    }
+    /* verify the whole file, not just the blocks sent in this session */
+    fs->crc = CCITT_CRC16_INIT;
+    while ((len = fread(fs->buf, 1, sizeof(fs->buf), fp)) > 0) {
+        fs->crc = ccitt_crc16_update(fs->crc, fs->buf, len);
+        total += len;
+    }
+    err = ferror(fp);
+    if (err || total != fs->size || fstream_get_check(fs) != check) {
+        fclose(fp);
+        fstream_discard(fs);
+        return err ? 0 : -1;
+    }
+    if (fs->zoption) {
+        rewind(fp);
+        snprintf(tpath, sizeof(tpath), "%s%s", fs->path, FSTREAM_TEMP_EXT);
+        tmp = fopen(tpath, "w");
+        ok = tmp && fstream_inflate(fp, tmp);
+        if (tmp && fclose(tmp) != 0)
+            ok = 0;
+        if (ok && rename(tpath, fs->path) == -1)
+            ok = 0;
+        if (!ok)
+            unlink(tpath);
+        fclose(fp);
+    } else {
+        fclose(fp);
+        ok = (rename(part, fs->path) != -1);
+    }
+    fstream_discard(fs);
+    return ok;
+}
+
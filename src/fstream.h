@@ -0,0 +1,67 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _FSTREAM_H_INCLUDED_
+#define _FSTREAM_H_INCLUDED_
+
+#include <stdio.h>
+#include "zlib.h"
+
+#define FSTREAM_CHUNK_SIZE      4096
+#define FSTREAM_PART_EXT        ".part"
+#define FSTREAM_CKPT_EXT        ".part.ckpt"
+#define FSTREAM_TEMP_EXT        ".part.tmp"
+
+#define FSTREAM_MODE_READ       1
+#define FSTREAM_MODE_WRITE      2
+
+typedef struct fstream {
+    FILE *fp;
+    int mode;
+    int zoption;
+    int zinit;
+    int zend;
+    z_stream zs;
+    size_t size;            /* bytes on the wire, compressed if zoption set */
+    size_t cnt;             /* bytes on the wire read or written so far */
+    unsigned int crc;       /* checksum of bytes on the wire */
+    char path[MAX_PATH_SIZE*2];
+    unsigned char buf[FSTREAM_CHUNK_SIZE];
+} FSTREAM;
+
+extern int fstream_open(FSTREAM *fs, const char *fpath, int zoption);
+extern size_t fstream_read(FSTREAM *fs, unsigned char *data, size_t size);
+extern int fstream_skip(FSTREAM *fs, size_t offset);
+extern size_t fstream_checkpoint(const char *fpath, int *zoption,
+                                     size_t *size, unsigned int *check);
+extern int fstream_create(FSTREAM *fs, const char *fpath, int zoption,
+                              size_t size, unsigned int check, size_t offset);
+extern int fstream_write(FSTREAM *fs, const unsigned char *data, size_t size);
+extern unsigned int fstream_get_check(FSTREAM *fs);
+extern int fstream_commit(FSTREAM *fs, unsigned int check);
+extern void fstream_close(FSTREAM *fs);
+extern void fstream_discard(FSTREAM *fs);
+extern int fstream_is_open(FSTREAM *fs);
+
+#endif
+
@@ -85,6 +85,7 @@ const char *baud_rates[] = {
 ARIM_SET g_arim_settings;
 LOG_SET g_log_settings;
 UI_SET g_ui_settings;
+int g_ui_utc_time;
 TNC_SET g_tnc_settings[TNC_MAX_COUNT];
 int g_cur_tnc, g_num_tnc;
 char g_arim_path[MAX_DIR_PATH_SIZE];
@@ -492,6 +493,9 @@ void ini_read_tnc_set(FILE *inifp, int which)
     snprintf(g_tnc_settings[which].interface, sizeof(g_tnc_settings[which].interface), DEFAULT_TNC_INTERFACE);
     snprintf(g_tnc_settings[which].serial_port, sizeof(g_tnc_settings[which].serial_port), DEFAULT_TNC_SERIAL_PORT);
     snprintf(g_tnc_settings[which].serial_baudrate, sizeof(g_tnc_settings[which].serial_baudrate), DEFAULT_TNC_SERIAL_BAUD);
+    snprintf(g_tnc_settings[which].tcp_reactor, sizeof(g_tnc_settings[which].tcp_reactor), DEFAULT_TNC_TCP_REACTOR);
+    snprintf(g_tnc_settings[which].tx_high_water, sizeof(g_tnc_settings[which].tx_high_water), DEFAULT_TNC_TX_HIGH_WATER);
+    snprintf(g_tnc_settings[which].tx_low_water, sizeof(g_tnc_settings[which].tx_low_water), DEFAULT_TNC_TX_LOW_WATER);
     snprintf(g_tnc_settings[which].debug_en, sizeof(g_tnc_settings[which].debug_en), DEFAULT_TNC_DEBUG_EN);
     snprintf(g_tnc_settings[which].traffic_en, sizeof(g_tnc_settings[which].traffic_en),  DEFAULT_TNC_TRAFFIC_EN);
     snprintf(g_tnc_settings[which].tncpi9k6_en, sizeof(g_tnc_settings[which].tncpi9k6_en),  DEFAULT_TNC_TNCPI9K6_EN);
@@ -702,6 +706,31 @@ void ini_read_tnc_set(FILE *inifp, int which)
                 if (g_print_config)
                     fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "serial-baudrate", g_tnc_settings[which].serial_baudrate);
             }
+            else if ((v = ini_get_value("tcp-reactor", p))) {
+                if (ini_validate_bool(v))
+                    snprintf(g_tnc_settings[which].tcp_reactor, sizeof(g_tnc_settings[which].tcp_reactor), "TRUE");
+                else
+                    snprintf(g_tnc_settings[which].tcp_reactor, sizeof(g_tnc_settings[which].tcp_reactor), "FALSE");
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "tcp-reactor", g_tnc_settings[which].tcp_reactor);
+            }
+            else if ((v = ini_get_value("tx-high-water", p))) {
+                test = atoi(v);
+                if (test >= MIN_TNC_TX_WATER_VALUE && test <= MAX_TNC_TX_WATER_VALUE)
+                    snprintf(g_tnc_settings[which].tx_high_water, sizeof(g_tnc_settings[which].tx_high_water), "%d", test);
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "tx-high-water", g_tnc_settings[which].tx_high_water);
+            }
+            else if ((v = ini_get_value("tx-low-water", p))) {
+                test = atoi(v);
+                if (test >= MIN_TNC_TX_WATER_VALUE && test <= MAX_TNC_TX_WATER_VALUE)
+                    snprintf(g_tnc_settings[which].tx_low_water, sizeof(g_tnc_settings[which].tx_low_water), "%d", test);
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "tx-low-water", g_tnc_settings[which].tx_low_water);
+            }
             else if ((v = ini_get_value("serial-port", p))) {
                 snprintf(g_tnc_settings[which].serial_port, sizeof(g_tnc_settings[which].serial_port), "%s", v);
                 /* if program invoked with --print-conf switch, print key/value pair */
@@ -807,6 +836,7 @@ void ini_read_log_set(FILE *inifp)
 {
     char linebuf[MAX_INI_LINE_SIZE];
     char *p, *v;
+    int test;
 
     /* if program invoked with --print-conf switch, print section header */
     if (g_print_config)
@@ -844,6 +874,27 @@ void ini_read_log_set(FILE *inifp)
                 /* if program invoked with --print-conf switch, print key/value pair */
                 if (g_print_config)
                     fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "tncpi9k6-log", g_log_settings.tncpi9k6_en);
+            } else if ((v = ini_get_value("max-log-size", p))) {
+                test = atoi(v);
+                if (test >= MIN_LOG_MAX_SIZE_VALUE && test <= MAX_LOG_MAX_SIZE_VALUE)
+                    snprintf(g_log_settings.max_size, sizeof(g_log_settings.max_size), "%d", test);
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "max-log-size", g_log_settings.max_size);
+            } else if ((v = ini_get_value("log-keep-days", p))) {
+                test = atoi(v);
+                if (test >= MIN_LOG_KEEP_DAYS_VALUE && test <= MAX_LOG_KEEP_DAYS_VALUE)
+                    snprintf(g_log_settings.keep_days, sizeof(g_log_settings.keep_days), "%d", test);
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "log-keep-days", g_log_settings.keep_days);
+            } else if ((v = ini_get_value("log-keep-size", p))) {
+                test = atoi(v);
+                if (test >= MIN_LOG_KEEP_SIZE_VALUE && test <= MAX_LOG_KEEP_SIZE_VALUE)
+                    snprintf(g_log_settings.keep_size, sizeof(g_log_settings.keep_size), "%d", test);
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "log-keep-size", g_log_settings.keep_size);
             }
         }
         p = fgets(linebuf, sizeof(linebuf), inifp);
@@ -860,6 +911,9 @@ int ini_get_log_set(const char *fn)
     snprintf(g_log_settings.debug_en, sizeof(g_log_settings.debug_en), DEFAULT_LOG_DEBUG_EN);
     snprintf(g_log_settings.traffic_en, sizeof(g_log_settings.traffic_en),  DEFAULT_LOG_TRAFFIC_EN);
     snprintf(g_log_settings.tncpi9k6_en, sizeof(g_log_settings.tncpi9k6_en),  DEFAULT_LOG_TNCPI9K6_EN);
+    snprintf(g_log_settings.max_size, sizeof(g_log_settings.max_size), DEFAULT_LOG_MAX_SIZE);
+    snprintf(g_log_settings.keep_days, sizeof(g_log_settings.keep_days), DEFAULT_LOG_KEEP_DAYS);
+    snprintf(g_log_settings.keep_size, sizeof(g_log_settings.keep_size), DEFAULT_LOG_KEEP_SIZE);
 
     inifp = fopen(fn, "r");
     if (inifp == NULL)
@@ -1117,6 +1171,14 @@ void ini_read_arim_set(FILE *inifp)
                 if (g_print_config)
                     fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "max-file-size", g_arim_settings.max_file_size);
             }
+            else if ((v = ini_get_value("max-arq-file-size", p))) {
+                test = atoi(v);
+                if (test >= 0 && test <= MAX_ARIM_ARQ_FILE_SIZE)
+                    snprintf(g_arim_settings.max_arq_file_size, sizeof(g_arim_settings.max_arq_file_size), "%d", test);
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "max-arq-file-size", g_arim_settings.max_arq_file_size);
+            }
             else if ((v = ini_get_value("msg-trace-en", p))) {
                 if (ini_validate_bool(v))
                     snprintf(g_arim_settings.msg_trace_en, sizeof(g_arim_settings.msg_trace_en), "TRUE");
@@ -1126,6 +1188,23 @@ void ini_read_arim_set(FILE *inifp)
                 if (g_print_config)
                     fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "msg-trace-en", g_arim_settings.msg_trace_en);
             }
+            else if ((v = ini_get_value("zcache-size", p))) {
+                test = atoi(v);
+                if (test >= 0 && test <= MAX_ARIM_ZCACHE_SIZE)
+                    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), "%d", test);
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "zcache-size", g_arim_settings.zcache_size);
+            }
+            else if ((v = ini_get_value("zcache-persist", p))) {
+                if (ini_validate_bool(v))
+                    snprintf(g_arim_settings.zcache_persist, sizeof(g_arim_settings.zcache_persist), "TRUE");
+                else
+                    snprintf(g_arim_settings.zcache_persist, sizeof(g_arim_settings.zcache_persist), "FALSE");
+                /* if program invoked with --print-conf switch, print key/value pair */
+                if (g_print_config)
+                    fprintf(printconf_fp ? printconf_fp : stdout, "%s=%s\n", "zcache-persist", g_arim_settings.zcache_persist);
+            }
             else if ((v = ini_get_value("dynamic-file", p))) {
                 if (g_arim_settings.dyn_files_cnt < ARIM_DYN_FILES_MAX_CNT)
                     snprintf(g_arim_settings.dyn_files[g_arim_settings.dyn_files_cnt],
@@ -1180,9 +1259,12 @@ int ini_get_arim_set(const char *fn)
     snprintf(g_arim_settings.frame_timeout, sizeof(g_arim_settings.frame_timeout), DEFAULT_ARIM_FRAME_TIMEOUT);
     numch = snprintf(g_arim_settings.files_dir, sizeof(g_arim_settings.files_dir), "%s/%s", g_arim_path, DEFAULT_ARIM_FILES_DIR);
     snprintf(g_arim_settings.max_file_size, sizeof(g_arim_settings.max_file_size), DEFAULT_ARIM_FILES_MAX_SIZE);
+    snprintf(g_arim_settings.max_arq_file_size, sizeof(g_arim_settings.max_arq_file_size), DEFAULT_ARIM_ARQ_FILES_MAX_SIZE);
     snprintf(g_arim_settings.max_msg_days, sizeof(g_arim_settings.max_msg_days), DEFAULT_ARIM_MSG_MAX_DAYS);
     snprintf(g_arim_settings.fecmode_downshift, sizeof(g_arim_settings.fecmode_downshift), DEFAULT_ARIM_FECMODE_DOWN);
     snprintf(g_arim_settings.msg_trace_en, sizeof(g_arim_settings.msg_trace_en), DEFAULT_ARIM_MSG_TRACE_EN);
+    snprintf(g_arim_settings.zcache_size, sizeof(g_arim_settings.zcache_size), DEFAULT_ARIM_ZCACHE_SIZE);
+    snprintf(g_arim_settings.zcache_persist, sizeof(g_arim_settings.zcache_persist), DEFAULT_ARIM_ZCACHE_PERSIST);
 
     inifp = fopen(fn, "r");
     if (inifp == NULL)
@@ -1290,6 +1372,7 @@ int ini_get_ui_set(const char *fn)
     snprintf(g_ui_settings.color_code, sizeof(g_ui_settings.color_code), DEFAULT_UI_COLOR_CODE);
     snprintf(g_ui_settings.utc_time, sizeof(g_ui_settings.utc_time), DEFAULT_UI_UTC_TIME);
     snprintf(g_ui_settings.theme, sizeof(g_ui_settings.theme), DEFAULT_UI_THEME);
+    g_ui_utc_time = !strncasecmp(g_ui_settings.utc_time, "TRUE", 4);
 
     inifp = fopen(fn, "r");
     if (inifp == NULL)
@@ -1301,6 +1384,8 @@ int ini_get_ui_set(const char *fn)
                 p++;
             if (p == strstr(p, "[ui]")) {
                 ini_read_ui_set(inifp);
+                /* resolve time zone choice once for the timestamp functions */
+                g_ui_utc_time = !strncasecmp(g_ui_settings.utc_time, "TRUE", 4);
                 break;
             }
         }
@@ -58,10 +58,12 @@
 #define TNC_INIT_CMD_SIZE        128
 #define TNC_INTERFACE_SIZE       12
 #define TNC_SERIAL_PORT_SIZE     64
+#define TNC_TX_WATER_SIZE        8
 #define TNC_SERIAL_BAUD_SIZE     16
 #define TNC_DEBUG_EN_SIZE        8
 #define TNC_TRAFFIC_EN_SIZE      8
 #define TNC_TNCPI9K6_EN_SIZE     8
+#define TNC_TCP_REACTOR_SIZE     8
 
 #define TNC_MAX_COUNT            10
 #define TNC_NETCALL_MAX_CNT      8
@@ -94,6 +96,9 @@
 #define DEFAULT_TNC_DEBUG_EN     "FALSE"
 #define DEFAULT_TNC_TRAFFIC_EN   "FALSE"
 #define DEFAULT_TNC_TNCPI9K6_EN  "FALSE"
+#define DEFAULT_TNC_TCP_REACTOR  "FALSE"
+#define DEFAULT_TNC_TX_HIGH_WATER "4096"
+#define DEFAULT_TNC_TX_LOW_WATER "2048"
 
 #define MAX_TNC_GRIDSQ_STRLEN    8
 #define MAX_TNC_NETCALL_STRLEN   10
@@ -109,6 +114,8 @@
 #define MAX_TNC_BUSYDET_VALUE    10
 #define MIN_TNC_ARQ_TO           30
 #define MAX_TNC_ARQ_TO           600
+#define MIN_TNC_TX_WATER_VALUE   256
+#define MAX_TNC_TX_WATER_VALUE   32768
 
 typedef struct tnc_set {
     char ipaddr[TNC_IPADDR_SIZE];
@@ -146,6 +153,9 @@ typedef struct tnc_set {
     char interface[TNC_INTERFACE_SIZE];
     char serial_port[TNC_SERIAL_PORT_SIZE];
     char serial_baudrate[TNC_SERIAL_BAUD_SIZE];
+    char tcp_reactor[TNC_TCP_REACTOR_SIZE];
+    char tx_high_water[TNC_TX_WATER_SIZE];
+    char tx_low_water[TNC_TX_WATER_SIZE];
     char log_dir[MAX_DIR_PATH_SIZE];
     char debug_en[TNC_DEBUG_EN_SIZE];
     char traffic_en[TNC_TRAFFIC_EN_SIZE];
@@ -165,6 +175,7 @@ extern int g_num_tnc;
 #define ARIM_ACK_TIMEOUT_SIZE        4
 #define ARIM_FRAME_TIMEOUT_SIZE      4
 #define ARIM_FILES_MAX_SIZE          12
+#define ARIM_ARQ_FILES_MAX_SIZE      12
 #define ARIM_DYN_FILES_MAX_CNT       16
 #define ARIM_DYN_FILES_SIZE          128
 #define ARIM_ADD_FILES_DIR_MAX_CNT   16
@@ -172,6 +183,8 @@ extern int g_num_tnc;
 #define ARIM_FECMODE_DOWN_SIZE       8
 #define ARIM_MAX_MSG_DAYS_SIZE       8
 #define ARIM_MSG_TRACE_EN_SIZE       8
+#define ARIM_ZCACHE_SIZE_SIZE        8
+#define ARIM_ZCACHE_PERSIST_SIZE     8
 #define ARIM_AC_LIST_MAX_CNT         512
 #define DEFAULT_ARIM_MYCALL          "NOCALL"
 #define DEFAULT_ARIM_SEND_REPEATS    "0"
@@ -181,9 +194,12 @@ extern int g_num_tnc;
 #define DEFAULT_ARIM_FRAME_TIMEOUT   "30"
 #define DEFAULT_ARIM_FILES_DIR       "files/"
 #define DEFAULT_ARIM_FILES_MAX_SIZE  "4096"
+#define DEFAULT_ARIM_ARQ_FILES_MAX_SIZE "0"
 #define DEFAULT_ARIM_FECMODE_DOWN    "FALSE"
 #define DEFAULT_ARIM_MSG_MAX_DAYS    "0"
 #define DEFAULT_ARIM_MSG_TRACE_EN    "FALSE"
+#define DEFAULT_ARIM_ZCACHE_SIZE     "256"
+#define DEFAULT_ARIM_ZCACHE_PERSIST  "FALSE"
 
 #define MAX_ARIM_SEND_REPEATS        5
 #define MIN_ARIM_PILOT_PING          2
@@ -196,6 +212,8 @@ extern int g_num_tnc;
 #define MAX_ARIM_FRAME_TIMEOUT       999
 #define MIN_ARIM_MSG_DAYS            0
 #define MAX_ARIM_MSG_DAYS            9999
+#define MAX_ARIM_ZCACHE_SIZE         16384
+#define MAX_ARIM_ARQ_FILE_SIZE       16777216
 
 typedef struct arim_set {
     char mycall[ARIM_MYCALL_SIZE];
@@ -207,8 +225,11 @@ typedef struct arim_set {
     char frame_timeout[ARIM_FRAME_TIMEOUT_SIZE];
     char files_dir[MAX_DIR_PATH_SIZE];
     char max_file_size[ARIM_FILES_MAX_SIZE];
+    char max_arq_file_size[ARIM_ARQ_FILES_MAX_SIZE];
     char max_msg_days[ARIM_MAX_MSG_DAYS_SIZE];
     char msg_trace_en[ARIM_MSG_TRACE_EN_SIZE];
+    char zcache_size[ARIM_ZCACHE_SIZE_SIZE];
+    char zcache_persist[ARIM_ZCACHE_PERSIST_SIZE];
     char dyn_files[ARIM_DYN_FILES_MAX_CNT][ARIM_DYN_FILES_SIZE];
     int dyn_files_cnt;
     char add_files_dir[ARIM_ADD_FILES_DIR_MAX_CNT][MAX_DIR_PATH_SIZE];
@@ -226,15 +247,31 @@ extern ARIM_SET g_arim_settings;
 #define LOG_DEBUG_EN_SIZE           8
 #define LOG_TRAFFIC_EN_SIZE         8
 #define LOG_TNCPI9K6_EN_SIZE        8
+#define LOG_MAX_SIZE_SIZE           12
+#define LOG_KEEP_DAYS_SIZE          8
+#define LOG_KEEP_SIZE_SIZE          12
 
 #define DEFAULT_LOG_DEBUG_EN        "FALSE"
 #define DEFAULT_LOG_TRAFFIC_EN      "TRUE"
 #define DEFAULT_LOG_TNCPI9K6_EN     "FALSE"
+#define DEFAULT_LOG_MAX_SIZE        "1024"
+#define DEFAULT_LOG_KEEP_DAYS       "30"
+#define DEFAULT_LOG_KEEP_SIZE       "0"
+
+#define MIN_LOG_MAX_SIZE_VALUE      16
+#define MAX_LOG_MAX_SIZE_VALUE      65536
+#define MIN_LOG_KEEP_DAYS_VALUE     0
+#define MAX_LOG_KEEP_DAYS_VALUE     3650
+#define MIN_LOG_KEEP_SIZE_VALUE     0
+#define MAX_LOG_KEEP_SIZE_VALUE     4194304
 
 typedef struct log_set {
     char debug_en[LOG_DEBUG_EN_SIZE];
     char traffic_en[LOG_TRAFFIC_EN_SIZE];
     char tncpi9k6_en[LOG_TRAFFIC_EN_SIZE];
+    char max_size[LOG_MAX_SIZE_SIZE];
+    char keep_days[LOG_KEEP_DAYS_SIZE];
+    char keep_size[LOG_KEEP_SIZE_SIZE];
 } LOG_SET;
 
 extern LOG_SET g_log_settings;
@@ -263,6 +300,7 @@ typedef struct ui_set {
 } UI_SET;
 
 extern UI_SET g_ui_settings;
+extern int g_ui_utc_time;
 
 extern int ini_read_settings(void);
 extern int ini_validate_mycall(const char *call);
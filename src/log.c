@@ -29,99 +29,149 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include "main.h"
 #include "bufq.h"
 #include "ini.h"
 #include "util.h"
+#include "log_arch.h"
 
 #define MAX_LOG_FN_SIZE         256
-#define LOG_WRITE_INTERVAL_SEC  30
+#define LOG_BATCH_SIZE          32768
+#define LOG_FLUSH_SIZE          8192
+#define LOG_FLUSH_SEC           2
+#define LOG_POLL_MSEC           250
 
 char g_df_error_fn[MAX_LOG_FN_SIZE];
 
-static int time_interval = 0;
-static int time_elapsed = 0;
 static char traffic_fn[MAX_LOG_FN_SIZE];
 static char debug_fn[MAX_LOG_FN_SIZE];
 static char tncpi9k6_fn[MAX_LOG_FN_SIZE];
 static int prev_yday;
+static char log_datestamp[MAX_TIMESTAMP_SIZE];
+static off_t log_max_size;
 
 int g_debug_log_enable;
 int g_tncpi9k6_log_enable;
 int g_traffic_log_enable;
 char g_log_dir_path[MAX_DIR_PATH_SIZE];
 
-void log_write_debug_log()
+/*  Log files are written by the log writer thread, which keeps them open
+    until they're rotated. Records are popped from each log queue straight
+    into a batch buffer, which is written out in a single write() when it
+    reaches LOG_FLUSH_SIZE bytes or LOG_FLUSH_SEC secs after the last write.
+    A file about to grow past the max-log-size setting is renamed with the
+    next free sequence number and handed to the archiver for compression. */
+typedef struct log_file {
+    int *enable;
+    RINGQ *ring;
+    char *fn;
+    int strip_eol;
+    int fd;
+    char open_fn[MAX_LOG_FN_SIZE];
+    char batch[LOG_BATCH_SIZE];
+    size_t cnt;
+    time_t last_write;
+    off_t size;
+} LOGFILE;
+
+static LOGFILE log_files[] = {
+    { &g_traffic_log_enable,  &g_traffic_log_q.ring,  traffic_fn,  1, -1 },
+    { &g_debug_log_enable,    &g_debug_log_q.ring,    debug_fn,    0, -1 },
+    { &g_tncpi9k6_log_enable, &g_tncpi9k6_log_q.ring, tncpi9k6_fn, 0, -1 },
+};
+
+#define LOG_NUM_FILES   (sizeof(log_files) / sizeof(log_files[0]))
+
+void log_open_file(LOGFILE *lf)
 {
-    FILE *debug_fp;
-    char *p;
+    struct stat st;
 
-    debug_fp = fopen(debug_fn, "a");
-    if (debug_fp != NULL) {
-        pthread_mutex_lock(&mutex_debug_log);
-        p = cmdq_pop(&g_debug_log_q);
-        while (p) {
-            fprintf(debug_fp, "%s\n",  p);
-            p = cmdq_pop(&g_debug_log_q);
-        }
-        pthread_mutex_unlock(&mutex_debug_log);
-        fclose(debug_fp);
-    }
+    if (lf->fd != -1)
+        close(lf->fd);
+    lf->fd = open(lf->fn, O_WRONLY|O_APPEND|O_CREAT, 0666);
+    snprintf(lf->open_fn, sizeof(lf->open_fn), "%s", lf->fn);
+    lf->size = (lf->fd != -1 && !fstat(lf->fd, &st)) ? st.st_size : 0;
 }
 
-void log_write_tncpi9k6_log()
+void log_rotate_file(LOGFILE *lf)
 {
-    FILE *tncpi9k6_fp;
-    char *p;
+    char fn[MAX_LOG_FN_SIZE], gz_fn[MAX_LOG_FN_SIZE+3];
+    size_t len;
+    int n, numch;
 
-    tncpi9k6_fp = fopen(tncpi9k6_fn, "a");
-    if (tncpi9k6_fp != NULL) {
-        pthread_mutex_lock(&mutex_tncpi9k6_log);
-        p = cmdq_pop(&g_tncpi9k6_log_q);
-        while (p) {
-            fprintf(tncpi9k6_fp, "%s\n",  p);
-            p = cmdq_pop(&g_tncpi9k6_log_q);
-        }
-        pthread_mutex_unlock(&mutex_tncpi9k6_log);
-        fclose(tncpi9k6_fp);
+    /* find next free sequence number, e.g. traffic-20210315.3.log */
+    len = strlen(lf->fn);
+    if (len < 4 || strcmp(lf->fn + len - 4, ".log"))
+        return;
+    for (n = 1; n < 10000; n++) {
+        numch = snprintf(fn, sizeof(fn), "%.*s.%d.log", (int)(len - 4), lf->fn, n);
+        if (numch >= sizeof(fn))
+            return; /* name too long, keep writing to current file */
+        snprintf(gz_fn, sizeof(gz_fn), "%s.gz", fn);
+        if (access(fn, F_OK) && access(gz_fn, F_OK))
+            break;
     }
+    close(lf->fd);
+    lf->fd = -1;
+    if (rename(lf->fn, fn) == 0)
+        log_arch_request(log_datestamp);
+    log_open_file(lf);
 }
 
-void log_write_traffic_log()
+void log_flush(LOGFILE *lf)
 {
-    FILE *traffic_fp;
-    char *p;
-    size_t len;
+    ssize_t result;
+    size_t off = 0;
 
-    traffic_fp = fopen(traffic_fn, "a");
-    if (traffic_fp != NULL) {
-        pthread_mutex_lock(&mutex_traffic_log);
-        p = dataq_pop(&g_traffic_log_q);
-        while (p) {
-            len = strlen(p);
-            if (p[len - 1] == '\n')
-                p[len - 1] = '\0';
-            if (p[len - 2] == '\r')
-                p[len - 2] = '\0';
-            fprintf(traffic_fp, "%s\n", p);
-            p = dataq_pop(&g_traffic_log_q);
+    if (!lf->cnt)
+        return;
+    /* (re)open file if not yet open or name has changed on rotation */
+    if (lf->fd == -1 || strcmp(lf->open_fn, lf->fn))
+        log_open_file(lf);
+    if (lf->fd != -1 && log_max_size && lf->size && lf->size + (off_t)lf->cnt > log_max_size)
+        log_rotate_file(lf);
+    while (lf->fd != -1 && off < lf->cnt) {
+        result = write(lf->fd, lf->batch + off, lf->cnt - off);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
         }
-        pthread_mutex_unlock(&mutex_traffic_log);
-        fclose(traffic_fp);
+        off += result;
     }
+    lf->size += off;
+    lf->cnt = 0;
+    lf->last_write = time(NULL);
 }
 
-void log_close()
+void log_drain(LOGFILE *lf)
 {
-    if (g_traffic_log_enable)
-        log_write_traffic_log();
-    if (g_debug_log_enable)
-        log_write_debug_log();
-    if (g_tncpi9k6_log_enable)
-        log_write_tncpi9k6_log();
+    char *p;
+    int len;
+
+    while ((len = ringq_peek(lf->ring)) > 0) {
+        if (lf->cnt + len > sizeof(lf->batch))
+            log_flush(lf);
+        p = lf->batch + lf->cnt;
+        len = ringq_pop(lf->ring, p, sizeof(lf->batch) - lf->cnt);
+        if (len <= 0)
+            break;
+        /* replace record's terminating nul with a newline */
+        --len;
+        if (lf->strip_eol && len && p[len - 1] == '\n')
+            --len;
+        if (lf->strip_eol && len && p[len - 1] == '\r')
+            --len;
+        p[len++] = '\n';
+        lf->cnt += len;
+    }
+    if (lf->cnt >= LOG_FLUSH_SIZE ||
+        (lf->cnt && time(NULL) - lf->last_write >= LOG_FLUSH_SEC))
+        log_flush(lf);
 }
 
-void log_on_alarm()
+void log_check_rotate()
 {
     time_t t;
     struct tm *utc;
@@ -132,7 +182,7 @@ void log_on_alarm()
     utc = gmtime(&t);
     if (utc->tm_yday > prev_yday || (!utc->tm_yday && prev_yday)) {
         prev_yday = utc->tm_yday;
-        /* new day, rotate logs */
+        /* new day, rotate logs; files are reopened on next write */
         numch = snprintf(traffic_fn, sizeof(traffic_fn), "%s/traffic-%s.log",
                          g_log_dir_path, util_datestamp(datestamp, sizeof(datestamp)));
         numch = snprintf(debug_fn, sizeof(debug_fn), "%s/debug-%s.log",
@@ -143,31 +193,68 @@ void log_on_alarm()
         numch =snprintf(g_df_error_fn, sizeof(g_df_error_fn), "%s/dyn-file-error-%s.log",
                         g_log_dir_path, util_datestamp(datestamp, sizeof(datestamp)));
         pthread_mutex_unlock(&mutex_df_error_log);
-    }
-    /* called every 6 secs (1/10 minute granularity) */
-    if (time_elapsed && --time_elapsed == 0) {
-        /* reset timer */
-        time_elapsed = time_interval;
-        if (g_traffic_log_enable)
-            log_write_traffic_log();
-        if (g_debug_log_enable)
-            log_write_debug_log();
-        if (g_tncpi9k6_log_enable)
-            log_write_tncpi9k6_log();
+        /* previous day's logs are done, compress them */
+        util_datestamp(log_datestamp, sizeof(log_datestamp));
+        log_arch_request(log_datestamp);
     }
     (void)numch; /* suppress 'assigned but not used' warning for dummy var */
 }
 
-int log_init(int which_tnc)
+void *log_thread_func(void *data)
+{
+    struct timespec ts;
+    size_t i;
+    int stop;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = LOG_POLL_MSEC * 1000000L;
+    do {
+        /* sample flag first so queues are drained once more after stop */
+        stop = g_logthread_stop;
+        log_check_rotate();
+        for (i = 0; i < LOG_NUM_FILES; i++) {
+            if (*log_files[i].enable)
+                log_drain(&log_files[i]);
+        }
+        if (!stop)
+            nanosleep(&ts, NULL);
+    } while (!stop);
+    for (i = 0; i < LOG_NUM_FILES; i++) {
+        log_flush(&log_files[i]);
+        if (log_files[i].fd != -1)
+            close(log_files[i].fd);
+        log_files[i].fd = -1;
+    }
+    return data;
+}
+
+void log_close()
+{
+    if (g_logthread) {
+        g_logthread_stop = 1;
+        pthread_join(g_logthread, NULL);
+        g_logthread = 0;
+    }
+    log_arch_stop();
+}
+
+void log_start()
+{
+    g_logthread_stop = 0;
+    if (!g_logthread && pthread_create(&g_logthread, NULL, log_thread_func, NULL))
+        g_logthread = 0;
+    log_arch_start();
+}
+
+int log_open(int which_tnc)
 {
     FILE *fp;
     DIR *dirp;
     char datestamp[MAX_TIMESTAMP_SIZE], timestamp[MAX_TIMESTAMP_SIZE];
     int numch;
 
-    time_interval = (LOG_WRITE_INTERVAL_SEC / ALARM_INTERVAL_SEC);
-    time_elapsed = time_interval;
-
+    util_datestamp(log_datestamp, sizeof(log_datestamp));
+    log_max_size = (off_t)atoi(g_log_settings.max_size) * 1024;
     /* set up log directory, tnc settings override global settings if enabled */
     if (!strncasecmp(g_tnc_settings[which_tnc].traffic_en, "TRUE", 4) ||
         !strncasecmp(g_tnc_settings[which_tnc].debug_en, "TRUE", 4)   ||
@@ -249,3 +336,13 @@ int log_init(int which_tnc)
     return 1;
 }
 
+int log_init(int which_tnc)
+{
+    int result;
+
+    result = log_open(which_tnc);
+    /* start log writer for any logs successfully opened */
+    log_start();
+    return result;
+}
+
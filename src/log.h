@@ -26,7 +26,7 @@
 
 extern int log_init(int which_tnc);
 extern void log_close(void);
-extern void log_on_alarm(void);
+extern void *log_thread_func(void *data);
 
 extern int g_debug_log_enable;
 extern int g_tncpi9k6_log_enable;
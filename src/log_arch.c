@@ -0,0 +1,276 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "main.h"
+#include "ini.h"
+#include "log.h"
+#include "log_arch.h"
+#include "zlib.h"
+
+#define LOG_ARCH_POLL_MSEC      1000
+#define LOG_ARCH_CHUNK_SIZE     16384
+#define LOG_ARCH_MAX_FILES      1024
+#define LOG_ARCH_DATE_SIZE      9
+
+/*  The log archiver compresses rotated logs and enforces the retention
+    limits. It runs in its own thread so that gzip work never holds up the
+    log writer or the threads that queue log records. The log writer calls
+    log_arch_request() after a rotation with the datestamp of the logs now
+    being written; logs with a different date, or with a sequence number
+    from a size rotation, are no longer written and are safe to compress. */
+
+typedef struct log_arch_file {
+    char name[MAX_PATH_SIZE];
+    off_t size;
+    time_t mtime;
+} ARCHFILE;
+
+static const char *log_arch_prefixes[] = {
+    "traffic-", "debug-", "tncpi9k6-", "dyn-file-error-",
+};
+
+static char arch_datestamp[LOG_ARCH_DATE_SIZE];
+static int arch_pending;
+
+void log_arch_request(const char *datestamp)
+{
+    pthread_mutex_lock(&mutex_log_arch);
+    snprintf(arch_datestamp, sizeof(arch_datestamp), "%s", datestamp);
+    arch_pending = 1;
+    pthread_mutex_unlock(&mutex_log_arch);
+}
+
+size_t log_arch_match(const char *name, char *date, int *rotated, int *compressed)
+{
+    size_t i, len;
+    const char *p;
+
+    /* accept names like traffic-20210315.log, traffic-20210315.2.log.gz */
+    for (i = 0; i < sizeof(log_arch_prefixes) / sizeof(log_arch_prefixes[0]); i++) {
+        len = strlen(log_arch_prefixes[i]);
+        if (!strncmp(name, log_arch_prefixes[i], len))
+            break;
+    }
+    if (i == sizeof(log_arch_prefixes) / sizeof(log_arch_prefixes[0]))
+        return 0;
+    p = name + len;
+    for (i = 0; i < LOG_ARCH_DATE_SIZE - 1; i++) {
+        if (!isdigit((unsigned char)p[i]))
+            return 0;
+        date[i] = p[i];
+    }
+    date[i] = '\0';
+    p += i;
+    *rotated = 0;
+    if (*p == '.' && isdigit((unsigned char)p[1])) {
+        *rotated = 1;
+        ++p;
+        while (isdigit((unsigned char)*p))
+            ++p;
+    }
+    if (!strcmp(p, ".log"))
+        *compressed = 0;
+    else if (!strcmp(p, ".log.gz"))
+        *compressed = 1;
+    else
+        return 0;
+    return 1;
+}
+
+int log_arch_compress(const char *path)
+{
+    char buf[LOG_ARCH_CHUNK_SIZE], tmp_path[MAX_PATH_SIZE], gz_path[MAX_PATH_SIZE];
+    struct stat st;
+    struct utimbuf times;
+    gzFile gz;
+    ssize_t len;
+    int fd, ok = 1;
+
+    snprintf(gz_path, sizeof(gz_path), "%s.gz", path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.gz.tmp", path);
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return 0;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return 0;
+    }
+    gz = gzopen(tmp_path, "wb");
+    if (!gz) {
+        close(fd);
+        return 0;
+    }
+    while (ok && (len = read(fd, buf, sizeof(buf))) != 0) {
+        if (len < 0) {
+            if (errno != EINTR)
+                ok = 0;
+            continue;
+        }
+        if (g_logarchthread_stop || gzwrite(gz, buf, (unsigned)len) != len)
+            ok = 0;
+    }
+    close(fd);
+    if (gzclose(gz) != Z_OK)
+        ok = 0;
+    /* only replace the original once the compressed copy is complete */
+    if (!ok || rename(tmp_path, gz_path) == -1) {
+        unlink(tmp_path);
+        return 0;
+    }
+    /* keep the log's own age for the retention limits */
+    times.actime = st.st_atime;
+    times.modtime = st.st_mtime;
+    utime(gz_path, &times);
+    unlink(path);
+    return 1;
+}
+
+int log_arch_cmp_mtime(const void *a, const void *b)
+{
+    const ARCHFILE *fa = a, *fb = b;
+
+    if (fa->mtime < fb->mtime)
+        return -1;
+    return fa->mtime > fb->mtime ? 1 : 0;
+}
+
+void log_arch_run(const char *datestamp)
+{
+    DIR *dirp;
+    struct dirent *dent;
+    struct stat st;
+    ARCHFILE *files;
+    char dir[MAX_DIR_PATH_SIZE], path[MAX_PATH_SIZE], date[LOG_ARCH_DATE_SIZE];
+    long long total = 0, keep_size;
+    int i, num_files = 0, rotated, compressed, keep_days;
+    time_t now;
+
+    snprintf(dir, sizeof(dir), "%s", g_log_dir_path);
+    keep_days = atoi(g_log_settings.keep_days);
+    keep_size = atoll(g_log_settings.keep_size) * 1024;
+    files = malloc(LOG_ARCH_MAX_FILES * sizeof(ARCHFILE));
+    if (!files)
+        return;
+    /* first pass compresses logs no longer being written */
+    dirp = opendir(dir);
+    if (!dirp) {
+        free(files);
+        return;
+    }
+    while (!g_logarchthread_stop && (dent = readdir(dirp))) {
+        if (!log_arch_match(dent->d_name, date, &rotated, &compressed) || compressed)
+            continue;
+        if (!rotated && !strcmp(date, datestamp))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, dent->d_name);
+        log_arch_compress(path);
+    }
+    closedir(dirp);
+    /* second pass collects the compressed logs */
+    dirp = opendir(dir);
+    if (!dirp) {
+        free(files);
+        return;
+    }
+    while (!g_logarchthread_stop && num_files < LOG_ARCH_MAX_FILES && (dent = readdir(dirp))) {
+        if (!log_arch_match(dent->d_name, date, &rotated, &compressed) || !compressed)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, dent->d_name);
+        if (!stat(path, &st)) {
+            snprintf(files[num_files].name, sizeof(files[num_files].name), "%s", path);
+            files[num_files].size = st.st_size;
+            files[num_files].mtime = st.st_mtime;
+            ++num_files;
+        }
+    }
+    closedir(dirp);
+    if (g_logarchthread_stop) {
+        free(files);
+        return;
+    }
+    /* enforce retention limits, oldest compressed logs go first */
+    qsort(files, num_files, sizeof(ARCHFILE), log_arch_cmp_mtime);
+    now = time(NULL);
+    for (i = 0; i < num_files; i++) {
+        if (keep_days && files[i].mtime < now - (time_t)keep_days * 86400) {
+            unlink(files[i].name);
+            files[i].size = -1;
+        } else {
+            total += files[i].size;
+        }
+    }
+    for (i = 0; keep_size && total > keep_size && i < num_files; i++) {
+        if (files[i].size < 0)
+            continue;
+        unlink(files[i].name);
+        total -= files[i].size;
+    }
+    free(files);
+}
+
+void *log_arch_thread_func(void *data)
+{
+    char datestamp[LOG_ARCH_DATE_SIZE];
+    int pending;
+
+    while (!g_logarchthread_stop) {
+        pthread_mutex_lock(&mutex_log_arch);
+        pending = arch_pending;
+        arch_pending = 0;
+        snprintf(datestamp, sizeof(datestamp), "%s", arch_datestamp);
+        pthread_mutex_unlock(&mutex_log_arch);
+        if (pending)
+            log_arch_run(datestamp);
+        else
+            usleep(LOG_ARCH_POLL_MSEC * 1000);
+    }
+    return data;
+}
+
+void log_arch_start()
+{
+    g_logarchthread_stop = 0;
+    if (!g_logarchthread && pthread_create(&g_logarchthread, NULL, log_arch_thread_func, NULL))
+        g_logarchthread = 0;
+}
+
+void log_arch_stop()
+{
+    if (g_logarchthread) {
+        g_logarchthread_stop = 1;
+        pthread_join(g_logarchthread, NULL);
+        g_logarchthread = 0;
+    }
+}
+
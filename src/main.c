@@ -38,6 +38,9 @@
 #include "arim_beacon.h"
 #include "mbox.h"
 #include "auth.h"
+#include "zdict.h"
+#include "bufq.h"
+#include "trace.h"
 
 int g_cmdthread_stop;
 int g_cmdthread_ready;
@@ -45,9 +48,16 @@ int g_datathread_stop;
 int g_datathread_ready;
 int g_serialthread_stop;
 int g_serialthread_ready;
+int g_reactorthread_stop;
+int g_reactorthread_ready;
+int g_logthread_stop;
+int g_logarchthread_stop;
 pthread_t g_cmdthread;
 pthread_t g_datathread;
 pthread_t g_serialthread;
+pthread_t g_reactorthread;
+pthread_t g_logthread;
+pthread_t g_logarchthread;
 
 int g_tnc_attached;
 int g_win_changed;
@@ -59,15 +69,8 @@ static int timerthread_stop;
 
 pthread_mutex_t mutex_title = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_status = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t mutex_cmd_in = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t mutex_cmd_out = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_data_in = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t mutex_data_out = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t mutex_heard = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t mutex_debug_log = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t mutex_tncpi9k6_log = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_df_error_log = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t mutex_traffic_log = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_recents = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_ptable = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_ctable = PTHREAD_MUTEX_INITIALIZER;
@@ -78,6 +81,9 @@ pthread_mutex_t mutex_file_out = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_msg_out = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_tnc_busy = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_num_bytes = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mutex_tnc_flow = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mutex_log_arch = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mutex_mbox = PTHREAD_MUTEX_INITIALIZER;
 
 void sighandler(int sig, siginfo_t *siginfo, void *context)
 {
@@ -99,7 +105,7 @@ void *timerthread_func(void *data)
             if (g_tnc_attached) {
                 arim_beacon_on_alarm();
             }
-            log_on_alarm();
+            mbox_on_alarm();
         }
         usleep(100000);
     } while (!timerthread_stop);
@@ -148,6 +154,8 @@ int main(int argc, char *argv[])
             return 0;
         }
     }
+    /* initialize the message queues */
+    bufq_init();
     memset(&action, '\0', sizeof(action));
     action.sa_sigaction = &sighandler;
     action.sa_flags = SA_SIGINFO;
@@ -170,8 +178,12 @@ int main(int argc, char *argv[])
         printf("Error: cannot initialize password file\n");
         return 4;
     }
+    /* load optional compression dictionary */
+    zdict_init();
     /* initialize log directory */
     snprintf(g_log_dir_path, MAX_DIR_PATH_SIZE, "%s/%s", g_arim_path, "log");
+    /* initialize event tracing, dumps trace on crash */
+    trace_init();
     /* create the timer thread */
     result = pthread_create(&timerthread, NULL, timerthread_func, NULL);
     if (result) {
@@ -191,6 +203,10 @@ int main(int argc, char *argv[])
         g_datathread_stop = 1;
         pthread_join(g_datathread, NULL);
     }
+    if (g_reactorthread) {
+        g_reactorthread_stop = 1;
+        pthread_join(g_reactorthread, NULL);
+    }
     /* end the ui */
     ui_end();
     /* flush queued events to logs */
@@ -78,6 +78,8 @@
 #define MBOX_TYPE_SENT         2
 
 #define DEFAULT_DIGEST_FNAME   "arim-digest"
+#define DEFAULT_ZDICT_FNAME    "arim-zdict"
+#define DEFAULT_ZCACHE_DIR     ".zcache"
 #define DEFAULT_THEMES_FNAME   "arim-themes"
 #define DEFAULT_INI_FNAME      "arim.ini"
 #define DEFAULT_FILE_FNAME     "test.txt"
@@ -90,12 +92,19 @@
 extern pthread_t g_cmdthread;
 extern pthread_t g_datathread;
 extern pthread_t g_serialthread;
+extern pthread_t g_reactorthread;
+extern pthread_t g_logthread;
+extern pthread_t g_logarchthread;
 extern int g_cmdthread_stop;
 extern int g_cmdthread_ready;
 extern int g_datathread_stop;
 extern int g_datathread_ready;
 extern int g_serialthread_stop;
 extern int g_serialthread_ready;
+extern int g_reactorthread_stop;
+extern int g_reactorthread_ready;
+extern int g_logthread_stop;
+extern int g_logarchthread_stop;
 extern int g_timerthread_stop;
 extern int g_tnc_attached;
 extern int g_win_changed;
@@ -104,15 +113,8 @@ extern int g_print_config;
 
 extern pthread_mutex_t mutex_title;
 extern pthread_mutex_t mutex_status;
-extern pthread_mutex_t mutex_cmd_in;
-extern pthread_mutex_t mutex_cmd_out;
 extern pthread_mutex_t mutex_data_in;
-extern pthread_mutex_t mutex_data_out;
-extern pthread_mutex_t mutex_heard;
-extern pthread_mutex_t mutex_debug_log;
-extern pthread_mutex_t mutex_tncpi9k6_log;
 extern pthread_mutex_t mutex_df_error_log;
-extern pthread_mutex_t mutex_traffic_log;
 extern pthread_mutex_t mutex_recents;
 extern pthread_mutex_t mutex_ptable;
 extern pthread_mutex_t mutex_ctable;
@@ -123,6 +125,9 @@ extern pthread_mutex_t mutex_file_out;
 extern pthread_mutex_t mutex_msg_out;
 extern pthread_mutex_t mutex_tnc_busy;
 extern pthread_mutex_t mutex_num_bytes;
+extern pthread_mutex_t mutex_tnc_flow;
+extern pthread_mutex_t mutex_log_arch;
+extern pthread_mutex_t mutex_mbox;
 
 #endif
 
@@ -27,13 +27,19 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "main.h"
 #include "ini.h"
 #include "mbox.h"
+#include "mbox_idx.h"
+#include "mbox_scan.h"
 #include "util.h"
 #include "bufq.h"
 #include "ui_msg.h"
@@ -41,101 +47,359 @@
 
 char mbox_dir_path[MAX_PATH_SIZE];
 
-int mbox_purge(const char *fn, int days)
+/* set when messages have been deleted, checked by the timer thread */
+static atomic_int compact_wanted;
+
+int mbox_map_msg(const char *fn, const char *hdr, MBOXMAP *map, MBOXMSG *msg)
 {
-    FILE *mboxfp, *tempfp;
-    int fd, numch;
-    char *p, header[MAX_MBOX_HDR_SIZE], linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
-    char month[16], day[8], timestamp[16], year[8], datetime[64], logbuf[MAX_LOG_LINE_SIZE];
-    struct tm tm, *ptm;
-    time_t hdr_time, cur_time;
+    MBOXIDX *idx;
+    MBOXENT *ent;
+    char fpath[MAX_PATH_SIZE*2];
+    off_t off = -1;
 
-    /* 0 days means "disabled" */
-    if (days == 0)
-       return 1;
+    /* map mailbox and look up message in index, provided the mapping
+       is of the file that was indexed */
+    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
+    if (!mbox_scan_map(map, fpath))
+        return 0;
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
+    ent = mbox_idx_find(idx, hdr);
+    if (ent && idx->ino == map->ino && idx->dev == map->dev)
+        off = ent->off;
+    pthread_mutex_unlock(&mutex_mbox);
+    if (off == -1 || !mbox_scan_msg(map, off, msg)) {
+        mbox_scan_unmap(map);
+        return 0;
+    }
+    return 1;
+}
+
+int mbox_flag_col(int flag)
+{
+    /* status flags are the last three chars of the separator, "RFS",
+       preceded by the deleted mark 'D' */
+    switch(flag) {
+    case 'D':
+    case 'd':
+        return 4;
+    case 'R':
+    case 'r':
+        return 3;
+    case 'F':
+    case 'f':
+        return 2;
+    case 'S':
+    case 's':
+        return 1;
+    }
+    return 0;
+}
+
+int mbox_update_flags(const char *fn, const char *hdr, int flag, int set)
+{
+    MBOXIDX *idx;
+    MBOXENT *ent;
+    struct flock fl;
+    struct stat st;
+    char *p, flags[8], linebuf[MAX_MBOX_HDR_SIZE], fpath[MAX_PATH_SIZE*2];
+    size_t len, n;
+    int i, col, fd, result = 0;
+
+    pthread_mutex_lock(&mutex_mbox);
+    ent = mbox_idx_find((idx = mbox_idx_get(fn)), hdr);
+    if (!ent) {
+        pthread_mutex_unlock(&mutex_mbox);
+        return 0;
+    }
+    col = mbox_flag_col(flag);
+    n = (col == 4) ? 4 : 3;
+    len = strlen(ent->hdr);
+    p = ent->hdr + len - n;
+    /* separator must end with " -RFS" style status chars */
+    if (len < 6 || strspn(ent->hdr + len - 3, "-RFS") != 3 ||
+        (n == 4 && ((*p != '-' && *p != 'D') || *(p - 1) != ' ')) ||
+        (n == 3 && !strchr(" -D", *(p - 1)))) {
+        /* no status flags, message created by an old version */
+        pthread_mutex_unlock(&mutex_mbox);
+        return -1;
+    }
+    memcpy(flags, p, n);
+    if (flag == '*') {
+        for (i = 0; i < 3; i++)
+            flags[n - 3 + i] = '-';
+    } else if (col) {
+        flags[n - col] = set ? toupper(flag) : '-';
+    }
+    if (!memcmp(flags, p, n)) {
+        pthread_mutex_unlock(&mutex_mbox);
+        return 1;
+    }
+    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
+    fd = open(fpath, O_RDWR);
+    if (fd == -1) {
+        pthread_mutex_unlock(&mutex_mbox);
+        return 0;
+    }
+    /* lock the separator line and overwrite just the flag chars */
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = ent->off;
+    fl.l_len = len;
+    if (fcntl(fd, F_SETLKW, &fl) != -1) {
+        if (pread(fd, linebuf, len, ent->off) == (ssize_t)len &&
+            !memcmp(linebuf, ent->hdr, len) &&
+            pwrite(fd, flags, n, ent->off + len - n) == (ssize_t)n &&
+            fstat(fd, &st) == 0) {
+            memcpy(p, flags, n);
+            mbox_idx_on_update(idx, ent, &st);
+            if (col == 4 && set)
+                mbox_idx_on_delete(idx, ent);
+            result = 1;
+        }
+        fl.l_type = F_UNLCK;
+        fcntl(fd, F_SETLK, &fl);
+    }
+    close(fd);
+    pthread_mutex_unlock(&mutex_mbox);
+    return result;
+}
+
+/*  mktime() rereads the time zone rules on every call, which dominates
+    the cost of indexing a large mailbox. Message dates cluster on a few
+    days, so the start of the last day converted is cached per thread and
+    the time of day is added to it. */
+static _Thread_local char hdr_day_cache[32];
+static _Thread_local time_t hdr_day_time = -1;
+
+time_t mbox_hdr_time(const char *hdr)
+{
+    char *p, *save, header[MAX_MBOX_HDR_SIZE];
+    char month[16], day[8], timestamp[16], year[8], date[32];
+    struct tm tm;
+    int hh, mm, ss;
+
+    snprintf(header, sizeof(header), "%s", hdr);
+    /* skip to month */
+    p = strtok_r(header, " ", &save);
+    if (!p || !strtok_r(NULL, " ", &save) || !strtok_r(NULL, " ", &save))
+        return -1;
+    /* get the month */
+    p = strtok_r(NULL, " ", &save);
+    if (!p)
+        return -1;
+    snprintf(month, sizeof(month), "%s", p);
+    /* get day */
+    p = strtok_r(NULL, " ", &save);
+    if (!p)
+        return -1;
+    snprintf(day, sizeof(day), "%s", p);
+    /* get time */
+    p = strtok_r(NULL, " ", &save);
+    if (!p)
+        return -1;
+    snprintf(timestamp, sizeof(timestamp), "%s", p);
+    /* get year */
+    p = strtok_r(NULL, " ", &save);
+    if (!p)
+        return -1;
+    snprintf(year, sizeof(year), "%s", p);
+    if (sscanf(timestamp, "%d:%d:%d", &hh, &mm, &ss) != 3 ||
+        hh < 0 || hh > 23 || mm < 0 || mm > 59 || ss < 0 || ss > 60)
+        return -1;
+    snprintf(date, sizeof(date), "%s %s %s", day, month, year);
+    if (hdr_day_time == -1 || strcmp(date, hdr_day_cache)) {
+        memset(&tm, 0, sizeof(struct tm));
+        if (!strptime(date, "%d %b %Y", &tm))
+            return -1;
+        hdr_day_time = mktime(&tm);
+        if (hdr_day_time == -1)
+            return -1;
+        snprintf(hdr_day_cache, sizeof(hdr_day_cache), "%s", date);
+    }
+    return hdr_day_time + hh * 60 * 60 + mm * 60 + ss;
+}
+
+time_t mbox_purge_cutoff(int days)
+{
+    struct tm tm;
+    time_t cur_time;
+
+    /* separator dates are in UTC or local time per the ui setting,
+       runs on the timer thread so no shared static struct tm */
+    cur_time = time(NULL);
+    if (g_ui_utc_time)
+        gmtime_r(&cur_time, &tm);
+    else
+        localtime_r(&cur_time, &tm);
+    cur_time = mktime(&tm);
+    return cur_time - (time_t)days * 24 * 60 * 60;
+}
 
+int mbox_compact(const char *fn, int days, const char *drop)
+{
+    FILE *tempfp;
+    MBOXMAP map;
+    MBOXIDX *idx;
+    MBOXENT *ent, *drop_ent = NULL;
+    struct stat st;
+    time_t cutoff = 0;
+    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2], logbuf[MAX_LOG_LINE_SIZE];
+    size_t i;
+    int fd, numch, ok = 1, removed = 0, aged = 0;
+
+    /* copy live messages into a new mailbox in one pass, leaving out
+       deleted messages, messages older than 'days' days if non-zero
+       and the message with separator 'drop' if given */
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
+    if (idx == NULL) {
+        pthread_mutex_unlock(&mutex_mbox);
+        return 0;
+    }
+    if (drop && !(drop_ent = mbox_idx_find(idx, drop))) {
+        pthread_mutex_unlock(&mutex_mbox);
+        return 0;
+    }
     snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
+    if (!mbox_scan_map(&map, fpath)) {
+        pthread_mutex_unlock(&mutex_mbox);
+        return 0;
+    }
+    if (map.ino != idx->ino || map.size < idx->size) {
+        mbox_scan_unmap(&map);
+        pthread_mutex_unlock(&mutex_mbox);
         return 0;
+    }
     snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
     fd = mkstemp(tempfn);
     if (fd == -1) {
-        fclose(mboxfp);
+        mbox_scan_unmap(&map);
+        pthread_mutex_unlock(&mutex_mbox);
         return 0;
     }
     tempfp = fdopen(fd, "r+");
     if (tempfp == NULL) {
         close(fd);
-        fclose(mboxfp);
+        unlink(tempfn);
+        mbox_scan_unmap(&map);
+        pthread_mutex_unlock(&mutex_mbox);
         return 0;
     }
-    cur_time = time(NULL);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
-        ptm = gmtime(&cur_time);
-    else
-        ptm = localtime(&cur_time);
-    cur_time = mktime(ptm);
-    flockfile(mboxfp);
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        while (p && strncmp(p, "From ", 5)) {
-            fprintf(tempfp, "%s", linebuf);
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
+    if (stat(fpath, &st) == 0)
+        fchmod(fd, st.st_mode & 0777);
+    if (days)
+        cutoff = mbox_purge_cutoff(days);
+    /* keep anything ahead of the first message */
+    if (idx->cnt && idx->ents[0].off)
+        ok = (fwrite(map.base, 1, idx->ents[0].off, tempfp) == idx->ents[0].off);
+    for (i = 0; ok && i < idx->cnt; i++) {
+        ent = &idx->ents[i];
+        if (ent == drop_ent || mbox_idx_is_deleted(ent->hdr)) {
+            ++removed;
+            continue;
         }
-        if (p) {
-            snprintf(header, sizeof(header), "%s", p);
-            /* skip to month */
-            p = strtok(header, " ");
-            if (p && strtok(NULL, " ") && strtok(NULL, " ")) {
-                /* get the month */
-                p = strtok(NULL, " ");
-                if (p)
-                    snprintf(month, sizeof(month), "%s", p);
-                /* get day */
-                p = strtok(NULL, " ");
-                if (p)
-                    snprintf(day, sizeof(day), "%s", p);
-                /* get time */
-                p = strtok(NULL, " ");
-                if (p)
-                    snprintf(timestamp, sizeof(timestamp), "%s", p);
-                /* get year */
-                p = strtok(NULL, " ");
-                if (p) {
-                    snprintf(year, sizeof(year), "%s", p);
-                    snprintf(datetime, sizeof(datetime), "%s %s %s %s", day, month, year, timestamp);
-                    memset(&tm, 0, sizeof(struct tm));
-                    if (strptime(datetime, "%d %b %Y %H:%M:%S", &tm)) {
-                        hdr_time = mktime(&tm);
-                        if (hdr_time != -1) {
-                            if (difftime(cur_time, hdr_time) > (double)(days*24*60*60)) {
-                                /* message aged out, skip over it */
-                                numch = snprintf(logbuf, sizeof(logbuf), "MBOX %s purged: [%s]", fn, linebuf);
-                                if (numch >= sizeof(logbuf))
-                                    ui_truncate_line(logbuf, sizeof(logbuf));
-                                bufq_queue_debug_log(logbuf);
-                                p = fgets(linebuf, sizeof(linebuf), mboxfp);
-                                while (p && strncmp(p, "From ", 5)) {
-                                    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-                                }
-                                continue;
-                            }
-                        }
-                    }
-                }
-            }
-            fprintf(tempfp, "%s", linebuf);
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
+        if (days && ent->time != -1 && ent->time < cutoff) {
+            /* message aged out, skip over it */
+            numch = snprintf(logbuf, sizeof(logbuf), "MBOX %s purged: [%s]", fn, ent->hdr);
+            if (numch >= sizeof(logbuf))
+                ui_truncate_line(logbuf, sizeof(logbuf));
+            bufq_queue_debug_log(logbuf);
+            ++removed;
+            ++aged;
+            continue;
         }
-    } /* while (p) */
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    unlink(fpath);
-    fclose(tempfp);
-    rename(tempfn, fpath);
-    return 1;
+        ok = (fwrite(map.base + ent->off, 1, ent->len, tempfp) == ent->len);
+    }
+    mbox_scan_unmap(&map);
+    if (fclose(tempfp) != 0)
+        ok = 0;
+    if (ok && removed && rename(tempfn, fpath) == 0) {
+        mbox_idx_invalidate(fn);
+        if (!drop) {
+            snprintf(logbuf, sizeof(logbuf), "MBOX %s compacted, %d messages removed, %d older than %d days",
+                     fn, removed, aged, days);
+            bufq_queue_debug_log(logbuf);
+        }
+        if (aged)
+            msg_view_restart = 1;
+    } else {
+        unlink(tempfn);
+    }
+    pthread_mutex_unlock(&mutex_mbox);
+    return ok;
+}
+
+void mbox_compact_check(const char *fn)
+{
+    MBOXIDX *idx;
+    off_t dead, size;
+
+    /* reclaim space held by deleted messages once it exceeds the threshold */
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
+    dead = mbox_idx_dead_bytes(idx);
+    size = idx ? idx->size : 0;
+    pthread_mutex_unlock(&mutex_mbox);
+    if (dead >= MBOX_COMPACT_MIN_SIZE && dead * 100 >= size * MBOX_COMPACT_PCT)
+        mbox_compact(fn, 0, NULL);
+}
+
+void mbox_on_idle()
+{
+    /* called by the protocol thread when an exchange ends; compaction
+       rewrites whole mailboxes, so leave it to the timer thread */
+    atomic_store(&compact_wanted, 1);
+}
+
+int mbox_purge(const char *fn, int days)
+{
+    MBOXIDX *idx;
+    size_t aged;
+
+    /* 0 days means "disabled" */
+    if (days == 0)
+       return 1;
+    /* check the dates recorded in the index first, the mailbox
+       is only rewritten if some message has actually aged out */
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
+    if (idx == NULL) {
+        pthread_mutex_unlock(&mutex_mbox);
+        return 0;
+    }
+    aged = mbox_idx_aged_cnt(idx, mbox_purge_cutoff(days));
+    pthread_mutex_unlock(&mutex_mbox);
+    if (!aged)
+        return 1;
+    return mbox_compact(fn, days, NULL);
+}
+
+void mbox_on_alarm()
+{
+    static time_t last_purge;
+    time_t cur_time;
+    int days;
+
+    /* called every ALARM_INTERVAL_SEC secs from the timer thread, compacts
+       mailboxes when asked to and purges old messages at most once per
+       MBOX_PURGE_INTERVAL_SEC */
+    if (atomic_exchange(&compact_wanted, 0)) {
+        mbox_compact_check(MBOX_INBOX_FNAME);
+        mbox_compact_check(MBOX_OUTBOX_FNAME);
+        mbox_compact_check(MBOX_SENTBOX_FNAME);
+    }
+    cur_time = time(NULL);
+    if (last_purge && cur_time - last_purge < MBOX_PURGE_INTERVAL_SEC)
+        return;
+    last_purge = cur_time;
+    days = atoi(g_arim_settings.max_msg_days);
+    if (days == 0)
+        return;
+    mbox_purge(MBOX_INBOX_FNAME, days);
+    mbox_purge(MBOX_OUTBOX_FNAME, days);
+    mbox_purge(MBOX_SENTBOX_FNAME, days);
 }
 
 char *mbox_add_msg(const char *fn, const char *fm_call, const char *to_call,
@@ -143,15 +407,25 @@ char *mbox_add_msg(const char *fn, const char *fm_call, const char *to_call,
 {
     static char separator[MAX_MBOX_HDR_SIZE];
     FILE *mboxfp;
+    MBOXIDX *idx;
+    off_t off;
     char rcvd_hdr[MAX_ARIM_HDR_SIZE], call[TNC_MYCALL_SIZE];
     char timestamp[MAX_TIMESTAMP_SIZE], fpath[MAX_PATH_SIZE*2];
     const char *p, *prev;
     int insert_rcvd_hdr = 0, len = 0, i;
 
     snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
+    pthread_mutex_lock(&mutex_mbox);
+    /* bring index up to date before appending so only the new
+       message needs to be scanned afterwards */
+    idx = mbox_idx_get(fn);
     mboxfp = fopen(fpath, "a");
-    if (mboxfp == NULL)
+    if (mboxfp == NULL) {
+        pthread_mutex_unlock(&mutex_mbox);
         return NULL;
+    }
+    fseeko(mboxfp, 0, SEEK_END);
+    off = ftello(mboxfp);
     snprintf(call, sizeof(call), "%s", to_call);
     len = strlen(call);
     for (i = 0; i < len; i++)
@@ -204,152 +478,25 @@ char *mbox_add_msg(const char *fn, const char *fm_call, const char *to_call,
     fprintf(mboxfp, "\n\n"); /* mbox record ends with blank line */
     funlockfile(mboxfp);
     fclose(mboxfp);
+    mbox_idx_on_append(idx, off);
+    pthread_mutex_unlock(&mutex_mbox);
     return separator;
 }
 
 int mbox_set_flag(const char *fn, const char *hdr, int flag)
 {
-    FILE *mboxfp, *tempfp;
-    int fd, found = 0;
-    char *p, linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
-    size_t len;
+    int found;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
-    fd = mkstemp(tempfn);
-    if (fd == -1) {
-        fclose(mboxfp);
-        return 0;
-    }
-    tempfp = fdopen(fd, "r+");
-    if (tempfp == NULL) {
-        close(fd);
-        fclose(mboxfp);
-        return 0;
-    }
-    flockfile(mboxfp);
-    /* find matching message separator in file */
-    len = strlen(hdr);
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, len)) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, set flag */
-        found = 1;
-        while (*p && *p != '\n')
-            ++p;
-        if (*p && *(p - 4) == ' ') {
-            switch(flag) {
-            case 'R':
-            case 'r':
-                *(p - 3) = 'R';
-                break;
-            case 'F':
-            case 'f':
-                *(p - 2) = 'F';
-                break;
-            case 'S':
-            case 's':
-                *(p - 1) = 'S';
-                break;
-            }
-        }
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-        while (p) {
-            /* write into temp file */
-            fprintf(tempfp, "%s", linebuf);
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-        }
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    unlink(fpath);
-    fclose(tempfp);
-    rename(tempfn, fpath);
+    found = (mbox_update_flags(fn, hdr, flag, 1) != 0);
     msg_view_restart = 1;
     return found;
 }
 
 int mbox_clear_flag(const char *fn, const char *hdr, int flag)
 {
-    FILE *mboxfp, *tempfp;
-    int fd, found = 0;
-    char *p, linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
-    size_t len;
+    int found;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
-    fd = mkstemp(tempfn);
-    if (fd == -1) {
-        fclose(mboxfp);
-        return 0;
-    }
-    tempfp = fdopen(fd, "r+");
-    if (tempfp == NULL) {
-        close(fd);
-        fclose(mboxfp);
-        return 0;
-    }
-    flockfile(mboxfp);
-    /* find matching message separator in file */
-    len = strlen(hdr);
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, len)) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, clear flag */
-        found = 1;
-        while (*p && *p != '\n')
-            ++p;
-        if (*p && *(p - 4) == ' ') {
-            switch(flag) {
-            case 'R':
-            case 'r':
-                *(p - 3) = '-';
-                break;
-            case 'F':
-            case 'f':
-                *(p - 2) = '-';
-                break;
-            case 'S':
-            case 's':
-                *(p - 1) = '-';
-                break;
-            case '*':
-                *(p - 3) = '-';
-                *(p - 2) = '-';
-                *(p - 1) = '-';
-                break;
-            }
-        }
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-        while (p) {
-            /* write into temp file */
-            fprintf(tempfp, "%s", linebuf);
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-        }
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    unlink(fpath);
-    fclose(tempfp);
-    rename(tempfn, fpath);
+    found = (mbox_update_flags(fn, hdr, flag, 0) != 0);
     msg_view_restart = 1;
     return found;
 }
@@ -357,18 +504,19 @@ int mbox_clear_flag(const char *fn, const char *hdr, int flag)
 int mbox_get_msg_list(char *msgbuffer, size_t msgbufsize,
                          const char *fn, const char *to_call)
 {
-    FILE *mboxfp;
+    MBOXIDX *idx;
+    MBOXENT *ent;
     size_t len, cnt = 0;
     int numlines = 0;
-    char linebuf[MAX_MSG_LINE_SIZE], fpath[MAX_PATH_SIZE*2];
-    char *p, test[TNC_MYCALL_SIZE+8], header[MAX_MBOX_HDR_SIZE];
-    int i, numch;
+    char linebuf[MAX_MBOX_HDR_SIZE], header[MAX_MBOX_HDR_SIZE+16];
+    int numch;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
+    if (idx == NULL) {
+        pthread_mutex_unlock(&mutex_mbox);
         return 0;
-    flockfile(mboxfp);
+    }
     memset(msgbuffer, 0, msgbufsize);
     /* print preamble */
     snprintf(header, sizeof(header), "Messages for %s:\n", to_call);
@@ -379,29 +527,25 @@ int mbox_get_msg_list(char *msgbuffer, size_t msgbufsize,
         ++numlines;
     }
     /* find and copy messages addressed to 'to_call' */
-    snprintf(test, sizeof(test), " TO %s ", to_call);
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        if (!strncmp(p, "From ", 5)) {
-            /* message separator, see if to_call matches */
-            memset(header, 0, sizeof(header));
-            len = strlen(linebuf);
-            for (i = 0; i < len; i++)
-                header[i] = toupper(linebuf[i]);
-            if (strstr(header, test)) {
-                /* print separator into buffer sans the status flags */
-                linebuf[65] = '\0';
-                numch = snprintf(header, sizeof(header), "%3d %s\n", numlines, &linebuf[16]);
-                len = strlen(header);
-                if ((cnt + len) < msgbufsize) {
-                    strncat(msgbuffer, header, msgbufsize - cnt - 1);
-                    cnt += len;
-                    ++numlines;
-                }
-            }
+    for (ent = mbox_idx_first_to(idx, to_call); ent; ent = mbox_idx_next_to(idx, ent)) {
+        /* print separator into buffer sans the status flags */
+        snprintf(linebuf, sizeof(linebuf), "%s", ent->hdr);
+        if (strlen(linebuf) > 65)
+            linebuf[65] = '\0';
+        numch = snprintf(header, sizeof(header), "%3d %s\n", numlines,
+                         strlen(linebuf) > 16 ? &linebuf[16] : "");
+        if (numch >= sizeof(header)) {
+            /* keep the line break so rows don't run together */
+            header[sizeof(header)-2] = '\n';
+        }
+        len = strlen(header);
+        if ((cnt + len) < msgbufsize) {
+            strncat(msgbuffer, header, msgbufsize - cnt - 1);
+            cnt += len;
+            ++numlines;
         }
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
     }
+    pthread_mutex_unlock(&mutex_mbox);
     if (numlines < 2) {
         snprintf(header, sizeof(header), "   No messages.\n");
         len = strlen(header);
@@ -418,579 +562,170 @@ int mbox_get_msg_list(char *msgbuffer, size_t msgbufsize,
         cnt += strlen(header);
         ++numlines;
     }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    (void)numch; /* suppress 'assigned but not used' warning for dummy var */
     return numlines;
 }
 
-int mbox_get_headers_to(char headers[][MAX_MBOX_HDR_SIZE],
+int mbox_get_headers_to(char headers[][MAX_MBOX_HDR_SIZE+1],
                             int max_hdrs, const char *fn, const char *to_call)
 {
-    FILE *mboxfp;
-    char linebuf[MAX_MSG_LINE_SIZE], fpath[MAX_PATH_SIZE*2];
-    char *p, test[TNC_MYCALL_SIZE+8], header[MAX_MBOX_HDR_SIZE];
-    int i, numch, len, cnt = 0;
+    MBOXIDX *idx;
+    MBOXENT *ent;
+    int numch, cnt = 0;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    flockfile(mboxfp);
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
     /* find and copy messages addressed to 'to_call' */
-    snprintf(test, sizeof(test), " TO %s ", to_call);
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        if (!strncmp(p, "From ", 5)) {
-            /* message separator, see if to_call matches */
-            memset(header, 0, sizeof(header));
-            len = strlen(linebuf);
-            for (i = 0; i < len; i++)
-                header[i] = toupper(linebuf[i]);
-            if (strstr(header, test)) {
-                /* print separator into buffer */
-                numch = snprintf(headers[cnt++], MAX_MBOX_HDR_SIZE, "%s", linebuf);
-                if (cnt == max_hdrs)
-                    break;
-            }
-        }
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
+    ent = mbox_idx_first_to(idx, to_call);
+    for (; ent && cnt < max_hdrs; ent = mbox_idx_next_to(idx, ent)) {
+        /* print separator into buffer */
+        numch = snprintf(headers[cnt++], MAX_MBOX_HDR_SIZE+1, "%s\n", ent->hdr);
     }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
+    pthread_mutex_unlock(&mutex_mbox);
     (void)numch; /* suppress 'assigned but not used' warning for dummy var */
     return cnt;
 }
 
+int mbox_get_msg_cnt(const char *fn)
+{
+    MBOXIDX *idx;
+    int cnt = -1;
+
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
+    if (idx)
+        cnt = (int)mbox_idx_live_cnt(idx);
+    pthread_mutex_unlock(&mutex_mbox);
+    return cnt;
+}
+
+int mbox_get_header(char *header, size_t size, const char *fn, int msgnbr)
+{
+    MBOXIDX *idx;
+    MBOXENT *ent = NULL;
+
+    /* msgnbr counts undeleted messages from the start of the mailbox */
+    memset(header, 0, size);
+    pthread_mutex_lock(&mutex_mbox);
+    idx = mbox_idx_get(fn);
+    if (idx && msgnbr >= 0)
+        ent = mbox_idx_live_ent(idx, (size_t)msgnbr);
+    if (ent)
+        snprintf(header, size, "%s", ent->hdr);
+    pthread_mutex_unlock(&mutex_mbox);
+    return (ent != NULL);
+}
+
 int mbox_get_msg(char *msgbuffer, size_t msgbufsize,
                          const char *fn, const char *hdr, int canonical_eol)
 {
-    FILE *mboxfp;
-    size_t len, cnt = 0;
-    char *p, linebuf[MAX_MSG_LINE_SIZE], fpath[MAX_PATH_SIZE*2];
-    int found = 0;
+    MBOXMAP map;
+    MBOXMSG msg;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    flockfile(mboxfp);
     memset(msgbuffer, 0, msgbufsize);
-    /* find matching message separator in file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, strlen(hdr))) {
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, read message, discarding To: and From: header lines */
-        found = 1;
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* From: */
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* To:   */
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* may be empty line terminating headers
-                                                        or possibly a Received: header */
-        if (p && *p != '\n') {
-            /* not the empty line terminating headers, so write into msg buffer */
-            len = strlen(linebuf);
-            if ((cnt + len) < msgbufsize) {
-                strncat(msgbuffer, linebuf, msgbufsize - cnt - 1);
-                cnt += len;
-            }
-        }
-        do {
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-            if (p) {
-                len = strlen(linebuf);
-                /* check for 'From ' char sequence escaped with '>' char(s) */
-                while (*p && *p == '>')
-                    ++p;
-                if (p > linebuf && !strncmp(p, "From ", 5)) {
-                    /* found one, unescape line by removing first '>' char */
-                    if ((cnt + len - 1) < msgbufsize) {
-                        strncat(msgbuffer, &linebuf[1], msgbufsize - cnt - 1);
-                        cnt += len - 1;
-                    }
-                    if (canonical_eol) /* convert CRLF line endings */
-                        if (cnt > 1 && msgbuffer[cnt - 2] == '\r' && msgbuffer[cnt - 1] == '\n') {
-                            msgbuffer[cnt - 2] = '\n';
-                            msgbuffer[cnt - 1] = '\0';
-                            --cnt;
-                        }
-                } else if (p && !strncmp(p, "From ", 5)) {
-                    /* unescaped mbox separator from next msg in file, stop */
-                    break;
-                } else {
-                    /* write into msg buffer */
-                    if ((cnt + len) < msgbufsize) {
-                        strncat(msgbuffer, linebuf, msgbufsize - cnt - 1);
-                        cnt += len;
-                    }
-                    if (canonical_eol) /* convert CRLF line endings */
-                        if (cnt > 1 && msgbuffer[cnt - 2] == '\r' && msgbuffer[cnt - 1] == '\n') {
-                            msgbuffer[cnt - 2] = '\n';
-                            msgbuffer[cnt - 1] = '\0';
-                            --cnt;
-                        }
-                }
-            }
-        } while (p);
-        /* remove empty line added when stored to mbox file */
-        if (msgbuffer[cnt - 1] == '\n' && msgbuffer[cnt - 2] == '\n')
-            msgbuffer[cnt - 2] = '\0';
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    return found;
+    if (!mbox_map_msg(fn, hdr, &map, &msg))
+        return 0;
+    /* copy message, discarding To: and From: header lines */
+    mbox_scan_copy(msgbuffer, msgbufsize, msg.body, msg.end, canonical_eol, NULL);
+    mbox_scan_unmap(&map);
+    return 1;
 }
 
 int mbox_delete_msg(const char *fn, const char *hdr)
 {
-    FILE *mboxfp, *tempfp;
-    int fd, found = 0;
-    char *p, linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
+    int result;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
-    fd = mkstemp(tempfn);
-    if (fd == -1) {
-        fclose(mboxfp);
-        return 0;
-    }
-    tempfp = fdopen(fd, "r+");
-    if (tempfp == NULL) {
-        close(fd);
-        fclose(mboxfp);
-        return 0;
-    }
-    flockfile(mboxfp);
-    /* find matching message separator in file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, strlen(hdr))) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, skip over message */
-        found = 1;
-        do {
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-            if (p && !strncmp(p, "From ", 5)) {
-                /* found unescaped mbox separator from next msg in file, done */
-                fprintf(tempfp, "%s", linebuf);
-                break;
-            }
-        } while (p);
+    /* mark message deleted in place, space reclaimed by compaction */
+    result = mbox_update_flags(fn, hdr, 'D', 1);
+    if (result == -1) {
+        /* no room for the mark in old separators, remove it right away */
+        return mbox_compact(fn, 0, hdr);
     }
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    unlink(fpath);
-    fclose(tempfp);
-    rename(tempfn, fpath);
-    return found;
+    if (result)
+        atomic_store(&compact_wanted, 1);
+    return result;
 }
 
 int mbox_save_msg(const char *fn, const char *hdr, const char *savefn)
 {
-    FILE *mboxfp, *savefp, *tempfp;
-    char *p, *f, linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
-    int fd, found = 0;
+    FILE *savefp;
+    MBOXMAP map;
+    MBOXMSG msg;
+    int ok;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
-    fd = mkstemp(tempfn);
-    if (fd == -1) {
-        fclose(mboxfp);
+    if (!mbox_map_msg(fn, hdr, &map, &msg))
         return 0;
-    }
-    tempfp = fdopen(fd, "r+");
-    if (tempfp == NULL) {
-        close(fd);
-        fclose(mboxfp);
-        return 0;
-    }
     savefp = fopen(savefn, "w");
     if (savefp == NULL) {
-        fclose(mboxfp);
-        fclose(tempfp);
+        mbox_scan_unmap(&map);
         return 0;
     }
-    flockfile(mboxfp);
-    /* find matching message separator in file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, strlen(hdr))) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, set 'S' flag and write separator to temp file */
-        found = 1;
-        while (*p && *p != '\n')
-            ++p;
-        if (*p && *(p - 4) == ' ')
-            *(p - 1) = 'S';
-        fprintf(tempfp, "%s", linebuf);
-        /* start printing to save file */
-        fprintf(savefp, "%s", linebuf);
-        do {
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-            if (p && !strncmp(p, "From ", 5)) {
-                /* unescaped mbox separator from next msg in file,
-                   save it to temp file and stop */
-                fprintf(tempfp, "%s", linebuf);
-                break;
-            } else {
-                /* check for 'From ' char sequence escaped with '>' char(s) */
-                f = linebuf;
-                while (*f && *f == '>')
-                    ++f;
-                if (f > linebuf && !strncmp(f, "From ", 5))
-                    /* found one, unescape line by removing first '>' char */
-                    fprintf(savefp, "%s", &linebuf[1]);
-                else
-                    fprintf(savefp, "%s", linebuf);
-            }
-            /* write into temp file */
-            fprintf(tempfp, "%s", linebuf);
-        } while (p);
-    }
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    fclose(savefp);
-    fclose(tempfp);
-    unlink(fpath);
-    rename(tempfn, fpath);
-    return found;
+    /* write whole message incl. separator to save file */
+    ok = mbox_scan_write(savefp, msg.sep, msg.end);
+    mbox_scan_unmap(&map);
+    if (fclose(savefp) != 0)
+        ok = 0;
+    if (ok)
+        mbox_update_flags(fn, hdr, 'S', 1);
+    return ok;
 }
 
 int mbox_read_msg(char *msgbuffer, size_t msgbufsize,
                       const char *fn, const char *hdr)
 {
-    FILE *mboxfp, *tempfp;
-    size_t len, cnt = 0;
-    int fd, numlines = 0;
-    char *p, linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
+    MBOXMAP map;
+    MBOXMSG msg;
+    int numlines = 0;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
-    fd = mkstemp(tempfn);
-    if (fd == -1) {
-        fclose(mboxfp);
-        return 0;
-    }
-    tempfp = fdopen(fd, "r+");
-    if (tempfp == NULL) {
-        close(fd);
-        fclose(mboxfp);
-        return 0;
-    }
-    flockfile(mboxfp);
     memset(msgbuffer, 0, msgbufsize);
-    /* find matching message separator in file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, strlen(hdr))) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, set 'R' flag and print to file */
-        while (*p && *p != '\n')
-            ++p;
-        if (*p && *(p - 4) == ' ')
-            *(p - 3) = 'R';
-        fprintf(tempfp, "%s", linebuf);
-        /* extract message into buffer */
-        do {
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-            if (p) {
-                len = strlen(linebuf);
-                /* check for 'From ' char sequence escaped with '>' char(s) */
-                while (*p && *p == '>')
-                    ++p;
-                if (p > linebuf && !strncmp(p, "From ", 5)) {
-                    /* found one, unescape line by removing first '>' char */
-                    if ((cnt + len - 1) < msgbufsize) {
-                        strncat(msgbuffer, &linebuf[1],  msgbufsize - cnt - 1);
-                        cnt += len - 1;
-                        ++numlines;
-                        /* convert CRLF line endings */
-                        if (cnt > 1 && msgbuffer[cnt - 2] == '\r' && msgbuffer[cnt - 1] == '\n') {
-                            msgbuffer[cnt - 2] = '\n';
-                            msgbuffer[cnt - 1] = '\0';
-                            --cnt;
-                        }
-                    }
-                } else if (!strncmp(p, "From ", 5)) {
-                    /* unescaped mbox separator from next msg in file,
-                       save it to temp file and stop */
-                    fprintf(tempfp, "%s", linebuf);
-                    break;
-                } else {
-                    if ((cnt + len) < msgbufsize) {
-                        strncat(msgbuffer, linebuf, msgbufsize - cnt - 1);
-                        cnt += len;
-                        ++numlines;
-                        /* convert CRLF line endings */
-                        if (cnt > 1 && msgbuffer[cnt - 2] == '\r' && msgbuffer[cnt - 1] == '\n') {
-                            msgbuffer[cnt - 2] = '\n';
-                            msgbuffer[cnt - 1] = '\0';
-                            --cnt;
-                        }
-                    }
-                }
-                /* write into temp file */
-                fprintf(tempfp, "%s", linebuf);
-            }
-        } while (p);
-        /* remove empty line added when stored to mbox file */
-        if (msgbuffer[cnt - 1] == '\n' && msgbuffer[cnt - 2] == '\n')
-            msgbuffer[cnt - 2] = '\0';
-    }
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    fclose(tempfp);
-    unlink(fpath);
-    rename(tempfn, fpath);
+    if (!mbox_map_msg(fn, hdr, &map, &msg))
+        return 0;
+    /* copy message including headers */
+    mbox_scan_copy(msgbuffer, msgbufsize, msg.from_hdr, msg.end, 1, &numlines);
+    mbox_scan_unmap(&map);
+    mbox_update_flags(fn, hdr, 'R', 1);
     return numlines;
 }
 
 int mbox_fwd_msg(char *msgbuffer, size_t msgbufsize, const char *fn, const char *hdr)
 {
-    FILE *mboxfp, *tempfp;
-    size_t len, cnt = 0;
-    int fd, found = 0;
-    char *p, linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
+    MBOXMAP map;
+    MBOXMSG msg;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
-    fd = mkstemp(tempfn);
-    if (fd == -1) {
-        fclose(mboxfp);
-        return 0;
-    }
-    tempfp = fdopen(fd, "r+");
-    if (tempfp == NULL) {
-        close(fd);
-        fclose(mboxfp);
-        return 0;
-    }
-    flockfile(mboxfp);
     memset(msgbuffer, 0, msgbufsize);
-    /* find matching message separator in file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, strlen(hdr))) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, set flag and write separator to temp file */
-        while (*p && *p != '\n')
-            ++p;
-        if (*p && *(p - 4) == ' ')
-            *(p - 2) = 'F';
-        fprintf(tempfp, "%s", linebuf);
-        /* got it, read message, discarding To: and From: header lines */
-        found = 1;
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* From: */
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* To:   */
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* may be empty line terminating headers
-                                                        or possibly a Received: header */
-        if (p && *p != '\n') {
-            /* not the empty line terminating headers, so write into msg buffer */
-            len = strlen(linebuf);
-            if ((cnt + len) < msgbufsize) {
-                strncat(msgbuffer, linebuf, msgbufsize - cnt - 1);
-                cnt += len;
-            }
-        }
-        /* now copy body of message into msg buffer */
-        do {
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-            if (p) {
-                len = strlen(linebuf);
-                /* check for 'From ' char sequence escaped with '>' char(s) */
-                while (*p && *p == '>')
-                    ++p;
-                if (p > linebuf && !strncmp(p, "From ", 5)) {
-                    /* found one, unescape line by removing first '>' char */
-                    if ((cnt + len - 1) < msgbufsize) {
-                        strncat(msgbuffer, &linebuf[1], msgbufsize - cnt - 1);
-                        cnt += len - 1;
-                    }
-                } else if (!strncmp(p, "From ", 5)) {
-                    /* unescaped mbox separator from next msg in file,
-                       save it to temp file and stop */
-                    fprintf(tempfp, "%s", linebuf);
-                    break;
-                } else {
-                    /* write into msg buffer */
-                    if ((cnt + len) < msgbufsize) {
-                        strncat(msgbuffer, linebuf, msgbufsize - cnt - 1);
-                        cnt += len;
-                    }
-                }
-                /* write into temp file */
-                fprintf(tempfp, "%s", linebuf);
-            }
-        } while (p);
-        /* remove empty line added when stored to mbox file */
-        if (msgbuffer[cnt - 1] == '\n' && msgbuffer[cnt - 2] == '\n')
-            msgbuffer[cnt - 2] = '\0';
-    }
-    /* now copy the rest of the mbox file into the temp file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    unlink(fpath);
-    fclose(tempfp);
-    rename(tempfn, fpath);
-    return found;
+    if (!mbox_map_msg(fn, hdr, &map, &msg))
+        return 0;
+    /* copy message, discarding To: and From: header lines */
+    mbox_scan_copy(msgbuffer, msgbufsize, msg.body, msg.end, 0, NULL);
+    mbox_scan_unmap(&map);
+    mbox_update_flags(fn, hdr, 'F', 1);
+    return 1;
 }
 
 int mbox_send_msg(char *msgbuffer, size_t msgbufsize,
                 char *to_call, size_t to_call_size, const char *fn, const char *hdr)
 {
-    FILE *mboxfp, *tempfp;
-    size_t len, cnt = 0;
-    int fd, found = 0;
-    char *p, *s, *e, linebuf[MAX_MSG_LINE_SIZE];
-    char fpath[MAX_PATH_SIZE*2], tempfn[MAX_PATH_SIZE*2];
+    MBOXMAP map;
+    MBOXMSG msg;
+    const char *s, *e;
 
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (mboxfp == NULL)
-        return 0;
-    snprintf(tempfn, sizeof(tempfn), "%s/temp.mbox.XXXXXX", mbox_dir_path);
-    fd = mkstemp(tempfn);
-    if (fd == -1) {
-        fclose(mboxfp);
-        return 0;
-    }
-    tempfp = fdopen(fd, "r+");
-    if (tempfp == NULL) {
-        close(fd);
-        fclose(mboxfp);
-        return 0;
-    }
-    flockfile(mboxfp);
     memset(to_call, 0, to_call_size);
     memset(msgbuffer, 0, msgbufsize);
-    /* find matching message separator in file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p && strncmp(linebuf, hdr, strlen(hdr))) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    if (p) {
-        /* got it, read message, discarding To: and From: header lines */
-        found = 1;
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* From: */
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* To: header, extract call sign  */
-        s = p + 3;
-        while (*s == ' ')
-            ++s;
-        e = s;
-        while (*e && *e != ' ' && *e != '\n')
-            ++e;
-        *e = '\0';
-        snprintf(to_call, to_call_size, "%s", s);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp); /* may be empty line terminating headers
-                                                        or possibly a Received: header */
-        if (p && *p != '\n') {
-            /* not the empty line terminating headers, so write into msg buffer */
-            len = strlen(linebuf);
-            if ((cnt + len) < msgbufsize) {
-                strncat(msgbuffer, linebuf, msgbufsize - cnt - 1);
-                cnt += len;
-            }
-        }
-        /* now copy body of message into msg buffer but not into temp file */
-        do {
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-            if (p) {
-                len = strlen(linebuf);
-                /* check for 'From ' char sequence escaped with '>' char(s) */
-                while (*p && *p == '>')
-                    ++p;
-                if (p > linebuf && !strncmp(p, "From ", 5)) {
-                    /* found one, unescape line by removing first '>' char */
-                    if ((cnt + len - 1) < msgbufsize) {
-                        strncat(msgbuffer, &linebuf[1], msgbufsize - cnt - 1);
-                        cnt += len - 1;
-                    }
-                } else if (p && !strncmp(p, "From ", 5)) {
-                    /* unescaped mbox separator from next msg in file,
-                       save it to temp file and stop */
-                    fprintf(tempfp, "%s", linebuf);
-                    break;
-                } else {
-                    /* write into msg buffer */
-                    if ((cnt + len) < msgbufsize) {
-                        strncat(msgbuffer, linebuf, msgbufsize - cnt - 1);
-                        cnt += len;
-                    }
-                }
-            }
-        } while (p);
-        /* remove empty line added when stored to mbox file */
-        if (msgbuffer[cnt - 1] == '\n' && msgbuffer[cnt - 2] == '\n')
-            msgbuffer[cnt - 2] = '\0';
-    }
-    /* now copy the rest of the mbox file into the temp file */
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        /* write into temp file */
-        fprintf(tempfp, "%s", linebuf);
-        p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    unlink(fpath);
-    fclose(tempfp);
-    rename(tempfn, fpath);
-    return found;
+    if (!mbox_map_msg(fn, hdr, &map, &msg))
+        return 0;
+    /* extract call sign from To: header */
+    e = msg.body;
+    s = (e - msg.to_hdr > 3) ? msg.to_hdr + 3 : e;
+    while (s < e && *s == ' ')
+        ++s;
+    e = s;
+    while (e < msg.body && *e != ' ' && *e != '\n')
+        ++e;
+    snprintf(to_call, to_call_size, "%.*s", (int)(e - s), s);
+    /* copy message, discarding To: and From: header lines */
+    mbox_scan_copy(msgbuffer, msgbufsize, msg.body, msg.end, 0, NULL);
+    mbox_scan_unmap(&map);
+    mbox_delete_msg(fn, hdr);
+    return 1;
 }
 
 int mbox_init()
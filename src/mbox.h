@@ -24,8 +24,13 @@
 #ifndef _MBOX_H_INCLUDED_
 #define _MBOX_H_INCLUDED_
 
+#include <time.h>
 #include "main.h"
 
+#define MBOX_COMPACT_MIN_SIZE   65536   /* deleted bytes before compacting */
+#define MBOX_COMPACT_PCT        50      /* deleted percentage of mailbox */
+#define MBOX_PURGE_INTERVAL_SEC 3600    /* min time between purges of old messages */
+
 extern int mbox_init(void);
 extern char *mbox_add_msg(const char *fn, const char *fm_call, const char *to_call,
                               int check, const char *msg, int trace);
@@ -41,11 +46,17 @@ extern int mbox_send_msg(char *msgbuffer, size_t msgbufsize, char *tocall,
                              size_t to_call_size, const char *fn, const char *hdr);
 extern int mbox_get_msg_list(char *msgbuffer, size_t msgbufsize,
                                  const char *fn, const char *to_call);
-extern int mbox_get_headers_to(char headers[][MAX_MBOX_HDR_SIZE],
+extern int mbox_get_headers_to(char headers[][MAX_MBOX_HDR_SIZE+1],
                         int max_hdrs, const char *fn, const char *to_call);
+extern int mbox_get_msg_cnt(const char *fn);
+extern int mbox_get_header(char *header, size_t size, const char *fn, int msgnbr);
 extern int mbox_get_msg(char *msgbuffer, size_t msgbufsize,
                             const char *fn, const char *hdr, int canonical_eol);
 extern int mbox_purge(const char *fn, int days);
+extern int mbox_compact(const char *fn, int days, const char *drop);
+extern void mbox_on_idle(void);
+extern void mbox_on_alarm(void);
+extern time_t mbox_hdr_time(const char *hdr);
 extern char mbox_dir_path[];
 
 #endif
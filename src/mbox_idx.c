@@ -0,0 +1,656 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "ini.h"
+#include "mbox.h"
+#include "mbox_idx.h"
+#include "mbox_scan.h"
+
+/*  Each mailbox has a sidecar index file, e.g. in.mbox.idx, holding the
+    offset, length, date, separator line and destination call of every
+    message.
+    The index records the mailbox's inode, size and mtime when it was last
+    brought up to date; if the mailbox has only grown since then, just the
+    appended part is scanned, otherwise the index is rebuilt from scratch.
+    Messages are looked up by separator line through a hash table keyed on
+    the separator minus its three status flag characters. Callers must hold
+    mutex_mbox while using an index or any entry in it. */
+
+typedef struct mbox_idx_hdr {
+    char magic[MBOX_IDX_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t ent_size;
+    uint64_t cnt;
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} MBOXIDXHDR;
+
+static MBOXIDX mbox_idx_cache[MBOX_IDX_MAX_FILES];
+
+void mbox_idx_path(const char *fn, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s%s", mbox_dir_path, fn, MBOX_IDX_FNAME_EXT);
+}
+
+size_t mbox_idx_key_len(const char *hdr)
+{
+    size_t len;
+
+    /* key is separator line without newline, trailing status flags
+       and deleted mark */
+    len = strcspn(hdr, "\n");
+    return len > 4 ? len - 4 : len;
+}
+
+unsigned int mbox_idx_hash_key(const char *key, size_t len)
+{
+    unsigned int h = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+void mbox_idx_hash_insert(MBOXIDX *idx, size_t i)
+{
+    const char *key;
+    size_t len, slot, mask;
+
+    key = idx->ents[i].hdr;
+    len = mbox_idx_key_len(key);
+    mask = idx->hash_size - 1;
+    slot = mbox_idx_hash_key(key, len) & mask;
+    /* messages with the same key end up in file order along the probe
+       sequence, so lookups find the first live one as a file scan would */
+    while (idx->hash[slot])
+        slot = (slot + 1) & mask;
+    idx->hash[slot] = (int)i + 1;
+}
+
+int mbox_idx_grow_links(MBOXIDX *idx)
+{
+    int *p;
+
+    if (idx->links_cap >= idx->cap)
+        return 1;
+    p = realloc(idx->to_next, idx->cap * sizeof(int));
+    if (!p)
+        return 0;
+    idx->to_next = p;
+    p = realloc(idx->to_prev, idx->cap * sizeof(int));
+    if (!p)
+        return 0;
+    idx->to_prev = p;
+    idx->links_cap = idx->cap;
+    return 1;
+}
+
+MBOXCALL *mbox_idx_call_slot(MBOXIDX *idx, const char *call, int create)
+{
+    MBOXCALL *calls, *c;
+    size_t i, size, slot, mask;
+
+    if (create && (idx->calls_cnt + 1) * 2 > idx->calls_size) {
+        /* grow table, keeping existing chains */
+        size = idx->calls_size ? idx->calls_size * 2 : 64;
+        calls = calloc(size, sizeof(MBOXCALL));
+        if (!calls)
+            return NULL;
+        mask = size - 1;
+        for (i = 0; i < idx->calls_size; i++) {
+            if (!idx->calls[i].call[0])
+                continue;
+            slot = mbox_idx_hash_key(idx->calls[i].call, strlen(idx->calls[i].call)) & mask;
+            while (calls[slot].call[0])
+                slot = (slot + 1) & mask;
+            calls[slot] = idx->calls[i];
+        }
+        free(idx->calls);
+        idx->calls = calls;
+        idx->calls_size = size;
+    }
+    if (!idx->calls_size)
+        return NULL;
+    mask = idx->calls_size - 1;
+    slot = mbox_idx_hash_key(call, strlen(call)) & mask;
+    while (idx->calls[slot].call[0]) {
+        c = &idx->calls[slot];
+        if (!strcmp(c->call, call))
+            return c;
+        slot = (slot + 1) & mask;
+    }
+    if (!create)
+        return NULL;
+    c = &idx->calls[slot];
+    snprintf(c->call, sizeof(c->call), "%s", call);
+    c->head = c->tail = 0;
+    ++idx->calls_cnt;
+    return c;
+}
+
+int mbox_idx_link_to(MBOXIDX *idx, size_t i)
+{
+    MBOXCALL *c;
+
+    /* append message to chain of messages for its destination call */
+    idx->to_next[i] = idx->to_prev[i] = 0;
+    if (!idx->ents[i].to_call[0] || mbox_idx_is_deleted(idx->ents[i].hdr))
+        return 1;
+    c = mbox_idx_call_slot(idx, idx->ents[i].to_call, 1);
+    if (!c)
+        return 0;
+    idx->to_prev[i] = c->tail;
+    if (c->tail)
+        idx->to_next[c->tail - 1] = (int)i + 1;
+    else
+        c->head = (int)i + 1;
+    c->tail = (int)i + 1;
+    return 1;
+}
+
+void mbox_idx_unlink_to(MBOXIDX *idx, size_t i)
+{
+    MBOXCALL *c;
+
+    c = mbox_idx_call_slot(idx, idx->ents[i].to_call, 0);
+    if (!c)
+        return;
+    if (idx->to_prev[i])
+        idx->to_next[idx->to_prev[i] - 1] = idx->to_next[i];
+    else if (c->head == (int)i + 1)
+        c->head = idx->to_next[i];
+    else
+        return; /* not linked */
+    if (idx->to_next[i])
+        idx->to_prev[idx->to_next[i] - 1] = idx->to_prev[i];
+    else
+        c->tail = idx->to_prev[i];
+    idx->to_next[i] = idx->to_prev[i] = 0;
+}
+
+int mbox_idx_rehash(MBOXIDX *idx)
+{
+    size_t i, size = 64;
+
+    while (size < idx->cnt * 2)
+        size <<= 1;
+    if (size != idx->hash_size) {
+        free(idx->hash);
+        idx->hash = malloc(size * sizeof(int));
+        if (!idx->hash) {
+            idx->hash_size = 0;
+            return 0;
+        }
+        idx->hash_size = size;
+    }
+    memset(idx->hash, 0, idx->hash_size * sizeof(int));
+    for (i = 0; i < idx->cnt; i++)
+        mbox_idx_hash_insert(idx, i);
+    idx->live_valid = 0;
+    /* rebuild destination call chains */
+    if (!mbox_idx_grow_links(idx))
+        return 0;
+    if (idx->calls_size)
+        memset(idx->calls, 0, idx->calls_size * sizeof(MBOXCALL));
+    idx->calls_cnt = 0;
+    for (i = 0; i < idx->cnt; i++) {
+        if (!mbox_idx_link_to(idx, i))
+            return 0;
+    }
+    return 1;
+}
+
+int mbox_idx_is_deleted(const char *hdr)
+{
+    size_t len;
+
+    /* deleted messages are marked by 'D' in the column ahead of the
+       status flags, their space is reclaimed when the mailbox is compacted */
+    len = strcspn(hdr, "\n");
+    return len > 4 && hdr[len - 4] == 'D' && hdr[len - 5] == ' ';
+}
+
+MBOXENT *mbox_idx_find(MBOXIDX *idx, const char *hdr)
+{
+    size_t len, slot, mask;
+    MBOXENT *ent;
+
+    if (!idx || !idx->hash_size)
+        return NULL;
+    len = mbox_idx_key_len(hdr);
+    mask = idx->hash_size - 1;
+    slot = mbox_idx_hash_key(hdr, len) & mask;
+    while (idx->hash[slot]) {
+        ent = &idx->ents[idx->hash[slot] - 1];
+        if (mbox_idx_key_len(ent->hdr) == len && !strncmp(ent->hdr, hdr, len) &&
+            !mbox_idx_is_deleted(ent->hdr))
+            return ent;
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+int mbox_idx_add_ent(MBOXIDX *idx, off_t off, const char *line)
+{
+    MBOXENT *ent;
+    size_t i, cap;
+
+    if (idx->cnt == idx->cap) {
+        cap = idx->cap ? idx->cap * 2 : 256;
+        ent = realloc(idx->ents, cap * sizeof(MBOXENT));
+        if (!ent)
+            return 0;
+        idx->ents = ent;
+        idx->cap = cap;
+    }
+    ent = &idx->ents[idx->cnt];
+    memset(ent, 0, sizeof(MBOXENT));
+    ent->off = off;
+    snprintf(ent->hdr, sizeof(ent->hdr), "%.*s", (int)strcspn(line, "\n"), line);
+    /* parsed once here so purging doesn't have to reparse every date */
+    ent->time = mbox_hdr_time(ent->hdr);
+    /* separator is 'From CALL Www Mmm dd hh:mm:ss yyyy To CALL ...' */
+    if (sscanf(line, "From %*s %*s %*s %*s %*s %*s To %11s", ent->to_call) == 1) {
+        for (i = 0; ent->to_call[i]; i++)
+            ent->to_call[i] = toupper((int)ent->to_call[i]);
+    }
+    ++idx->cnt;
+    idx->live_valid = 0;
+    if (idx->cnt * 2 > idx->hash_size)
+        return mbox_idx_rehash(idx);
+    mbox_idx_hash_insert(idx, idx->cnt - 1);
+    if (!mbox_idx_grow_links(idx))
+        return 0;
+    return mbox_idx_link_to(idx, idx->cnt - 1);
+}
+
+int mbox_idx_scan(MBOXIDX *idx, off_t from)
+{
+    MBOXMAP map;
+    const char *p, *end;
+    char fpath[MAX_PATH_SIZE*2], line[MAX_MBOX_HDR_SIZE];
+    size_t len;
+    int ok = 1;
+
+    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, idx->fn);
+    if (!mbox_scan_map(&map, fpath))
+        return 0;
+    if (from > map.size) {
+        mbox_scan_unmap(&map);
+        return 0;
+    }
+    end = map.base + map.size;
+    p = map.base ? map.base + from : NULL;
+    /* anything ahead of the first separator belongs to the last message */
+    if (p && idx->cnt)
+        idx->ents[idx->cnt - 1].len = map.size - idx->ents[idx->cnt - 1].off;
+    while (ok && p && (p = mbox_scan_next_sep(&map, p))) {
+        len = mbox_scan_line_len(p, end);
+        snprintf(line, sizeof(line), "%.*s", (int)len, p);
+        ok = mbox_idx_add_ent(idx, p - map.base, line);
+        /* each message extends to the start of the next one */
+        if (idx->cnt > 1)
+            idx->ents[idx->cnt - 2].len = idx->ents[idx->cnt - 1].off - idx->ents[idx->cnt - 2].off;
+        if (ok)
+            idx->ents[idx->cnt - 1].len = map.size - idx->ents[idx->cnt - 1].off;
+        p = mbox_scan_next_line(p, end);
+    }
+    mbox_scan_unmap(&map);
+    return ok;
+}
+
+void mbox_idx_set_stat(MBOXIDX *idx, const struct stat *st)
+{
+    idx->dev = st->st_dev;
+    idx->ino = st->st_ino;
+    idx->size = st->st_size;
+    idx->mtime = st->st_mtim;
+}
+
+int mbox_idx_matches(MBOXIDX *idx, const struct stat *st)
+{
+    return idx->dev == st->st_dev && idx->ino == st->st_ino &&
+           idx->size == st->st_size && idx->mtime.tv_sec == st->st_mtim.tv_sec &&
+           idx->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+void mbox_idx_fill_hdr(MBOXIDX *idx, MBOXIDXHDR *hdr)
+{
+    memset(hdr, 0, sizeof(MBOXIDXHDR));
+    memcpy(hdr->magic, MBOX_IDX_MAGIC, MBOX_IDX_MAGIC_SIZE);
+    hdr->version = MBOX_IDX_VERSION;
+    hdr->ent_size = sizeof(MBOXENT);
+    hdr->cnt = idx->cnt;
+    hdr->dev = idx->dev;
+    hdr->ino = idx->ino;
+    hdr->size = idx->size;
+    hdr->mtime_sec = idx->mtime.tv_sec;
+    hdr->mtime_nsec = idx->mtime.tv_nsec;
+}
+
+int mbox_idx_save(MBOXIDX *idx)
+{
+    FILE *idxfp;
+    MBOXIDXHDR hdr;
+    char path[MAX_PATH_SIZE*2], tmp_path[MAX_PATH_SIZE*2+8];
+    int ok;
+
+    mbox_idx_path(idx->fn, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    idxfp = fopen(tmp_path, "w");
+    if (idxfp == NULL)
+        return 0;
+    mbox_idx_fill_hdr(idx, &hdr);
+    ok = (fwrite(&hdr, sizeof(hdr), 1, idxfp) == 1);
+    if (ok && idx->cnt)
+        ok = (fwrite(idx->ents, sizeof(MBOXENT), idx->cnt, idxfp) == idx->cnt);
+    if (fclose(idxfp) != 0)
+        ok = 0;
+    if (!ok || rename(tmp_path, path) == -1) {
+        unlink(tmp_path);
+        return 0;
+    }
+    return 1;
+}
+
+int mbox_idx_save_ent(MBOXIDX *idx, size_t i)
+{
+    MBOXIDXHDR hdr;
+    char path[MAX_PATH_SIZE*2];
+    off_t pos;
+    int fd, ok;
+
+    /* write just one entry and the updated header */
+    mbox_idx_path(idx->fn, path, sizeof(path));
+    fd = open(path, O_WRONLY);
+    if (fd == -1)
+        return mbox_idx_save(idx);
+    mbox_idx_fill_hdr(idx, &hdr);
+    pos = sizeof(hdr) + (off_t)i * sizeof(MBOXENT);
+    ok = (pwrite(fd, &idx->ents[i], sizeof(MBOXENT), pos) == sizeof(MBOXENT) &&
+          pwrite(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr));
+    close(fd);
+    return ok ? 1 : mbox_idx_save(idx);
+}
+
+int mbox_idx_load(MBOXIDX *idx)
+{
+    FILE *idxfp;
+    MBOXIDXHDR hdr;
+    MBOXENT *ents;
+    char path[MAX_PATH_SIZE*2];
+
+    mbox_idx_path(idx->fn, path, sizeof(path));
+    idxfp = fopen(path, "r");
+    if (idxfp == NULL)
+        return 0;
+    if (fread(&hdr, sizeof(hdr), 1, idxfp) != 1 ||
+        memcmp(hdr.magic, MBOX_IDX_MAGIC, MBOX_IDX_MAGIC_SIZE) ||
+        hdr.version != MBOX_IDX_VERSION || hdr.ent_size != sizeof(MBOXENT)) {
+        fclose(idxfp);
+        return 0;
+    }
+    ents = malloc((hdr.cnt ? hdr.cnt : 1) * sizeof(MBOXENT));
+    if (!ents || fread(ents, sizeof(MBOXENT), hdr.cnt, idxfp) != hdr.cnt) {
+        free(ents);
+        fclose(idxfp);
+        return 0;
+    }
+    fclose(idxfp);
+    free(idx->ents);
+    idx->ents = ents;
+    idx->cnt = idx->cap = hdr.cnt;
+    idx->dev = hdr.dev;
+    idx->ino = hdr.ino;
+    idx->size = hdr.size;
+    idx->mtime.tv_sec = hdr.mtime_sec;
+    idx->mtime.tv_nsec = hdr.mtime_nsec;
+    return 1;
+}
+
+int mbox_idx_can_extend(MBOXIDX *idx, const struct stat *st)
+{
+    char path[MAX_PATH_SIZE*2], buf[MAX_MBOX_HDR_SIZE];
+    MBOXENT *last;
+    size_t len;
+    int fd, ok;
+
+    /* index can be extended if mailbox has only been appended to */
+    if (idx->dev != st->st_dev || idx->ino != st->st_ino || idx->size > st->st_size)
+        return 0;
+    if (!idx->cnt)
+        return 1;
+    last = &idx->ents[idx->cnt - 1];
+    if (last->off + last->len != idx->size)
+        return 0;
+    snprintf(path, sizeof(path), "%s/%s", mbox_dir_path, idx->fn);
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return 0;
+    len = strlen(last->hdr);
+    ok = (pread(fd, buf, len, last->off) == (ssize_t)len && !memcmp(buf, last->hdr, len));
+    close(fd);
+    return ok;
+}
+
+MBOXIDX *mbox_idx_get(const char *fn)
+{
+    MBOXIDX *idx = NULL;
+    struct stat st;
+    char fpath[MAX_PATH_SIZE*2];
+    int i;
+
+    for (i = 0; i < MBOX_IDX_MAX_FILES; i++) {
+        if (!strcmp(mbox_idx_cache[i].fn, fn)) {
+            idx = &mbox_idx_cache[i];
+            break;
+        }
+        if (!idx && !mbox_idx_cache[i].fn[0])
+            idx = &mbox_idx_cache[i];
+    }
+    if (!idx)
+        return NULL;
+    if (!idx->fn[0])
+        snprintf(idx->fn, sizeof(idx->fn), "%s", fn);
+    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
+    if (stat(fpath, &st) == -1)
+        return NULL;
+    if (idx->valid && mbox_idx_matches(idx, &st))
+        return idx;
+    if (!idx->valid) {
+        /* first use, or invalidated, try the index file */
+        idx->cnt = 0;
+        if (mbox_idx_load(idx) && mbox_idx_matches(idx, &st) && mbox_idx_rehash(idx)) {
+            idx->valid = 1;
+            return idx;
+        }
+    }
+    if (idx->valid || idx->cnt) {
+        if (mbox_idx_can_extend(idx, &st)) {
+            if (!mbox_idx_rehash(idx) || !mbox_idx_scan(idx, idx->size))
+                idx->cnt = 0;
+        } else {
+            idx->cnt = 0;
+        }
+    }
+    if (!idx->cnt && (!mbox_idx_rehash(idx) || !mbox_idx_scan(idx, 0))) {
+        idx->valid = 0;
+        return NULL;
+    }
+    mbox_idx_set_stat(idx, &st);
+    idx->valid = 1;
+    mbox_idx_save(idx);
+    return idx;
+}
+
+void mbox_idx_on_append(MBOXIDX *idx, off_t off)
+{
+    struct stat st;
+    char fpath[MAX_PATH_SIZE*2];
+    size_t cnt;
+
+    if (!idx || !idx->valid)
+        return;
+    if (off != idx->size) {
+        /* mailbox changed behind our back, rebuild on next use */
+        idx->valid = 0;
+        return;
+    }
+    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, idx->fn);
+    cnt = idx->cnt;
+    if (stat(fpath, &st) == -1 || !mbox_idx_scan(idx, off)) {
+        idx->valid = 0;
+        return;
+    }
+    mbox_idx_set_stat(idx, &st);
+    if (idx->cnt == cnt + 1)
+        mbox_idx_save_ent(idx, cnt);
+    else
+        mbox_idx_save(idx);
+}
+
+void mbox_idx_invalidate(const char *fn)
+{
+    int i;
+
+    for (i = 0; i < MBOX_IDX_MAX_FILES; i++) {
+        if (!strcmp(mbox_idx_cache[i].fn, fn))
+            mbox_idx_cache[i].valid = 0;
+    }
+}
+
+void mbox_idx_on_update(MBOXIDX *idx, MBOXENT *ent, const struct stat *st)
+{
+    /* separator of ent was rewritten in place, record new mailbox
+       mtime so the index stays valid */
+    mbox_idx_set_stat(idx, st);
+    mbox_idx_save_ent(idx, ent - idx->ents);
+}
+
+off_t mbox_idx_dead_bytes(MBOXIDX *idx)
+{
+    off_t dead = 0;
+    size_t i;
+
+    for (i = 0; idx && i < idx->cnt; i++) {
+        if (mbox_idx_is_deleted(idx->ents[i].hdr))
+            dead += idx->ents[i].len;
+    }
+    return dead;
+}
+
+size_t mbox_idx_aged_cnt(MBOXIDX *idx, time_t cutoff)
+{
+    size_t i, cnt = 0;
+
+    for (i = 0; idx && i < idx->cnt; i++) {
+        if (idx->ents[i].time != -1 && idx->ents[i].time < cutoff &&
+            !mbox_idx_is_deleted(idx->ents[i].hdr))
+            ++cnt;
+    }
+    return cnt;
+}
+
+MBOXENT *mbox_idx_first_to(MBOXIDX *idx, const char *call)
+{
+    MBOXCALL *c;
+    char key[TNC_MYCALL_SIZE];
+    size_t i;
+
+    if (!idx)
+        return NULL;
+    snprintf(key, sizeof(key), "%s", call);
+    for (i = 0; key[i]; i++)
+        key[i] = toupper((int)key[i]);
+    c = mbox_idx_call_slot(idx, key, 0);
+    return (c && c->head) ? &idx->ents[c->head - 1] : NULL;
+}
+
+MBOXENT *mbox_idx_next_to(MBOXIDX *idx, MBOXENT *ent)
+{
+    int next;
+
+    next = idx->to_next[ent - idx->ents];
+    return next ? &idx->ents[next - 1] : NULL;
+}
+
+void mbox_idx_on_delete(MBOXIDX *idx, MBOXENT *ent)
+{
+    /* message was marked deleted, drop it from its call chain */
+    mbox_idx_unlink_to(idx, ent - idx->ents);
+    idx->live_valid = 0;
+}
+
+int mbox_idx_build_live(MBOXIDX *idx)
+{
+    int *p;
+    size_t i;
+
+    if (idx->live_valid)
+        return 1;
+    if (idx->live_cap < idx->cap) {
+        p = realloc(idx->live, idx->cap * sizeof(int));
+        if (!p)
+            return 0;
+        idx->live = p;
+        idx->live_cap = idx->cap;
+    }
+    idx->live_cnt = 0;
+    for (i = 0; i < idx->cnt; i++) {
+        if (!mbox_idx_is_deleted(idx->ents[i].hdr))
+            idx->live[idx->live_cnt++] = (int)i;
+    }
+    idx->live_valid = 1;
+    return 1;
+}
+
+size_t mbox_idx_live_cnt(MBOXIDX *idx)
+{
+    if (!idx || !mbox_idx_build_live(idx))
+        return 0;
+    return idx->live_cnt;
+}
+
+MBOXENT *mbox_idx_live_ent(MBOXIDX *idx, size_t n)
+{
+    /* n'th undeleted message in mailbox order, as numbered in listings */
+    if (!idx || !mbox_idx_build_live(idx) || n >= idx->live_cnt)
+        return NULL;
+    return &idx->ents[idx->live[n]];
+}
+
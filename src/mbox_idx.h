@@ -0,0 +1,92 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _MBOX_IDX_H_INCLUDED_
+#define _MBOX_IDX_H_INCLUDED_
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "main.h"
+#include "ini.h"
+
+#define MBOX_IDX_MAGIC          "ARIMIDX1"
+#define MBOX_IDX_MAGIC_SIZE     8
+#define MBOX_IDX_VERSION        2
+#define MBOX_IDX_FNAME_EXT      ".idx"
+#define MBOX_IDX_MAX_FILES      4
+
+typedef struct mbox_ent {
+    off_t off;                          /* offset of separator line */
+    off_t len;                          /* length of record incl. separator */
+    time_t time;                        /* separator date, -1 if unparseable */
+    char hdr[MAX_MBOX_HDR_SIZE];        /* separator line sans newline */
+    char to_call[TNC_MYCALL_SIZE];      /* upper case destination call */
+} MBOXENT;
+
+typedef struct mbox_call {
+    char call[TNC_MYCALL_SIZE];
+    int head;                           /* first message to call + 1, or 0 */
+    int tail;                           /* last message to call + 1, or 0 */
+} MBOXCALL;
+
+typedef struct mbox_idx {
+    char fn[MAX_MBOX_HDR_SIZE];
+    MBOXENT *ents;
+    size_t cnt;
+    size_t cap;
+    int *hash;
+    size_t hash_size;
+    MBOXCALL *calls;                    /* destination call -> messages */
+    size_t calls_size;
+    size_t calls_cnt;
+    int *to_next;                       /* next message to same call + 1 */
+    int *to_prev;
+    size_t links_cap;
+    int *live;                          /* live (undeleted) messages in order */
+    size_t live_cnt;
+    size_t live_cap;
+    int live_valid;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    int valid;
+} MBOXIDX;
+
+extern MBOXIDX *mbox_idx_get(const char *fn);
+extern MBOXENT *mbox_idx_find(MBOXIDX *idx, const char *hdr);
+extern int mbox_idx_is_deleted(const char *hdr);
+extern off_t mbox_idx_dead_bytes(MBOXIDX *idx);
+extern size_t mbox_idx_aged_cnt(MBOXIDX *idx, time_t cutoff);
+extern void mbox_idx_on_append(MBOXIDX *idx, off_t off);
+extern void mbox_idx_on_update(MBOXIDX *idx, MBOXENT *ent, const struct stat *st);
+extern void mbox_idx_on_delete(MBOXIDX *idx, MBOXENT *ent);
+extern MBOXENT *mbox_idx_first_to(MBOXIDX *idx, const char *call);
+extern MBOXENT *mbox_idx_next_to(MBOXIDX *idx, MBOXENT *ent);
+extern size_t mbox_idx_live_cnt(MBOXIDX *idx);
+extern MBOXENT *mbox_idx_live_ent(MBOXIDX *idx, size_t n);
+extern void mbox_idx_invalidate(const char *fn);
+
+#endif
+
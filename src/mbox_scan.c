@@ -0,0 +1,188 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/* need to define _GNU_SOURCE for memmem() */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mbox_scan.h"
+
+/*  Mailbox files are mapped read-only and searched with memmem/memchr
+    rather than read line by line, so finding message boundaries costs
+    about as much as a memory scan. Slices handed back point into the
+    mapping and stay valid until mbox_scan_unmap is called. */
+
+int mbox_scan_map(MBOXMAP *map, const char *fpath)
+{
+    struct stat st;
+    void *base;
+    int fd;
+
+    memset(map, 0, sizeof(MBOXMAP));
+    fd = open(fpath, O_RDONLY);
+    if (fd == -1)
+        return 0;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return 0;
+    }
+    map->dev = st.st_dev;
+    map->ino = st.st_ino;
+    if (st.st_size > 0) {
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        madvise(base, st.st_size, MADV_SEQUENTIAL);
+        map->base = base;
+        map->size = st.st_size;
+    }
+    /* mapping stays valid after the descriptor is closed */
+    close(fd);
+    return 1;
+}
+
+void mbox_scan_unmap(MBOXMAP *map)
+{
+    if (map->base)
+        munmap((void *)map->base, map->size);
+    memset(map, 0, sizeof(MBOXMAP));
+}
+
+const char *mbox_scan_next_sep(const MBOXMAP *map, const char *p)
+{
+    const char *end;
+
+    /* p must be at the start of a line, finds first "From " line at or
+       after p; escaped ">From " lines in bodies never match */
+    if (!map->base)
+        return NULL;
+    end = map->base + map->size;
+    if (end - p >= 5 && !memcmp(p, "From ", 5))
+        return p;
+    p = memmem(p, end - p, "\nFrom ", 6);
+    return p ? p + 1 : NULL;
+}
+
+const char *mbox_scan_next_line(const char *p, const char *end)
+{
+    p = memchr(p, '\n', end - p);
+    return p ? p + 1 : end;
+}
+
+size_t mbox_scan_line_len(const char *p, const char *end)
+{
+    const char *e;
+
+    e = memchr(p, '\n', end - p);
+    return e ? (size_t)(e - p) : (size_t)(end - p);
+}
+
+int mbox_scan_msg(const MBOXMAP *map, off_t off, MBOXMSG *msg)
+{
+    const char *end;
+
+    if (!map->base || off < 0 || off >= map->size)
+        return 0;
+    end = map->base + map->size;
+    msg->sep = map->base + off;
+    if (end - msg->sep < 5 || memcmp(msg->sep, "From ", 5))
+        return 0;
+    msg->sep_len = mbox_scan_line_len(msg->sep, end);
+    msg->end = mbox_scan_next_sep(map, mbox_scan_next_line(msg->sep, end));
+    if (!msg->end)
+        msg->end = end;
+    msg->from_hdr = mbox_scan_next_line(msg->sep, msg->end);
+    msg->to_hdr = mbox_scan_next_line(msg->from_hdr, msg->end);
+    msg->body = mbox_scan_next_line(msg->to_hdr, msg->end);
+    /* skip empty line terminating headers if there's no Received: header */
+    if (msg->body < msg->end && *msg->body == '\n')
+        ++msg->body;
+    return 1;
+}
+
+size_t mbox_scan_copy(char *buf, size_t bufsize, const char *p,
+                          const char *end, int crlf, int *numlines)
+{
+    const char *e, *f;
+    size_t len, cnt = 0;
+
+    /* copy lines into buf, unescaping '>From ' lines and optionally
+       converting CRLF line endings */
+    while (p < end) {
+        e = mbox_scan_next_line(p, end);
+        len = e - p;
+        /* check for 'From ' char sequence escaped with '>' char(s) */
+        f = p;
+        while (f < e && *f == '>')
+            ++f;
+        if (f > p && e - f >= 5 && !memcmp(f, "From ", 5)) {
+            /* found one, unescape line by removing first '>' char */
+            ++p;
+            --len;
+        }
+        if (cnt + len >= bufsize)
+            break;
+        memcpy(buf + cnt, p, len);
+        cnt += len;
+        if (crlf && cnt > 1 && buf[cnt - 2] == '\r' && buf[cnt - 1] == '\n') {
+            buf[cnt - 2] = '\n';
+            --cnt;
+        }
+        if (numlines)
+            ++(*numlines);
+        p = e;
+    }
+    /* remove empty line added when stored to mbox file */
+    if (cnt > 1 && buf[cnt - 1] == '\n' && buf[cnt - 2] == '\n')
+        cnt -= 2;
+    if (bufsize)
+        buf[cnt] = '\0';
+    return cnt;
+}
+
+int mbox_scan_write(FILE *fp, const char *p, const char *end)
+{
+    const char *e, *f;
+
+    /* write lines to fp, unescaping '>From ' lines */
+    while (p < end) {
+        e = mbox_scan_next_line(p, end);
+        f = p;
+        while (f < e && *f == '>')
+            ++f;
+        if (f > p && e - f >= 5 && !memcmp(f, "From ", 5))
+            ++p;
+        if (fwrite(p, 1, e - p, fp) != e - p)
+            return 0;
+        p = e;
+    }
+    return 1;
+}
+
@@ -0,0 +1,57 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _MBOX_SCAN_H_INCLUDED_
+#define _MBOX_SCAN_H_INCLUDED_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+typedef struct mbox_map {
+    const char *base;                   /* read-only mapping of mailbox */
+    size_t size;
+    dev_t dev;
+    ino_t ino;
+} MBOXMAP;
+
+typedef struct mbox_msg {
+    const char *sep;                    /* separator line */
+    size_t sep_len;                     /* length of separator sans newline */
+    const char *from_hdr;               /* 'From:' header line */
+    const char *to_hdr;                 /* 'To:' header line */
+    const char *body;                   /* body, incl. any 'Received:' header */
+    const char *end;                    /* start of next message or end of map */
+} MBOXMSG;
+
+extern int mbox_scan_map(MBOXMAP *map, const char *fpath);
+extern void mbox_scan_unmap(MBOXMAP *map);
+extern const char *mbox_scan_next_sep(const MBOXMAP *map, const char *p);
+extern const char *mbox_scan_next_line(const char *p, const char *end);
+extern size_t mbox_scan_line_len(const char *p, const char *end);
+extern int mbox_scan_msg(const MBOXMAP *map, off_t off, MBOXMSG *msg);
+extern size_t mbox_scan_copy(char *buf, size_t bufsize, const char *p,
+                                 const char *end, int crlf, int *numlines);
+extern int mbox_scan_write(FILE *fp, const char *p, const char *end);
+
+#endif
+
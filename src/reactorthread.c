@@ -0,0 +1,196 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*  Optional single thread i/o for the TCP TNC interface, enabled by the
+    'tcp-reactor' setting. Linux only (epoll/timerfd), elsewhere the
+    separate cmd and data threads are always used. */
+
+#ifdef __linux__
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include "main.h"
+#include "bufq.h"
+#include "ini.h"
+#include "arim.h"
+#include "ardop_cmds.h"
+#include "cmdthread.h"
+#include "datathread.h"
+#include "reactorthread.h"
+
+#define REACTOR_MAX_EVENTS      8
+#define REACTOR_PERIOD_MSEC     200
+
+int reactorthread_add_fd(int epfd, int fd)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int reactorthread_watch_write(int epfd, int fd, int enable)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = enable ? (EPOLLIN|EPOLLOUT) : EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+int reactorthread_start_timer()
+{
+    struct itimerspec its;
+    int timerfd;
+
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (timerfd == -1)
+        return -1;
+    memset(&its, 0, sizeof(its));
+    its.it_interval.tv_nsec = REACTOR_PERIOD_MSEC * 1000000L;
+    its.it_value.tv_nsec = REACTOR_PERIOD_MSEC * 1000000L;
+    if (timerfd_settime(timerfd, 0, &its, NULL) == -1) {
+        close(timerfd);
+        return -1;
+    }
+    return timerfd;
+}
+
+void *reactorthread_func(void *data)
+{
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    uint64_t expirations;
+    int cmdsock, datasock, timerfd, cmdnotifyfd, datanotifyfd, epfd;
+    int i, numev, fd, arim_timeout, data_wr = 0;
+
+    bufq_queue_debug_log("Reactor thread: initializing");
+    cmdsock = cmdthread_connect();
+    if (cmdsock == -1) {
+        g_reactorthread_stop = 1;
+        pthread_exit(data);
+    }
+    datasock = datathread_connect();
+    if (datasock == -1) {
+        close(cmdsock);
+        g_reactorthread_stop = 1;
+        pthread_exit(data);
+    }
+    /* this thread drains the cmd and data queues, it mustn't block pushing to them */
+    cmdq_set_consumer(&g_cmd_out_q);
+    dataq_set_consumer(&g_data_out_q);
+    epfd = epoll_create1(0);
+    timerfd = reactorthread_start_timer();
+    cmdnotifyfd = bufq_notify_open(&g_cmd_out_notify);
+    datanotifyfd = bufq_notify_open(&g_data_out_notify);
+    if (epfd == -1 || timerfd == -1 || cmdnotifyfd == -1 || datanotifyfd == -1 ||
+        reactorthread_add_fd(epfd, cmdsock) == -1 ||
+        reactorthread_add_fd(epfd, datasock) == -1 ||
+        reactorthread_add_fd(epfd, timerfd) == -1 ||
+        reactorthread_add_fd(epfd, cmdnotifyfd) == -1 ||
+        reactorthread_add_fd(epfd, datanotifyfd) == -1) {
+        bufq_queue_debug_log("Reactor thread: failed to set up epoll");
+        if (epfd != -1)
+            close(epfd);
+        if (timerfd != -1)
+            close(timerfd);
+        bufq_notify_close(&g_cmd_out_notify);
+        bufq_notify_close(&g_data_out_notify);
+        close(datasock);
+        close(cmdsock);
+        g_reactorthread_stop = 1;
+        pthread_exit(data);
+    }
+    g_reactorthread_ready = 1;
+    snprintf(g_tnc_settings[g_cur_tnc].busy,
+        sizeof(g_tnc_settings[g_cur_tnc].busy), "%s", "FALSE");
+    /* timeout specified in secs */
+    arim_timeout = atoi(g_arim_settings.frame_timeout);
+    arim_reset();
+    ardop_cmds_init();
+    while (!g_reactorthread_stop) {
+        numev = epoll_wait(epfd, events, REACTOR_MAX_EVENTS, REACTOR_PERIOD_MSEC);
+        if (numev == -1) {
+            if (errno != EINTR)
+                bufq_queue_debug_log("Reactor thread: epoll wait error (-1)");
+            continue;
+        }
+        for (i = 0; i < numev && !g_reactorthread_stop; i++) {
+            fd = events[i].data.fd;
+            if (fd == cmdsock) {
+                if (events[i].events & (EPOLLIN|EPOLLHUP))
+                    cmdthread_on_read(cmdsock);
+                else if (events[i].events & EPOLLERR)
+                    bufq_queue_debug_log("Reactor thread: cmd socket error (EPOLLERR)");
+            } else if (fd == datasock) {
+                if (events[i].events & EPOLLOUT)
+                    datathread_send_out(datasock);
+                if (events[i].events & (EPOLLIN|EPOLLHUP))
+                    datathread_on_read(datasock);
+                else if (events[i].events & EPOLLERR)
+                    bufq_queue_debug_log("Reactor thread: data socket error (EPOLLERR)");
+            } else if (fd == timerfd) {
+                /* missed expirations are coalesced into a single periodic event */
+                if (read(timerfd, &expirations, sizeof(expirations)) > 0) {
+                    cmdthread_drain_cmd_out(cmdsock);
+                    datathread_on_periodic(datasock, arim_timeout);
+                }
+            } else if (fd == cmdnotifyfd) {
+                /* clear wakeup before draining so later pushes aren't lost */
+                bufq_notify_clear(&g_cmd_out_notify);
+                cmdthread_drain_cmd_out(cmdsock);
+            } else if (fd == datanotifyfd) {
+                bufq_notify_clear(&g_data_out_notify);
+                datathread_send_out(datasock);
+            }
+        }
+        /* watch for data socket writability only while a frame is blocked */
+        if (data_wr != datathread_write_pending()) {
+            data_wr = !data_wr;
+            reactorthread_watch_write(epfd, datasock, data_wr);
+        }
+    }
+    snprintf(g_tnc_settings[g_cur_tnc].busy,
+        sizeof(g_tnc_settings[g_cur_tnc].busy), "%s", "FALSE");
+    bufq_queue_debug_log("Reactor thread: terminating");
+    sleep(2);
+    bufq_notify_close(&g_cmd_out_notify);
+    bufq_notify_close(&g_data_out_notify);
+    close(timerfd);
+    close(epfd);
+    close(datasock);
+    close(cmdsock);
+    return data;
+}
+
+#endif
+
@@ -0,0 +1,274 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include "ringq.h"
+
+/*  Lock-free ring queue of variable length records for one consumer thread
+    and one (RINGQ_SP) or several (RINGQ_MP) producer threads.
+
+    Each record is an 8 byte aligned header followed by its payload, which
+    may wrap around the end of the buffer. Buffer capacity must be a power
+    of 2. Head and tail are free running byte counts. A producer reserves
+    space by advancing the head (by compare-and-swap when there are several
+    producers), copies in its payload, then publishes the record by storing
+    its length with the commit bit set in the header. The consumer copies
+    out committed records in order, zeroes the space they used and then
+    releases it by advancing the tail. A record that is reserved but not yet
+    committed holds back the records behind it until its producer is done.
+
+    When a queue is full a push is handled according to the queue's policy:
+    RINGQ_DROP_NEWEST drops the new record, RINGQ_DROP_OLDEST discards old
+    records to make room, and RINGQ_BLOCK waits for the consumer to make
+    room, dropping the new record if it hasn't done so within
+    RINGQ_BLOCK_MSEC. The consumer thread can't wait for itself, so once it
+    has identified itself by calling ringq_set_consumer() a push it makes to
+    a full RINGQ_BLOCK queue fails at once; callers on that thread must
+    handle the failure. Dropped records are counted, and high water marks
+    are kept for bytes used and number of records queued. */
+
+#define RINGQ_COMMIT            0x80000000U
+#define RINGQ_REC_SIZE(n)       (((n) + 2 * RINGQ_HDR_SIZE - 1) & ~(size_t)(RINGQ_HDR_SIZE - 1))
+
+void ringq_init(RINGQ *q, unsigned char *buf, size_t cap, int mp, int policy)
+{
+    /* buffer must be zero filled; it isn't cleared here so that pages of
+       static storage aren't made resident until records are written to them */
+    q->buf = buf;
+    q->cap = cap;
+    q->mp = mp;
+    q->policy = policy;
+    atomic_flag_clear(&q->reader);
+    atomic_init(&q->peak_bytes, 0);
+    atomic_init(&q->peak_count, 0);
+    atomic_init(&q->drops, 0);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->count, 0);
+    atomic_init(&q->has_consumer, 0);
+}
+
+void ringq_set_consumer(RINGQ *q)
+{
+    /* called by the consumer thread when it starts */
+    q->consumer = pthread_self();
+    atomic_store_explicit(&q->has_consumer, 1, memory_order_release);
+}
+
+int ringq_is_consumer(RINGQ *q)
+{
+    return atomic_load_explicit(&q->has_consumer, memory_order_acquire) &&
+               pthread_equal(q->consumer, pthread_self());
+}
+
+atomic_uint *ringq_hdr(RINGQ *q, size_t pos)
+{
+    return (atomic_uint *)(q->buf + (pos & (q->cap - 1)));
+}
+
+void ringq_copy_in(RINGQ *q, size_t pos, const void *data, size_t len)
+{
+    size_t off, num;
+
+    off = pos & (q->cap - 1);
+    num = q->cap - off;
+    if (num > len)
+        num = len;
+    memcpy(q->buf + off, data, num);
+    memcpy(q->buf, (const unsigned char *)data + num, len - num);
+}
+
+void ringq_copy_out(RINGQ *q, size_t pos, void *data, size_t len)
+{
+    size_t off, num;
+
+    off = pos & (q->cap - 1);
+    num = q->cap - off;
+    if (num > len)
+        num = len;
+    memcpy(data, q->buf + off, num);
+    memcpy((unsigned char *)data + num, q->buf, len - num);
+}
+
+void ringq_zero(RINGQ *q, size_t pos, size_t len)
+{
+    size_t off, num;
+
+    off = pos & (q->cap - 1);
+    num = q->cap - off;
+    if (num > len)
+        num = len;
+    memset(q->buf + off, 0, num);
+    memset(q->buf, 0, len - num);
+}
+
+int ringq_try_push(RINGQ *q, const void *data, size_t len)
+{
+    size_t head, tail, need, used, peak;
+    int count;
+
+    need = RINGQ_REC_SIZE(len);
+    head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    do {
+        /* acquire pairs with consumer's release, space is zeroed before reuse */
+        tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head + need - tail > q->cap)
+            return 0; /* full */
+        if (!q->mp) {
+            atomic_store_explicit(&q->head, head + need, memory_order_relaxed);
+            break;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&q->head, &head, head + need,
+                                   memory_order_relaxed, memory_order_relaxed));
+    ringq_copy_in(q, head + RINGQ_HDR_SIZE, data, len);
+    atomic_store_explicit(ringq_hdr(q, head), (unsigned int)len | RINGQ_COMMIT,
+                              memory_order_release);
+    count = atomic_fetch_add_explicit(&q->count, 1, memory_order_relaxed) + 1;
+    /* update high water marks */
+    used = head + need - tail;
+    peak = atomic_load_explicit(&q->peak_bytes, memory_order_relaxed);
+    while (used > peak && !atomic_compare_exchange_weak_explicit(&q->peak_bytes,
+                              &peak, used, memory_order_relaxed, memory_order_relaxed))
+        ;
+    peak = atomic_load_explicit(&q->peak_count, memory_order_relaxed);
+    while ((size_t)count > peak && !atomic_compare_exchange_weak_explicit(&q->peak_count,
+                              &peak, count, memory_order_relaxed, memory_order_relaxed))
+        ;
+    return count;
+}
+
+int ringq_take(RINGQ *q, void *data, size_t size)
+{
+    size_t tail, len;
+    unsigned int val;
+
+    tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    val = atomic_load_explicit(ringq_hdr(q, tail), memory_order_acquire);
+    if (!(val & RINGQ_COMMIT))
+        return -1; /* empty, or next record not yet committed */
+    len = val & ~RINGQ_COMMIT;
+    if (data)
+        ringq_copy_out(q, tail + RINGQ_HDR_SIZE, data, len < size ? len : size);
+    atomic_store_explicit(ringq_hdr(q, tail), 0, memory_order_relaxed);
+    ringq_zero(q, tail + RINGQ_HDR_SIZE, RINGQ_REC_SIZE(len) - RINGQ_HDR_SIZE);
+    atomic_store_explicit(&q->tail, tail + RINGQ_REC_SIZE(len), memory_order_release);
+    atomic_fetch_sub_explicit(&q->count, 1, memory_order_relaxed);
+    return (int)(len < size ? len : size);
+}
+
+int ringq_discard_oldest(RINGQ *q)
+{
+    int result;
+
+    /*  a producer stands in for the consumer to discard the oldest record,
+        returns 0 if there's nothing it can discard */
+    if (atomic_flag_test_and_set_explicit(&q->reader, memory_order_acquire)) {
+        sched_yield(); /* consumer is popping, space will be freed shortly */
+        return 1;
+    }
+    result = ringq_take(q, NULL, 0);
+    atomic_flag_clear_explicit(&q->reader, memory_order_release);
+    if (result == -1)
+        return 0;
+    atomic_fetch_add_explicit(&q->drops, 1, memory_order_relaxed);
+    return 1;
+}
+
+int ringq_push(RINGQ *q, const void *data, size_t len)
+{
+    int count, msec = 0;
+
+    if (RINGQ_REC_SIZE(len) > q->cap || len >= RINGQ_COMMIT) {
+        atomic_fetch_add_explicit(&q->drops, 1, memory_order_relaxed);
+        return 0;
+    }
+    while (!(count = ringq_try_push(q, data, len))) {
+        if (q->policy == RINGQ_DROP_OLDEST && ringq_discard_oldest(q))
+            continue;
+        if (q->policy == RINGQ_BLOCK && msec < RINGQ_BLOCK_MSEC && !ringq_is_consumer(q)) {
+            /* wait for consumer, bounded in case it has stopped */
+            usleep(1000);
+            ++msec;
+            continue;
+        }
+        atomic_fetch_add_explicit(&q->drops, 1, memory_order_relaxed);
+        return 0;
+    }
+    return count;
+}
+
+int ringq_peek(RINGQ *q)
+{
+    size_t tail;
+    unsigned int val;
+
+    /* length of next record, or -1 if there's none ready to pop */
+    tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    val = atomic_load_explicit(ringq_hdr(q, tail), memory_order_acquire);
+    if (!(val & RINGQ_COMMIT))
+        return -1;
+    return (int)(val & ~RINGQ_COMMIT);
+}
+
+int ringq_pop(RINGQ *q, void *data, size_t size)
+{
+    int result;
+
+    if (q->policy != RINGQ_DROP_OLDEST)
+        return ringq_take(q, data, size);
+    /* producers may be discarding records from this queue */
+    while (atomic_flag_test_and_set_explicit(&q->reader, memory_order_acquire))
+        sched_yield();
+    result = ringq_take(q, data, size);
+    atomic_flag_clear_explicit(&q->reader, memory_order_release);
+    return result;
+}
+
+int ringq_get_count(RINGQ *q)
+{
+    return atomic_load_explicit(&q->count, memory_order_relaxed);
+}
+
+size_t ringq_get_bytes(RINGQ *q)
+{
+    return atomic_load_explicit(&q->head, memory_order_relaxed) -
+               atomic_load_explicit(&q->tail, memory_order_relaxed);
+}
+
+size_t ringq_get_peak_bytes(RINGQ *q)
+{
+    return atomic_load_explicit(&q->peak_bytes, memory_order_relaxed);
+}
+
+int ringq_get_peak_count(RINGQ *q)
+{
+    return (int)atomic_load_explicit(&q->peak_count, memory_order_relaxed);
+}
+
+unsigned long ringq_get_drops(RINGQ *q)
+{
+    return atomic_load_explicit(&q->drops, memory_order_relaxed);
+}
+
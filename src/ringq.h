@@ -0,0 +1,73 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _RINGQ_H_INCLUDED_
+#define _RINGQ_H_INCLUDED_
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define RINGQ_SP                0   /* single producer thread */
+#define RINGQ_MP                1   /* multiple producer threads */
+
+/* overflow policies */
+#define RINGQ_DROP_NEWEST       0
+#define RINGQ_DROP_OLDEST       1
+#define RINGQ_BLOCK             2
+
+/* longest wait for space in a RINGQ_BLOCK queue */
+#define RINGQ_BLOCK_MSEC        1000
+
+/* record header size, records are aligned on this boundary */
+#define RINGQ_HDR_SIZE          8
+
+typedef struct ring_q {
+    unsigned char *buf;
+    size_t cap;
+    int mp;
+    int policy;
+    atomic_size_t head;
+    atomic_size_t tail;
+    atomic_int count;
+    atomic_flag reader;
+    pthread_t consumer;
+    atomic_int has_consumer;
+    atomic_size_t peak_bytes;
+    atomic_size_t peak_count;
+    atomic_ulong drops;
+} RINGQ;
+
+extern void ringq_init(RINGQ *q, unsigned char *buf, size_t cap, int mp, int policy);
+extern void ringq_set_consumer(RINGQ *q);
+extern int ringq_push(RINGQ *q, const void *data, size_t len);
+extern int ringq_pop(RINGQ *q, void *data, size_t size);
+extern int ringq_peek(RINGQ *q);
+extern int ringq_get_count(RINGQ *q);
+extern size_t ringq_get_bytes(RINGQ *q);
+extern size_t ringq_get_peak_bytes(RINGQ *q);
+extern int ringq_get_peak_count(RINGQ *q);
+extern unsigned long ringq_get_drops(RINGQ *q);
+
+#endif
+
@@ -41,6 +41,7 @@
 #include "ardop_data.h"
 #include "util.h"
 #include "ui.h"
+#include "fstream.h"
 
 #define IO_STATE_ERROR            (-1)
 #define IO_STATE_IDLE               0
@@ -187,9 +188,7 @@ int serialthread_next_cmd_out(int fd)
     int state;
 
     state = io_state;
-    pthread_mutex_lock(&mutex_cmd_out);
     cmd = cmdq_pop(&g_cmd_out_q);
-    pthread_mutex_unlock(&mutex_cmd_out);
     if (cmd) {
         msgbuf[0] = IO_CHAN_CMD;
         msgbuf[1] = HOST_TNC_DATA;
@@ -206,6 +205,7 @@ int serialthread_send_file_out(int fd)
 {
     static size_t sent = 0, nblk = 0, nrem = 0;
     static unsigned char databuf[MAX_FILE_SIZE+4], framebuf[MAX_CMD_SIZE*2];
+    static FSTREAM *stream;
     FILEQUEUEITEM *item;
     unsigned char *p, *s;
     int state;
@@ -217,7 +217,10 @@ int serialthread_send_file_out(int fd)
         pthread_mutex_unlock(&mutex_file_out);
         if (!item)
             return state;
-        memcpy(databuf, item->data, item->size);
+        /* large files are read from the stream a block at a time */
+        stream = item->stream;
+        if (!stream)
+            memcpy(databuf, item->data, item->size);
         nblk = item->size / IO_DATA_BLOCK_SIZE;
         nrem = item->size % IO_DATA_BLOCK_SIZE;
         sent = 0;
@@ -231,7 +234,10 @@ int serialthread_send_file_out(int fd)
         *p++ = (IO_DATA_BLOCK_SIZE >> 8) & 0xFF;
         *p++ = IO_DATA_BLOCK_SIZE & 0xFF;
         s = databuf + sent;
-        memcpy(p, s, IO_DATA_BLOCK_SIZE);
+        if (stream)
+            fstream_read(stream, p, IO_DATA_BLOCK_SIZE);
+        else
+            memcpy(p, s, IO_DATA_BLOCK_SIZE);
         state = serialthread_send_frame(fd, (unsigned char *)framebuf, IO_DATA_BLOCK_SIZE + 5);
         if (state == IO_STATE_ERROR) {
             bufq_queue_debug_log("Serial thread: Send file frame to TNC, write to serial port failed");
@@ -247,7 +253,10 @@ int serialthread_send_file_out(int fd)
         *p++ = (nrem >> 8) & 0xFF;
         *p++ = nrem & 0xFF;
         s = databuf + sent;
-        memcpy(p, s, nrem);
+        if (stream)
+            fstream_read(stream, p, nrem);
+        else
+            memcpy(p, s, nrem);
         state = serialthread_send_frame(fd, (unsigned char *)framebuf, nrem + 5);
         if (state == IO_STATE_ERROR) {
             bufq_queue_debug_log("Serial thread: Send file frame to TNC, write to serial port failed");
@@ -332,9 +341,7 @@ int serialthread_send_data_out(int fd)
 
     state = io_state;
     if (!nblk && !nrem) { /* nothing to send, check for queued data */
-        pthread_mutex_lock(&mutex_data_out);
         data = dataq_pop(&g_data_out_q);
-        pthread_mutex_unlock(&mutex_data_out);
         if (!data)
             return state;
         snprintf(databuf, sizeof(databuf), "%s", data);
@@ -732,6 +739,10 @@ void *serialthread_func(void *data)
     time_t cur_time;
 
     bufq_queue_debug_log("Serial thread: initializing");
+    ardop_data_reset_rx();
+    /* this thread drains the cmd and data queues, it mustn't block pushing to them */
+    cmdq_set_consumer(&g_cmd_out_q);
+    dataq_set_consumer(&g_data_out_q);
     /* open serial port */
     snprintf(buffer, sizeof(buffer), "%s", g_tnc_settings[g_cur_tnc].serial_port);
     serialfd = open(buffer, O_RDWR | O_NOCTTY);
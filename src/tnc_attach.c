@@ -30,10 +30,12 @@
 #include "cmdthread.h"
 #include "datathread.h"
 #include "serialthread.h"
+#include "reactorthread.h"
 #include "ini.h"
 #include "ui.h"
 #include "arim_beacon.h"
 #include "tnc_attach.h"
+#include "tnc_flow.h"
 #include "log.h"
 #include "arim_arq.h"
 #include "arim_proto.h"
@@ -88,10 +90,47 @@ void tnc_get_version(const char *str)
     }
 }
 
+#ifdef __linux__
+int tnc_attach_reactor(int which)
+{
+    int result = 0;
+
+    g_cur_tnc = which;
+    g_reactorthread_ready = 0;
+    g_reactorthread_stop = 0;
+    result = pthread_create(&g_reactorthread, NULL, reactorthread_func, NULL);
+    if (!result) {
+        /* while waiting for thread to signal ready status,
+           check stop flag and terminate if set, because thread
+           encountered an error when attempting to connect */
+        do {
+            if (g_reactorthread_stop) {
+                pthread_join(g_reactorthread, NULL);
+                g_reactorthread = 0;
+                return 0;
+            }
+        } while (!g_reactorthread_ready);
+        g_tnc_attached = 1;
+        arim_beacon_set(atoi(g_tnc_settings[g_cur_tnc].btime));
+        ui_print_status("TNC connection successful", 1);
+        return 1;
+    } else {
+        g_reactorthread = 0;
+        ui_print_status("Failed to start TNC service thread", 1);
+        return 0;
+    }
+    return 1;
+}
+#endif
+
 int tnc_attach_tcp(int which)
 {
     int result1, result2 = 0;
 
+#ifdef __linux__
+    if (!strncasecmp(g_tnc_settings[which].tcp_reactor, "TRUE", 4))
+        return tnc_attach_reactor(which);
+#endif
     g_cur_tnc = which;
     g_cmdthread_ready = g_datathread_ready = 0;
     g_cmdthread_stop = g_datathread_stop = 0;
@@ -156,6 +195,11 @@ int tnc_attach_tcp(int which)
 
 int tnc_detach_tcp()
 {
+    if (g_reactorthread) {
+        g_reactorthread_stop = 1;
+        pthread_join(g_reactorthread, NULL);
+        g_reactorthread = 0;
+    }
     if (g_cmdthread) {
         g_cmdthread_stop = 1;
         pthread_join(g_cmdthread, NULL);
@@ -228,6 +272,7 @@ int tnc_attach(int which)
     if (!log_init(which)) {
         ui_print_status("Failed to initialize logging", 1);
     }
+    tnc_flow_init(which);
     if (!strncasecmp(g_tnc_settings[which].interface, "serial", 6))
         result = tnc_attach_serial(which);
     else
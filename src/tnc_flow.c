@@ -0,0 +1,197 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "main.h"
+#include "ini.h"
+#include "bufq.h"
+#include "tnc_flow.h"
+#include "trace.h"
+
+/*  Credit based flow control for data sent to the TNC. The TNC's BUFFER
+    notifications give the number of bytes waiting to be sent over the air;
+    bytes written that the notification may not have seen yet are added to
+    that to estimate the current buffer level. When the level drains below
+    the low water mark the data thread is woken and may refill the buffer up
+    to the high water mark, then it waits for the level to drop below the low
+    water mark again.
+
+    A notification arrives on the cmd socket some time after the TNC made
+    it, so writes made just before it arrived may not be counted in it.
+    Writes are kept with their time, and only those older than
+    TNC_FLOW_REPORT_LAG_MSEC are taken as seen by a notification. Counting
+    a write twice only delays the next refill a little, while missing one
+    could push the TNC past the high water mark. */
+
+#define TNC_FLOW_REPORT_LAG_MSEC  250
+#define TNC_FLOW_MAX_WRITES       16
+
+typedef struct tnc_flow_write {
+    struct timeval time;
+    size_t num;
+} TNC_FLOW_WRITE;
+
+static size_t buffer_cnt, bytes_pending;
+static size_t high_water, low_water;
+static int refilling;
+static TNC_FLOW_WRITE writes[TNC_FLOW_MAX_WRITES];
+static int writes_cnt;
+
+/* throughput of the most recent transfer, measured from the first write
+   to the TNC until its buffer has drained */
+static int xfer_active, xfer_queued;
+static size_t xfer_bytes, xfer_rate;
+static struct timeval xfer_start;
+
+void tnc_flow_init(int which)
+{
+    pthread_mutex_lock(&mutex_tnc_flow);
+    high_water = atoi(g_tnc_settings[which].tx_high_water);
+    low_water = atoi(g_tnc_settings[which].tx_low_water);
+    if (low_water >= high_water)
+        low_water = high_water / 2;
+    pthread_mutex_unlock(&mutex_tnc_flow);
+    tnc_flow_reset();
+}
+
+void tnc_flow_reset()
+{
+    pthread_mutex_lock(&mutex_tnc_flow);
+    buffer_cnt = bytes_pending = 0;
+    writes_cnt = 0;
+    refilling = 1;
+    xfer_active = xfer_queued = 0;
+    xfer_bytes = 0;
+    pthread_mutex_unlock(&mutex_tnc_flow);
+}
+
+void tnc_flow_on_buffer(size_t cnt)
+{
+    char linebuf[MAX_LOG_LINE_SIZE];
+    struct timeval now;
+    long msec = -1;
+    int wake;
+
+    trace_record(TRACE_TNC_BUFFER, (int)cnt, 0, 0);
+    gettimeofday(&now, NULL);
+    pthread_mutex_lock(&mutex_tnc_flow);
+    buffer_cnt = cnt;
+    /* forget only writes old enough to be counted in this report */
+    while (writes_cnt) {
+        msec = (now.tv_sec - writes[0].time.tv_sec) * 1000 +
+               (now.tv_usec - writes[0].time.tv_usec) / 1000;
+        if (msec < TNC_FLOW_REPORT_LAG_MSEC)
+            break;
+        bytes_pending -= writes[0].num;
+        --writes_cnt;
+        memmove(&writes[0], &writes[1], writes_cnt * sizeof(TNC_FLOW_WRITE));
+    }
+    msec = -1;
+    if (buffer_cnt <= low_water)
+        refilling = 1;
+    wake = refilling;
+    if (xfer_active && xfer_queued && !buffer_cnt) {
+        msec = (now.tv_sec - xfer_start.tv_sec) * 1000 +
+               (now.tv_usec - xfer_start.tv_usec) / 1000;
+        if (msec <= 0)
+            msec = 1;
+        xfer_rate = (xfer_bytes * 1000) / msec;
+        xfer_active = xfer_queued = 0;
+        snprintf(linebuf, sizeof(linebuf),
+                 "Data thread: sent %zu bytes in %ld.%01ld sec (%zu bytes/sec)",
+                     xfer_bytes, msec / 1000, (msec % 1000) / 100, xfer_rate);
+    }
+    pthread_mutex_unlock(&mutex_tnc_flow);
+    if (msec != -1)
+        bufq_queue_debug_log(linebuf);
+    if (wake)
+        bufq_notify(&g_data_out_notify); /* wake data thread to refill TNC buffer */
+}
+
+void tnc_flow_on_write(size_t num)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    pthread_mutex_lock(&mutex_tnc_flow);
+    if (writes_cnt == TNC_FLOW_MAX_WRITES) {
+        /* full, fold the oldest into the next one so it is kept longer */
+        writes[1].num += writes[0].num;
+        --writes_cnt;
+        memmove(&writes[0], &writes[1], writes_cnt * sizeof(TNC_FLOW_WRITE));
+    }
+    writes[writes_cnt].time = now;
+    writes[writes_cnt].num = num;
+    ++writes_cnt;
+    bytes_pending += num;
+    if (buffer_cnt + bytes_pending >= high_water)
+        refilling = 0;
+    if (xfer_active)
+        xfer_bytes += num;
+    pthread_mutex_unlock(&mutex_tnc_flow);
+}
+
+size_t tnc_flow_get_credit()
+{
+    size_t level, credit = 0;
+
+    pthread_mutex_lock(&mutex_tnc_flow);
+    level = buffer_cnt + bytes_pending;
+    if (refilling && level < high_water)
+        credit = high_water - level;
+    pthread_mutex_unlock(&mutex_tnc_flow);
+    return credit;
+}
+
+void tnc_flow_xfer_begin()
+{
+    pthread_mutex_lock(&mutex_tnc_flow);
+    if (!xfer_active) {
+        xfer_active = 1;
+        xfer_bytes = 0;
+        gettimeofday(&xfer_start, NULL);
+    }
+    xfer_queued = 0;
+    pthread_mutex_unlock(&mutex_tnc_flow);
+}
+
+void tnc_flow_xfer_end()
+{
+    pthread_mutex_lock(&mutex_tnc_flow);
+    xfer_queued = 1;
+    pthread_mutex_unlock(&mutex_tnc_flow);
+}
+
+size_t tnc_flow_get_throughput()
+{
+    size_t rate;
+
+    pthread_mutex_lock(&mutex_tnc_flow);
+    rate = xfer_rate;
+    pthread_mutex_unlock(&mutex_tnc_flow);
+    return rate;
+}
+
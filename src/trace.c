@@ -0,0 +1,294 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "main.h"
+#include "arim_proto.h"
+#include "trace.h"
+
+/*  Each thread records into its own fixed size ring of binary records, so
+    recording is a clock read and a few stores with no lock or formatting.
+    Rings are claimed on a thread's first record and released when it exits,
+    as the TNC threads are restarted on every attach. Unused rings are taken
+    before released ones, so the records of exited threads are kept as long
+    as possible. A dump taken while threads are running may catch a record
+    being overwritten; that's acceptable for a diagnostic snapshot. */
+typedef struct trace_ring {
+    atomic_ullong head;
+    atomic_int in_use;
+    uint32_t tid;
+    TRACEREC rec[TRACE_RING_SIZE];
+} TRACERING;
+
+static TRACERING trace_rings[TRACE_MAX_THREADS];
+static atomic_int trace_num_rings;
+static atomic_int trace_state;
+static _Thread_local TRACERING *trace_ring;
+static _Thread_local int trace_no_ring;
+static pthread_key_t trace_ring_key;
+static pthread_once_t trace_ring_key_once = PTHREAD_ONCE_INIT;
+static int trace_ring_key_ok;
+static char trace_crash_fn[MAX_PATH_SIZE];
+
+void trace_release_ring(void *arg)
+{
+    TRACERING *ring = arg;
+
+    /* thread exit, later records from this thread are dropped */
+    trace_ring = NULL;
+    trace_no_ring = 1;
+    atomic_store_explicit(&ring->in_use, 0, memory_order_release);
+}
+
+void trace_make_ring_key()
+{
+    trace_ring_key_ok = !pthread_key_create(&trace_ring_key, trace_release_ring);
+}
+
+TRACERING *trace_claim_ring(int reuse)
+{
+    int i, cnt, expected;
+
+    for (i = 0; i < TRACE_MAX_THREADS; i++) {
+        if (!reuse && atomic_load_explicit(&trace_rings[i].head, memory_order_relaxed))
+            continue;
+        expected = 0;
+        if (!atomic_compare_exchange_strong(&trace_rings[i].in_use, &expected, 1))
+            continue;
+        /* rings past trace_num_rings aren't dumped */
+        cnt = atomic_load(&trace_num_rings);
+        while (cnt <= i && !atomic_compare_exchange_weak(&trace_num_rings, &cnt, i + 1))
+            ;
+        return &trace_rings[i];
+    }
+    return NULL;
+}
+
+TRACERING *trace_get_ring()
+{
+    TRACERING *ring;
+
+    if (trace_ring || trace_no_ring)
+        return trace_ring;
+    pthread_once(&trace_ring_key_once, trace_make_ring_key);
+    ring = trace_claim_ring(0);
+    if (!ring)
+        ring = trace_claim_ring(1);
+    if (!ring) {
+        trace_no_ring = 1;
+        return NULL;
+    }
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+#ifdef __linux__
+    ring->tid = (uint32_t)syscall(SYS_gettid);
+#else
+    ring->tid = (uint32_t)(ring - trace_rings);
+#endif
+    /* without a key the ring can't be released, keep it for good */
+    if (trace_ring_key_ok)
+        pthread_setspecific(trace_ring_key, ring);
+    trace_ring = ring;
+    return trace_ring;
+}
+
+TRACEREC *trace_next_rec(TRACERING **ring, int type)
+{
+    struct timeval tv;
+    TRACEREC *rec;
+    unsigned long long head;
+
+    *ring = trace_get_ring();
+    if (!*ring)
+        return NULL;
+    head = atomic_load_explicit(&(*ring)->head, memory_order_relaxed);
+    rec = &(*ring)->rec[head & (TRACE_RING_SIZE - 1)];
+    gettimeofday(&tv, NULL);
+    rec->usec = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    rec->type = (uint16_t)type;
+    rec->state = (uint16_t)atomic_load_explicit(&trace_state, memory_order_relaxed);
+    rec->spare = 0;
+    return rec;
+}
+
+void trace_commit_rec(TRACERING *ring)
+{
+    atomic_fetch_add_explicit(&ring->head, 1, memory_order_release);
+}
+
+void trace_set_state(int state)
+{
+    atomic_store_explicit(&trace_state, state, memory_order_relaxed);
+}
+
+void trace_event(int event, int param, int prev_state)
+{
+    TRACERING *ring;
+    TRACEREC *rec;
+
+    rec = trace_next_rec(&ring, TRACE_EVENT);
+    if (!rec)
+        return;
+    rec->id = (uint16_t)event;
+    rec->arg[0] = param;
+    rec->arg[1] = prev_state;
+    rec->arg[2] = rec->arg[3] = 0;
+    trace_commit_rec(ring);
+}
+
+void trace_record(int type, int arg0, int arg1, int arg2)
+{
+    TRACERING *ring;
+    TRACEREC *rec;
+
+    rec = trace_next_rec(&ring, type);
+    if (!rec)
+        return;
+    rec->id = 0;
+    rec->arg[0] = arg0;
+    rec->arg[1] = arg1;
+    rec->arg[2] = arg2;
+    rec->arg[3] = 0;
+    trace_commit_rec(ring);
+}
+
+int trace_write(int fd, const void *data, size_t size)
+{
+    const char *p = data;
+    ssize_t result;
+
+    while (size) {
+        result = write(fd, p, size);
+        if (result < 0)
+            return 0;
+        p += result;
+        size -= result;
+    }
+    return 1;
+}
+
+int trace_dump_fd(int fd)
+{
+    TRACEHDR hdr;
+    TRACETHR thr;
+    unsigned long long head, start;
+    int i, num_rings;
+
+    /* called from the crash signal handler, so only async-signal-safe calls */
+    num_rings = atomic_load(&trace_num_rings);
+    if (num_rings > TRACE_MAX_THREADS)
+        num_rings = TRACE_MAX_THREADS;
+    hdr.num_events = EV_NUM_EVENTS;
+    hdr.num_states = ST_NUM_STATES;
+    hdr.num_threads = num_rings;
+    hdr.rec_size = sizeof(TRACEREC);
+    if (!trace_write(fd, TRACE_MAGIC, TRACE_MAGIC_SIZE) ||
+        !trace_write(fd, &hdr, sizeof(hdr)))
+        return 0;
+    for (i = 0; i < EV_NUM_EVENTS; i++) {
+        if (!trace_write(fd, events[i], strlen(events[i]) + 1))
+            return 0;
+    }
+    for (i = 0; i < ST_NUM_STATES; i++) {
+        if (!trace_write(fd, states[i], strlen(states[i]) + 1))
+            return 0;
+    }
+    for (i = 0; i < num_rings; i++) {
+        head = atomic_load_explicit(&trace_rings[i].head, memory_order_acquire);
+        start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        thr.tid = trace_rings[i].tid;
+        thr.cnt = (uint32_t)(head - start);
+        if (!trace_write(fd, &thr, sizeof(thr)))
+            return 0;
+        /* oldest records first, in up to two contiguous runs */
+        while (start < head) {
+            size_t idx = start & (TRACE_RING_SIZE - 1);
+            size_t cnt = TRACE_RING_SIZE - idx;
+
+            if (cnt > head - start)
+                cnt = head - start;
+            if (!trace_write(fd, &trace_rings[i].rec[idx], cnt * sizeof(TRACEREC)))
+                return 0;
+            start += cnt;
+        }
+    }
+    return 1;
+}
+
+int trace_dump(char *fn, size_t size)
+{
+    time_t t;
+    struct tm tm;
+    int fd, result;
+
+    t = time(NULL);
+    gmtime_r(&t, &tm);
+    snprintf(fn, size, "%s/trace-%04d%02d%02d-%02d%02d%02d.bin", g_arim_path,
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    fd = open(fn, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd == -1)
+        return 0;
+    result = trace_dump_fd(fd);
+    close(fd);
+    return result;
+}
+
+void trace_on_crash(int sig)
+{
+    int fd;
+
+    fd = open(trace_crash_fn, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd != -1) {
+        trace_dump_fd(fd);
+        close(fd);
+    }
+    /* handler was installed with SA_RESETHAND, so this gets default action */
+    raise(sig);
+}
+
+void trace_init()
+{
+    struct sigaction action;
+
+    snprintf(trace_crash_fn, sizeof(trace_crash_fn), "%s/trace-crash.bin", g_arim_path);
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = trace_on_crash;
+    action.sa_flags = SA_RESETHAND;
+    sigaction(SIGSEGV, &action, NULL);
+    sigaction(SIGBUS, &action, NULL);
+    sigaction(SIGFPE, &action, NULL);
+    sigaction(SIGILL, &action, NULL);
+    sigaction(SIGABRT, &action, NULL);
+}
+
@@ -0,0 +1,75 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _TRACE_H_INCLUDED_
+#define _TRACE_H_INCLUDED_
+
+#include <stdint.h>
+
+#define TRACE_MAGIC             "ARIMTRC1"
+#define TRACE_MAGIC_SIZE        8
+#define TRACE_MAX_THREADS       16
+#define TRACE_RING_SIZE         1024    /* records per thread, power of 2 */
+#define TRACE_NUM_ARGS          4
+
+/* trace record types */
+#define TRACE_EVENT             0   /* protocol event, id from events[] */
+#define TRACE_DATA_TX           1   /* frame started on TNC data port */
+#define TRACE_DATA_TX_WAIT      2   /* data port full, frame write deferred */
+#define TRACE_DATA_RX           3   /* frame received on TNC data port */
+#define TRACE_TNC_BUFFER        4   /* TNC reported BUFFER count */
+
+typedef struct trace_rec {
+    uint64_t usec;              /* wall clock time, usec since the epoch */
+    uint16_t type;
+    uint16_t id;
+    uint16_t state;             /* protocol state from states[] */
+    uint16_t spare;
+    int32_t arg[TRACE_NUM_ARGS];
+} TRACEREC;
+
+/*  Dump file layout, native byte order:
+        char magic[TRACE_MAGIC_SIZE]
+        TRACEHDR
+        num_events nul terminated event names, then num_states state names
+        for each thread: TRACETHR followed by its records, oldest first */
+typedef struct trace_hdr {
+    uint32_t num_events;
+    uint32_t num_states;
+    uint32_t num_threads;
+    uint32_t rec_size;
+} TRACEHDR;
+
+typedef struct trace_thr {
+    uint32_t tid;
+    uint32_t cnt;
+} TRACETHR;
+
+extern void trace_init(void);
+extern void trace_set_state(int state);
+extern void trace_event(int event, int param, int prev_state);
+extern void trace_record(int type, int arg0, int arg1, int arg2);
+extern int trace_dump(char *fn, size_t size);
+
+#endif
+
@@ -417,6 +417,17 @@ void ui_check_title_dirty()
     ui_set_title_dirty(0);
 }
 
+void ui_check_queue_drops()
+{
+    char status[MAX_STATUS_BAR_SIZE];
+
+    /* notify user and log when messages are lost to queue overflow */
+    if (bufq_check_drops(status, sizeof(status))) {
+        ui_print_status(status, 1);
+        bufq_queue_debug_log(status);
+    }
+}
+
 void ui_check_status_dirty()
 {
     char cmd;
@@ -424,6 +435,7 @@ void ui_check_status_dirty()
     ui_check_title_dirty();
     ui_check_prog_meter();
     ui_check_channel_busy();
+    ui_check_queue_drops();
     if (!status_dirty)
         return;
 
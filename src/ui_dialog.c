@@ -40,7 +40,7 @@
 #include "arim_proto.h"
 #include "auth.h"
 
-#define MAX_DIALOG_PROMPT_SIZE 512
+#define MAX_DIALOG_PROMPT_SIZE 1024
 
 WINDOW *dialog_win;
 
@@ -136,9 +136,7 @@ void ui_print_ftable()
         refresh_ftable = 1;
     }
 
-    pthread_mutex_lock(&mutex_ftable);
     p = cmdq_pop(&g_ftable_q);
-    pthread_mutex_unlock(&mutex_ftable);
 
     /*
       layout of record taken from queue:
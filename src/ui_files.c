@@ -55,6 +55,7 @@
 #include "auth.h"
 #include "bufq.h"
 #include "cmdproc.h"
+#include "zdict.h"
 
 #define MAX_CMD_HIST            10+1
 
@@ -414,7 +415,8 @@ int ui_get_file_list(const char *basedir, const char *dir,
                         }
                     }
                 }
-            } else if (strcmp(dent->d_name, "..") && strcmp(dent->d_name, ".")) {
+            } else if (strcmp(dent->d_name, "..") && strcmp(dent->d_name, ".") &&
+                       strcmp(dent->d_name, DEFAULT_ZCACHE_DIR)) {
                 if (ini_check_add_files_dir(fn)) {
                     numch = snprintf(linebuf, sizeof(linebuf), "%24s%8s\n", dent->d_name, "DIR");
                     if (numch >= sizeof(linebuf))
@@ -907,13 +909,12 @@ restart:
                     }
                     zoption = 0;
                     p = strtok(NULL, " >\t");
-                    if (p && !strcmp(p, "-z")) {
+                    if (p && zdict_parse_opt(p, &zoption)) {
                         if (!arim_is_arq_state()) {
                             ui_print_status("Send file: -z option not supported in FEC mode", 1);
                             break;
                         }
                         p = strtok(NULL, " >\t");
-                        zoption = 1;
                     }
                     if (!p || !(i = atoi(p))) {
                         ui_print_status("Send file: invalid file number", 1);
@@ -934,11 +935,11 @@ restart:
                                     p = path[i] + strlen(g_arim_settings.files_dir) + 1;
                                     snprintf(fn, sizeof(fn), "%s", p);
                                     if (destdir)
-                                        snprintf(msgbuffer, sizeof(msgbuffer), "%s %s > %s",
-                                                 zoption ? "/FPUT -z" : "/FPUT", fn, destdir);
+                                        snprintf(msgbuffer, sizeof(msgbuffer), "/FPUT%s %s > %s",
+                                                 zdict_opt_str(zoption), fn, destdir);
                                     else
-                                        snprintf(msgbuffer, sizeof(msgbuffer), "%s %s",
-                                                 zoption ? "/FPUT -z" : "/FPUT", fn);
+                                        snprintf(msgbuffer, sizeof(msgbuffer), "/FPUT%s %s",
+                                                 zdict_opt_str(zoption), fn);
                                     cmdproc_cmd(msgbuffer);
                                 } else {
                                     ui_print_status("Send file: cannot send, TNC busy", 1);
@@ -1347,9 +1348,8 @@ void ui_list_remote_files(const char *flist, const char *dir)
                 } else if (!strncasecmp(p, "cd", 2)) {
                     zoption = 0;
                     p = strtok(NULL, " \t");
-                    if (p && !strcmp(p, "-z")) {
+                    if (p && zdict_parse_opt(p, &zoption)) {
                         p = strtok(NULL, " >\t");
-                        zoption = 1;
                     }
                     if (!p || !(i = atoi(p))) {
                         ui_print_status("Change directory: invalid directory number", 1);
@@ -1360,7 +1360,7 @@ void ui_list_remote_files(const char *flist, const char *dir)
                         if (list[i][0] == 'D') {
                             /* directory, try to list it */
                             numch = snprintf(cmdbuffer, sizeof(cmdbuffer),
-                                             "%s %s", zoption ? "/FLGET -z" : "/FLGET", path[i]);
+                                             "/FLGET%s %s", zdict_opt_str(zoption), path[i]);
                             cmdproc_cmd(cmdbuffer);
                             /* close the file listing view, it will reopen when listing received */
                             quit = 1;
@@ -1375,9 +1375,8 @@ void ui_list_remote_files(const char *flist, const char *dir)
                 } else if (!strncasecmp(p, "gf", 2)) {
                     zoption = 0;
                     p = strtok(NULL, " >\t");
-                    if (p && !strcmp(p, "-z")) {
+                    if (p && zdict_parse_opt(p, &zoption)) {
                         p = strtok(NULL, " >\t");
-                        zoption = 1;
                     }
                     if (!p || !(i = atoi(p))) {
                         ui_print_status("Get file: invalid file number", 1);
@@ -1395,11 +1394,11 @@ void ui_list_remote_files(const char *flist, const char *dir)
                                 }
                                 /* initiate ARQ file downlaod */
                                 if (destdir)
-                                    numch = snprintf(cmdbuffer, sizeof(cmdbuffer), "%s %s > %s",
-                                                     zoption ? "/FGET -z" : "/FGET", path[i], destdir);
+                                    numch = snprintf(cmdbuffer, sizeof(cmdbuffer), "/FGET%s %s > %s",
+                                                     zdict_opt_str(zoption), path[i], destdir);
                                 else
-                                    numch = snprintf(cmdbuffer, sizeof(cmdbuffer), "%s %s",
-                                                     zoption ? "/FGET -z" : "/FGET", path[i]);
+                                    numch = snprintf(cmdbuffer, sizeof(cmdbuffer), "/FGET%s %s",
+                                                     zdict_opt_str(zoption), path[i]);
                                 cmdproc_cmd(cmdbuffer);
                             } else {
                                 ui_print_status("Get file: cannot download, TNC busy", 1);
@@ -156,7 +156,7 @@ void ui_update_heard_list()
     } else if (reformat) {
         for (i = 0; i < heard_list_cnt; i++) {
             pthread_mutex_lock(&mutex_time);
-            if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+            if (g_ui_utc_time)
                 heard_time = gmtime(&heard_list[i].htime);
             else
                 heard_time = localtime(&heard_list[i].htime);
@@ -234,9 +234,7 @@ void ui_print_heard_list()
         memset(&heard_list, 0, sizeof(heard_list));
     }
 
-    pthread_mutex_lock(&mutex_heard);
     p = cmdq_pop(&g_heard_q);
-    pthread_mutex_unlock(&mutex_heard);
 
     if (p) {
         memmove(&heard_list[1], &heard_list[0], MAX_HEARD_LIST_LEN * sizeof(HL_ENTRY));
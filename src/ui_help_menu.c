@@ -93,6 +93,10 @@ const char *help[] = {
     "    ARQ connection requests or pings from another station,",
     "    where v is 'true' or 'false' (not case sensitive).",
     "  'tncset' to show TNC settings in a pop-up window.",
+    "  'qstat' to show message queue depths, memory use and",
+    "    overflow counts in a pop-up window.",
+    "  'trace' to dump the binary event trace to a file in the",
+    "    ARIM directory, decode it with 'arim-trace FILE'.",
     "",
     "When attached to TNC, direct special commands as follows:",
     "  Prefix commands to ARDOP TNC with '!', e.g. '!SENDID'.",
@@ -189,7 +193,7 @@ const char *help[] = {
     "      '/netcalls' returns the ARIM netcall list.",
     "      '/flist [dir]' where dir is an optional directory path,"
     "        returns a listing of files at the remote station.",
-    "      '/flget [-z] [dir]', where -z is compression option and dir",
+    "      '/flget [-z|-zd] [dir]', where -z is compression option and dir",
     "        is an optional directory path on the remote station.",
     "        Downloads a directory listing and displays it in the remote",
     "        shared files viewer for easy file reading and downloading.",
@@ -199,14 +203,21 @@ const char *help[] = {
     "        folder on the remote station, or a file path relative to",
     "        that folder; prints the file to the traffic monitor view.",
     "        Works only for text file types.",
-    "      '/fget [-z] fn [> dir]', where -z is compression option, fn a",
+    "      '/fget [-z|-zd] fn [> dir]', where -z is compression option, fn a",
     "        file in the shared files folder on the remote station or a",
     "        file path relative to that folder; downloads the file to",
     "        the local station. If dir is specified then the file is",
     "        placed in that folder at the local station; if not then it",
     "        is placed in the default 'download' folder. Works for both",
     "        text and binary file types.",
-    "      '/fput [-z] fn [> dir]', where -z is compression option, fn",
+    "      '/mfget [-z|-zd] pat [> dir]', where -z is compression option",
+    "        and pat a file name pattern like '*.txt' or 'dir/*.txt' in",
+    "        the shared files folder on the remote station; downloads",
+    "        all matching files in one transfer, packed together and",
+    "        compressed as one. Files are placed as for '/fget'. Total",
+    "        size is limited as for a single file; files that don't",
+    "        fit are skipped.",
+    "      '/fput [-z|-zd] fn [> dir]', where -z is compression option, fn",
     "        is a file in the shared files folder on the local station,",
     "        or a file path relative to that folder, and dir is optional",
     "        destination directory specification; uploads the file to",
@@ -214,7 +225,7 @@ const char *help[] = {
     "        placed in that folder at the remote station; if not then it",
     "        is placed in the default 'download' folder. Works for both",
     "        text and binary file types.",
-    "      '/sm [-z][msg]', where -z is compression option and msg is",
+    "      '/sm [-z|-zd][msg]', where -z is compression option and msg is",
     "        optional message text entered on the command line. Sends",
     "        a message to the remote station's inbox. If msg not given",
     "        on the command line, then enter message text line-by-line",
@@ -223,7 +234,7 @@ const char *help[] = {
     "      '/mlist' returns a list of messages in the remote station's",
     "        outbox that are addressed to your station's call sign.",
     "        Requires authentication.",
-    "      '/mget [-z][n]', where -z is compression option and n is",
+    "      '/mget [-z|-zd][n]', where -z is compression option and n is",
     "        max messages option; downloads up to n messages addressed",
     "        to your station from the remote station's outbox to your",
     "        inbox. Default value of n is 10. Messages are deleted",
@@ -231,6 +242,10 @@ const char *help[] = {
     "      '/auth' triggers the mutual authentication process.",
     "    When entering the command, the '/' character must be the",
     "    first one on the line or the command won't be recognized.",
+    "    The -zd option compresses using the preset dictionary in",
+    "    the 'arim-zdict' file, which both stations must share.",
+    "    A streamed /fget or /fput interrupted by loss of the ARQ",
+    "    connection resumes where it left off when repeated later.",
     "  Press CTRL-X to disconnect, or type the special command '/dis'",
     "    at the command prompt and press ENTER.",
     "",
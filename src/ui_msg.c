@@ -44,6 +44,7 @@
 #include "ui_cmd_prompt_win.h"
 #include "bufq.h"
 #include "mbox.h"
+#include "zdict.h"
 
 #define MAX_CMD_HIST            10+1
 
@@ -643,21 +644,62 @@ int ui_list_get_line(char *cmd_line, size_t max_len)
     return (len != 0);
 }
 
+int ui_list_msg_fill(char list[][MAX_MBOX_HDR_SIZE], int rows, const char *fn, int top)
+{
+    int i;
+
+    /* fetch headers for the visible rows only, newest message first */
+    for (i = 0; i < rows && top - i >= 0; i++) {
+        if (!mbox_get_header(list[i], MAX_MBOX_HDR_SIZE, fn, top - i))
+            break;
+    }
+    return i;
+}
+
+void ui_list_msg_draw(WINDOW *win, char list[][MAX_MBOX_HDR_SIZE], int rows, int top, int max_cols)
+{
+    char linebuf[MAX_MBOX_HDR_SIZE+1];
+    int i;
+
+    wclear(win);
+    for (i = 0; i < rows; i++) {
+        snprintf(linebuf, max_cols, "[%3d] %s", top - i + 1, list[i]);
+        mvwprintw(win, i, 1, linebuf);
+    }
+    wrefresh(win);
+}
+
+int ui_list_msg_hdr(char *hdr, size_t size, char list[][MAX_MBOX_HDR_SIZE],
+                        int rows, const char *fn, int top, int msgnbr)
+{
+    /* use the header on screen if the message is visible, so the
+       number typed refers to the message the operator is looking at */
+    if (top - msgnbr >= 0 && top - msgnbr < rows) {
+        snprintf(hdr, size, "%s", list[top - msgnbr]);
+        return 1;
+    }
+    return mbox_get_header(hdr, size, fn, msgnbr);
+}
+
+int ui_list_msg_update(char list[][MAX_MBOX_HDR_SIZE], int rows,
+                           const char *fn, int top, int msgnbr)
+{
+    /* re-read only the row whose status flags changed */
+    msg_view_restart = 0;
+    if (top - msgnbr < 0 || top - msgnbr >= rows)
+        return 0;
+    return mbox_get_header(list[top - msgnbr], MAX_MBOX_HDR_SIZE, fn, msgnbr);
+}
+
 void ui_list_msg(const char *fn, int mbox_type)
 {
     WINDOW *mbox_win;
-    FILE *mboxfp;
     char *p, linebuf[MAX_MBOX_HDR_SIZE+1], msgbuffer[MAX_UNCOMP_DATA_SIZE];
-    static char list[MAX_MBOX_LIST_LEN+1][MAX_MBOX_HDR_SIZE];
+    static char list[MAX_MBOX_LIST_LEN][MAX_MBOX_HDR_SIZE];
+    char hdr[MAX_MBOX_HDR_SIZE];
     char to_call[MAX_CALLSIGN_SIZE];
-    char fpath[MAX_PATH_SIZE];
-    static int once = 0;
-    int i, temp, max_cols, max_mbox_rows, cmd, cur, top, start, quit = 0;
+    int i, temp, max_cols, max_mbox_rows, cmd, rows, top, start, quit = 0;
 
-    if (!once) {
-        once = 1;
-        memset(&list, 0, sizeof(list));
-    }
     mbox_win = newwin(tnc_data_box_h - 2, tnc_data_box_w - 2,
                                  tnc_data_box_y + 1, tnc_data_box_x + 1);
     max_mbox_rows = tnc_data_box_h - 2;
@@ -669,56 +711,28 @@ void ui_list_msg(const char *fn, int mbox_type)
         wbkgd(mbox_win, COLOR_PAIR(7));
     ui_set_active_win(mbox_win);
     max_mbox_rows = tnc_data_box_h - 2;
-    mbox_purge(fn, atoi(g_arim_settings.max_msg_days));
+    if (max_mbox_rows > MAX_MBOX_LIST_LEN)
+        max_mbox_rows = MAX_MBOX_LIST_LEN;
+    max_cols = (tnc_data_box_w - 4) + 1;
+    if (max_cols > sizeof(linebuf))
+        max_cols = sizeof(linebuf);
 
 restart:
     msg_view_restart = 0;
-    wclear(mbox_win);
-    start = 0;
-    snprintf(fpath, sizeof(fpath), "%s/%s", mbox_dir_path, fn);
-    mboxfp = fopen(fpath, "r");
-    if (!mboxfp) {
+    /* only the headers in view are held in memory, they're paged
+       in from the mailbox index as the list is scrolled */
+    start = mbox_get_msg_cnt(fn) - 1;
+    if (start < -1) {
         ui_print_status("List: failed to open mailbox file", 1);
         ui_set_active_win(tnc_data_box);
+        delwin(mbox_win);
         return;
     }
-    flockfile(mboxfp);
-    p = fgets(linebuf, sizeof(linebuf), mboxfp);
-    while (p) {
-        while (p && strncmp(p, "From ", 5))
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-        if (p) {
-            snprintf(list[start], sizeof(list[0]), "%s", p);
-            p = list[start];
-            while (*p && *p != '\n')
-                ++p;
-            *p = '\0';
-            ++start;
-            if (start == MAX_MBOX_LIST_LEN) {
-                cmd = ui_show_dialog("\tToo many messages to list;\n"
-                                     "\tnewer messages can't be shown.\n"
-                                     "\tKill older messages to\n"
-                                     "\tmake room for new.\n \n\t[O]k", "oO \n");
-                break;
-            }
-            p = fgets(linebuf, sizeof(linebuf), mboxfp);
-        }
-    }
-    funlockfile(mboxfp);
-    fclose(mboxfp);
-    --start;
-    max_cols = (tnc_data_box_w - 4) + 1;
-    if (max_cols > sizeof(linebuf))
-        max_cols = sizeof(linebuf);
-    cur = top = start;
-    for (i = 0; i < max_mbox_rows && cur >= 0; i++) {
-        snprintf(linebuf, max_cols, "[%3d] %s", cur + 1, list[cur]);
-        mvwprintw(mbox_win, i, 1, linebuf);
-        --cur;
-    }
+    top = start;
+    rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+    ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
     if (show_titles)
         ui_print_msg_list_title(mbox_type);
-    wrefresh(mbox_win);
     status_timer = 1;
     while (!quit) {
         if (status_timer && --status_timer == 0) {
@@ -765,9 +779,11 @@ restart:
                         break;
                     }
                     --i;
-                    if (i >= 0 && i <= start) {
-                        if (ui_read_msg(fn, list[i], i + 1, 0)) {
-                            ui_set_recent_flag(list[i], 'R');
+                    if (i >= 0 && i <= start &&
+                        ui_list_msg_hdr(hdr, sizeof(hdr), list, rows, fn, top, i)) {
+                        if (ui_read_msg(fn, hdr, i + 1, 0)) {
+                            ui_set_recent_flag(hdr, 'R');
+                            ui_list_msg_update(list, rows, fn, top, i);
                         } else {
                             ui_print_status("Read message: cannot read message", 1);
                         }
@@ -776,7 +792,7 @@ restart:
                     }
                     if (show_recents)
                         ui_refresh_recents();
-                    goto restart;
+                    ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
                 } else if (!strncasecmp(p, "rr", 2) && show_recents) {
                     p = strtok(NULL, " \t");
                     if (!p || (i = atoi(p)) < 1) {
@@ -790,7 +806,8 @@ restart:
                     } else {
                         ui_print_status("Read recent: cannot read message", 1);
                     }
-                    goto restart;
+                    rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+                    ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
                 } else if (!strncasecmp(p, "pm", 2)) {
                     p = strtok(NULL, " \t");
                     if (!p || !(i = atoi(p))) {
@@ -815,8 +832,9 @@ restart:
                         break;
                     }
                     --i;
-                    if (i >= 0 && i <= start) {
-                        if (mbox_delete_msg(fn, list[i]))
+                    if (i >= 0 && i <= start &&
+                        ui_list_msg_hdr(hdr, sizeof(hdr), list, rows, fn, top, i)) {
+                        if (mbox_delete_msg(fn, hdr))
                             goto restart;
                         else
                             ui_print_status("Kill message: cannot kill message", 1);
@@ -830,14 +848,16 @@ restart:
                         break;
                     }
                     --i;
-                    if (i >= 0 && i <= start) {
+                    if (i >= 0 && i <= start &&
+                        ui_list_msg_hdr(hdr, sizeof(hdr), list, rows, fn, top, i)) {
                         p = strtok(NULL, " \t");
                         if (!p)
                             break;
-                        if (mbox_save_msg(fn, list[i], p)) {
-                            ui_set_recent_flag(list[i], 'S');
+                        if (mbox_save_msg(fn, hdr, p)) {
+                            ui_set_recent_flag(hdr, 'S');
                             ui_print_status("Save message: message saved to file", 1);
-                            goto restart;
+                            ui_list_msg_update(list, rows, fn, top, i);
+                            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
                         } else {
                             ui_print_status("Save message: cannot save message", 1);
                         }
@@ -851,21 +871,21 @@ restart:
                     }
                     zoption = 0;
                     p = strtok(NULL, " \t");
-                    if (p && !strcmp(p, "-z")) {
+                    if (p && zdict_parse_opt(p, &zoption)) {
                         if (!arim_is_arq_state()) {
                             ui_print_status("Send message: -z option not supported in FEC mode", 1);
                             break;
                         }
                         p = strtok(NULL, " \t");
-                        zoption = 1;
                     }
                     if (!p || !(i = atoi(p))) {
                         ui_print_status("Send message: invalid message number", 1);
                         break;
                     }
                     --i;
-                    if (i >= 0 && i <= start) {
-                        if (ui_send_msg(msgbuffer, sizeof(msgbuffer), fn, list[i])) {
+                    if (i >= 0 && i <= start &&
+                        ui_list_msg_hdr(hdr, sizeof(hdr), list, rows, fn, top, i)) {
+                        if (ui_send_msg(msgbuffer, sizeof(msgbuffer), fn, hdr)) {
                             wclear(mbox_win);
                             ui_print_status("ARIM Busy: sending message", 1);
                             goto restart;
@@ -882,20 +902,20 @@ restart:
                     }
                     zoption = 0;
                     p = strtok(NULL, " \t");
-                    if (p && !strcmp(p, "-z")) {
+                    if (p && zdict_parse_opt(p, &zoption)) {
                         if (!arim_is_arq_state()) {
                             ui_print_status("Fwd message: -z option not supported in FEC mode", 1);
                             break;
                         }
                         p = strtok(NULL, " \t");
-                        zoption = 1;
                     }
                     if (!p || !(i = atoi(p))) {
                         ui_print_status("Fwd message: invalid message number", 1);
                         break;
                     }
                     --i;
-                    if (i >= 0 && i <= start) {
+                    if (i >= 0 && i <= start &&
+                        ui_list_msg_hdr(hdr, sizeof(hdr), list, rows, fn, top, i)) {
                         p = strtok(NULL, " \t");
                         if (arim_is_arq_state()) {
                             arim_copy_remote_call(to_call, sizeof(to_call));
@@ -906,11 +926,11 @@ restart:
                             }
                             snprintf(to_call, sizeof(to_call), "%s", p);
                         }
-                        if (ui_forward_msg(msgbuffer, sizeof(msgbuffer), fn, list[i], to_call)) {
-                            wclear(mbox_win);
-                            ui_set_recent_flag(list[i], 'F');
+                        if (ui_forward_msg(msgbuffer, sizeof(msgbuffer), fn, hdr, to_call)) {
+                            ui_set_recent_flag(hdr, 'F');
                             ui_print_status("ARIM Busy: forwarding message", 1);
-                            goto restart;
+                            ui_list_msg_update(list, rows, fn, top, i);
+                            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
                         } else {
                             ui_print_status("Fwd message: cannot forward, TNC busy", 1);
                         }
@@ -924,15 +944,16 @@ restart:
                         break;
                     }
                     --i;
-                    if (i >= 0 && i <= start) {
+                    if (i >= 0 && i <= start &&
+                        ui_list_msg_hdr(hdr, sizeof(hdr), list, rows, fn, top, i)) {
                         p = strtok(NULL, " \t");
                         if (!p) {
                             ui_print_status("Clear flag: cannot clear, no flag given", 1);
                             break;
                         }
-                        if (mbox_clear_flag(fn, list[i], *p)) {
-                            wclear(mbox_win);
-                            goto restart;
+                        if (mbox_clear_flag(fn, hdr, *p)) {
+                            ui_list_msg_update(list, rows, fn, top, i);
+                            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
                         }
                     } else {
                         ui_print_status("Clear flag: invalid msg number", 1);
@@ -1041,81 +1062,45 @@ restart:
             break;
         case KEY_HOME:
             top = start;
-            cur = top;
-            wclear(mbox_win);
-            for (i = 0; i < max_mbox_rows && cur >= 0; i++) {
-                snprintf(linebuf, max_cols, "[%3d] %s", cur + 1, list[cur]);
-                mvwprintw(mbox_win, i, 1, linebuf);
-                --cur;
-            }
-            wrefresh(mbox_win);
+            rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
             break;
         case KEY_END:
             if (start < max_mbox_rows - 1)
                 break;
             top = max_mbox_rows - 1;
-            cur = top;
-            wclear(mbox_win);
-            for (i = 0; i < max_mbox_rows && cur >= 0; i++) {
-                snprintf(linebuf, max_cols, "[%3d] %s", cur + 1, list[cur]);
-                mvwprintw(mbox_win, i, 1, linebuf);
-                --cur;
-            }
-            wrefresh(mbox_win);
+            rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
             break;
         case KEY_NPAGE:
             top -= max_mbox_rows;
             if (top < 0)
                 top = 0;
-            cur = top;
-            wclear(mbox_win);
-            for (i = 0; i < max_mbox_rows && cur >= 0; i++) {
-                snprintf(linebuf, max_cols, "[%3d] %s", cur + 1, list[cur]);
-                mvwprintw(mbox_win, i, 1, linebuf);
-                --cur;
-            }
-            wrefresh(mbox_win);
+            rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
             break;
         case '-':
         case KEY_PPAGE:
             top += max_mbox_rows;
             if (top > start)
                 top = start;
-            cur = top;
-            wclear(mbox_win);
-            for (i = 0; i < max_mbox_rows && cur >= 0; i++) {
-                snprintf(linebuf, max_cols, "[%3d] %s", cur + 1, list[cur]);
-                mvwprintw(mbox_win, i, 1, linebuf);
-                --cur;
-            }
-            wrefresh(mbox_win);
+            rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
             break;
         case KEY_UP:
             top += 1;
             if (top > start)
                 top = start;
-            cur = top;
-            wclear(mbox_win);
-            for (i = 0; i < max_mbox_rows && cur >= 0; i++) {
-                snprintf(linebuf, max_cols, "[%3d] %s", cur + 1, list[cur]);
-                mvwprintw(mbox_win, i, 1, linebuf);
-                --cur;
-            }
-            wrefresh(mbox_win);
+            rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
             break;
         case '\n':
         case KEY_DOWN:
             top -= 1;
             if (top < 0)
                 top = 0;
-            cur = top;
-            wclear(mbox_win);
-            for (i = 0; i < max_mbox_rows && cur >= 0; i++) {
-                snprintf(linebuf, max_cols, "[%3d] %s", cur + 1, list[cur]);
-                mvwprintw(mbox_win, i, 1, linebuf);
-                --cur;
-            }
-            wrefresh(mbox_win);
+            rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
             break;
         case 'n':
         case 'N':
@@ -1145,8 +1130,15 @@ restart:
             ui_check_status_dirty();
             break;
         }
-        if (msg_view_restart)
-            goto restart;
+        if (msg_view_restart) {
+            /* flags changed elsewhere, re-read the rows in view */
+            msg_view_restart = 0;
+            start = mbox_get_msg_cnt(fn) - 1;
+            if (top > start)
+                top = start;
+            rows = ui_list_msg_fill(list, max_mbox_rows, fn, top);
+            ui_list_msg_draw(mbox_win, list, rows, top, max_cols);
+        }
         if (g_win_changed)
             quit = 1;
         usleep(100000);
@@ -142,9 +142,7 @@ void ui_print_ptable()
         refresh_ptable = 1;
     }
 
-    pthread_mutex_lock(&mutex_ptable);
     p = cmdq_pop(&g_ptable_q);
-    pthread_mutex_unlock(&mutex_ptable);
 
     /*
       layout of record taken from queue:
@@ -224,7 +222,7 @@ void ui_print_ptable()
             if (ptable_list[i].in_time) {
                 if (last_time_heard == LT_HEARD_CLOCK) {
                     pthread_mutex_lock(&mutex_time);
-                    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+                    if (g_ui_utc_time)
                         ping_time = gmtime(&ptable_list[i].in_time);
                     else
                         ping_time = localtime(&ptable_list[i].in_time);
@@ -250,7 +248,7 @@ void ui_print_ptable()
             if (ptable_list[i].out_time) {
                 if (last_time_heard == LT_HEARD_CLOCK) {
                     pthread_mutex_lock(&mutex_time);
-                    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+                    if (g_ui_utc_time)
                         ping_time = gmtime(&ptable_list[i].out_time);
                     else
                         ping_time = localtime(&ptable_list[i].out_time);
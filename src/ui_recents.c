@@ -122,9 +122,7 @@ void ui_print_recents()
         refresh_recents = 1;
     }
 
-    pthread_mutex_lock(&mutex_recents);
     p = cmdq_pop(&g_recents_q);
-    pthread_mutex_unlock(&mutex_recents);
 
     if (p) {
         snprintf(recent, sizeof(recent), "%s", p);
@@ -83,7 +83,6 @@ void ui_print_cmd_in()
 
     if (!show_cmds)
         return;
-    pthread_mutex_lock(&mutex_cmd_in);
     p = cmdq_pop(&g_cmd_in_q);
     while (p) {
         if (cur_cmd_row == max_cmd_rows) {
@@ -122,7 +121,6 @@ void ui_print_cmd_in()
             cur_cmd_row++;
         p = cmdq_pop(&g_cmd_in_q);
     }
-    pthread_mutex_unlock(&mutex_cmd_in);
     if (!show_recents && !show_ptable && !show_ctable && !show_ftable) {
         touchwin(tnc_cmd_box);
         wrefresh(tnc_cmd_box);
@@ -40,16 +40,21 @@ const char *months[] = {
 };
 
 unsigned int ccitt_crc16(const unsigned char *data, size_t size)
+{
+    if (size < 1)
+        return ~CCITT_CRC16_INIT;
+    return ccitt_crc16_final(ccitt_crc16_update(CCITT_CRC16_INIT, data, size));
+}
+
+unsigned int ccitt_crc16_update(unsigned int cs, const unsigned char *data, size_t size)
 {
     size_t i, cnt;
-    unsigned int work, cs;
+    unsigned int work;
 
-    cs = 0xFFFF;
-    if (size < 1)
-        return ~cs;
-    cnt = 0;
-    do {
-        work = 0x00FF & data[cnt++];
+    /* running checksum for data that arrives in pieces, start
+       with CCITT_CRC16_INIT and finish with ccitt_crc16_final() */
+    for (cnt = 0; cnt < size; cnt++) {
+        work = 0x00FF & data[cnt];
         for (i = 0; i < 8; i++) {
             if ((cs & 0x0001) ^ (work & 0x0001))
                 cs = (cs >> 1) ^ 0x8408;
@@ -57,44 +62,71 @@ unsigned int ccitt_crc16(const unsigned char *data, size_t size)
                 cs >>= 1;
             work >>= 1;
         }
-    } while (cnt < size);
+    }
+    return cs;
+}
+
+unsigned int ccitt_crc16_final(unsigned int cs)
+{
+    unsigned int work;
+
     cs = ~cs;
     work = cs;
     cs = (cs << 8) | (work >> 8 & 0x00FF);
     return cs & 0xFFFF;
 }
 
-char *util_timestamp(char *buffer, size_t maxsize)
+/*  The HH:MM:SS part of a timestamp changes only once per second, so it's
+    cached per thread and reformatted only when the second rolls over. This
+    keeps util_timestamp_usec() off mutex_time in the logging hot path. */
+static _Thread_local time_t ts_cache_sec = -1;
+static _Thread_local char ts_cache[MAX_TIMESTAMP_SIZE];
+
+const char *util_timestamp_prefix(time_t t)
 {
-    time_t t;
-    struct tm *cur_time;
+    struct tm cur_time;
+
+    if (t != ts_cache_sec) {
+        if (g_ui_utc_time)
+            gmtime_r(&t, &cur_time);
+        else
+            localtime_r(&t, &cur_time);
+        snprintf(ts_cache, sizeof(ts_cache), "%02d:%02d:%02d",
+                    cur_time.tm_hour, cur_time.tm_min, cur_time.tm_sec);
+        ts_cache_sec = t;
+    }
+    return ts_cache;
+}
 
-    pthread_mutex_lock(&mutex_time);
-    t = time(NULL);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
-        cur_time = gmtime(&t);
-    else
-        cur_time = localtime(&t);
-    snprintf(buffer, maxsize, "%02d:%02d:%02d",
-                cur_time->tm_hour, cur_time->tm_min, cur_time->tm_sec);
-    pthread_mutex_unlock(&mutex_time);
+char *util_timestamp(char *buffer, size_t maxsize)
+{
+    snprintf(buffer, maxsize, "%s", util_timestamp_prefix(time(NULL)));
     return buffer;
 }
 
 char *util_timestamp_usec(char *buffer, size_t maxsize)
 {
     struct timeval tv;
-    struct tm *cur_time;
-
-    pthread_mutex_lock(&mutex_time);
+    const char *prefix;
+    long usec;
+    int i;
+
+    if (maxsize < 16) {
+        if (maxsize)
+            buffer[0] = '\0';
+        return buffer;
+    }
     gettimeofday(&tv, NULL);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
-        cur_time = gmtime(&tv.tv_sec);
-    else
-        cur_time = localtime(&tv.tv_sec);
-    snprintf(buffer, maxsize, "%02d:%02d:%02d.%06ld",
-                cur_time->tm_hour, cur_time->tm_min, cur_time->tm_sec, tv.tv_usec);
-    pthread_mutex_unlock(&mutex_time);
+    prefix = util_timestamp_prefix(tv.tv_sec);
+    memcpy(buffer, prefix, 8);
+    buffer[8] = '.';
+    /* append microseconds without going through printf */
+    usec = tv.tv_usec;
+    for (i = 14; i > 8; i--) {
+        buffer[i] = '0' + (usec % 10);
+        usec /= 10;
+    }
+    buffer[15] = '\0';
     return buffer;
 }
 
@@ -105,7 +137,7 @@ char *util_datestamp(char *buffer, size_t maxsize)
 
     pthread_mutex_lock(&mutex_time);
     t = time(NULL);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+    if (g_ui_utc_time)
         cur_time = gmtime(&t);
     else
         cur_time = localtime(&t);
@@ -122,7 +154,7 @@ char *util_date_timestamp(char *buffer, size_t maxsize)
 
     pthread_mutex_lock(&mutex_time);
     t = time(NULL);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+    if (g_ui_utc_time)
         cur_time = gmtime(&t);
     else
         cur_time = localtime(&t);
@@ -141,7 +173,7 @@ char *util_rcv_timestamp(char *buffer, size_t maxsize)
 
     pthread_mutex_lock(&mutex_time);
     t = time(NULL);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4)) {
+    if (g_ui_utc_time) {
         cur_time = gmtime(&t);
         snprintf(buffer, maxsize, "%s %2d 2%03d %02d:%02d:%02d UTC",
                     months[cur_time->tm_mon], cur_time->tm_mday, cur_time->tm_year - 100,
@@ -161,7 +193,7 @@ char *util_file_timestamp(time_t t, char *buffer, size_t maxsize)
     struct tm *cur_time;
 
     pthread_mutex_lock(&mutex_time);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+    if (g_ui_utc_time)
         cur_time = gmtime(&t);
     else
         cur_time = localtime(&t);
@@ -179,7 +211,7 @@ char *util_clock(char *buffer, size_t maxsize)
 
     pthread_mutex_lock(&mutex_time);
     t = time(NULL);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+    if (g_ui_utc_time)
         cur_time = gmtime(&t);
     else
         cur_time = localtime(&t);
@@ -194,7 +226,7 @@ char *util_clock_tm(time_t t, char *buffer, size_t maxsize)
     struct tm *cur_time;
 
     pthread_mutex_lock(&mutex_time);
-    if (!strncasecmp(g_ui_settings.utc_time, "TRUE", 4))
+    if (g_ui_utc_time)
         cur_time = gmtime(&t);
     else
         cur_time = localtime(&t);
@@ -25,9 +25,11 @@
 #define _UTIL_H_INCLUDED_
 
 #define MAX_TIMESTAMP_SIZE   32
+#define CCITT_CRC16_INIT     0xFFFF
 
 extern char *util_timestamp(char *buffer, size_t maxsize);
 extern char *util_timestamp_usec(char *buffer, size_t maxsize);
+extern const char *util_timestamp_prefix(time_t t);
 extern char *util_datestamp(char *buffer, size_t maxsize);
 extern char *util_date_timestamp(char *buffer, size_t maxsize);
 extern char *util_file_timestamp(time_t t, char *buffer, size_t maxsize);
@@ -35,6 +37,8 @@ extern char *util_rcv_timestamp(char *buffer, size_t maxsize);
 extern char *util_clock(char *buffer, size_t maxsize);
 extern char *util_clock_tm(time_t t, char *buffer, size_t maxsize);
 extern unsigned int ccitt_crc16(const unsigned char *data, size_t size);
+extern unsigned int ccitt_crc16_update(unsigned int cs, const unsigned char *data, size_t size);
+extern unsigned int ccitt_crc16_final(unsigned int cs);
 
 #endif
 
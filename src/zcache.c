@@ -0,0 +1,326 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "ini.h"
+#include "bufq.h"
+#include "ui.h"
+#include "zdict.h"
+#include "zcache.h"
+
+/*  Cache of compressed shared files for repeat '-z' and '-zd' downloads.
+    Popular files like bulletins are fetched by many stations, and each
+    request would otherwise re-read and deflate the file at best
+    compression. Entries are keyed by file path and compression option
+    and are valid only while the file's inode, mtime (to the nanosecond)
+    and size are unchanged.
+    They are kept most recently used first and dropped from the tail
+    when the zcache-size budget is exceeded. With zcache-persist set,
+    entries are also written to the .zcache folder under files-dir and
+    reloaded from there on a memory miss, so they survive a restart. */
+
+#define ZCACHE_FILE_MAGIC   "ZCACHE2"
+
+typedef struct zcache_ent {
+    struct zcache_ent *prev, *next;
+    char path[MAX_PATH_SIZE];
+    struct timespec mtime;
+    ino_t ino;
+    off_t fsize;
+    int zoption;
+    unsigned long dict_id;
+    unsigned int check;
+    size_t len;
+    unsigned char data[];
+} ZCACHEENT;
+
+static ZCACHEENT *zcache_head, *zcache_tail;
+static size_t zcache_bytes;
+static pthread_mutex_t mutex_zcache = PTHREAD_MUTEX_INITIALIZER;
+
+size_t zcache_budget()
+{
+    return (size_t)atoi(g_arim_settings.zcache_size) * 1024;
+}
+
+int zcache_is_persist()
+{
+    return !strncasecmp(g_arim_settings.zcache_persist, "TRUE", 4);
+}
+
+unsigned long zcache_dict_id(int zoption)
+{
+    /* '-zd' output depends on which dictionary was loaded */
+    return zoption == ZOPT_DICT ? zdict_get_id() : 0;
+}
+
+void zcache_unlink(ZCACHEENT *ent)
+{
+    if (ent->prev)
+        ent->prev->next = ent->next;
+    else
+        zcache_head = ent->next;
+    if (ent->next)
+        ent->next->prev = ent->prev;
+    else
+        zcache_tail = ent->prev;
+    zcache_bytes -= sizeof(ZCACHEENT) + ent->len;
+}
+
+void zcache_link_head(ZCACHEENT *ent)
+{
+    ent->prev = NULL;
+    ent->next = zcache_head;
+    if (zcache_head)
+        zcache_head->prev = ent;
+    else
+        zcache_tail = ent;
+    zcache_head = ent;
+    zcache_bytes += sizeof(ZCACHEENT) + ent->len;
+}
+
+void zcache_trim(size_t max)
+{
+    ZCACHEENT *ent;
+
+    while (zcache_tail && zcache_bytes > max) {
+        ent = zcache_tail;
+        zcache_unlink(ent);
+        free(ent);
+    }
+}
+
+ZCACHEENT *zcache_find(const char *fpath, int zoption)
+{
+    ZCACHEENT *ent;
+
+    for (ent = zcache_head; ent; ent = ent->next) {
+        if (ent->zoption == zoption && !strcmp(ent->path, fpath))
+            return ent;
+    }
+    return NULL;
+}
+
+int zcache_st_matches(ZCACHEENT *ent, const struct stat *st)
+{
+    /* a file rewritten within the same second at the same size still
+       differs in nanoseconds, or in inode if it was replaced by rename */
+    return ent->mtime.tv_sec == st->st_mtim.tv_sec &&
+           ent->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           ent->ino == st->st_ino && ent->fsize == st->st_size;
+}
+
+int zcache_ent_matches(ZCACHEENT *ent, const struct stat *st, int zoption)
+{
+    return zcache_st_matches(ent, st) && ent->dict_id == zcache_dict_id(zoption);
+}
+
+void zcache_file_path(const char *fpath, int zoption, char *path, size_t size)
+{
+    const unsigned char *p;
+    unsigned int h = 2166136261U;
+
+    /* FNV-1a hash of the source path names the cache file */
+    for (p = (const unsigned char *)fpath; *p; p++)
+        h = (h ^ *p) * 16777619U;
+    snprintf(path, size, "%s/%s/%08X.z%d",
+             g_arim_settings.files_dir, DEFAULT_ZCACHE_DIR, h, zoption);
+}
+
+ZCACHEENT *zcache_load(const char *fpath, const struct stat *st, int zoption)
+{
+    FILE *fp;
+    ZCACHEENT *ent;
+    char path[MAX_PATH_SIZE*2], linebuf[MAX_PATH_SIZE+64], *e;
+    long long mtime, mtime_ns, fsize;
+    unsigned long long ino;
+    unsigned long dict_id;
+    unsigned int check;
+    size_t len;
+    int zopt;
+
+    zcache_file_path(fpath, zoption, path, sizeof(path));
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return NULL;
+    /* header line, then source path line, then compressed data */
+    if (!fgets(linebuf, sizeof(linebuf), fp) ||
+        8 != sscanf(linebuf, ZCACHE_FILE_MAGIC " %lld %lld %llu %lld %lx %X %zu %d",
+                    &mtime, &mtime_ns, &ino, &fsize, &dict_id, &check, &len, &zopt) ||
+        zopt != zoption ||
+        mtime != st->st_mtim.tv_sec || mtime_ns != st->st_mtim.tv_nsec ||
+        ino != st->st_ino || fsize != st->st_size ||
+        dict_id != zcache_dict_id(zoption) || len > MAX_FILE_SIZE ||
+        !fgets(linebuf, sizeof(linebuf), fp)) {
+        fclose(fp);
+        return NULL;
+    }
+    e = strchr(linebuf, '\n');
+    if (e)
+        *e = '\0';
+    if (strcmp(linebuf, fpath)) {
+        /* hash collision with another file */
+        fclose(fp);
+        return NULL;
+    }
+    ent = malloc(sizeof(ZCACHEENT) + len);
+    if (ent == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+    if (fread(ent->data, 1, len, fp) != len) {
+        fclose(fp);
+        free(ent);
+        return NULL;
+    }
+    fclose(fp);
+    snprintf(ent->path, sizeof(ent->path), "%s", fpath);
+    ent->mtime = st->st_mtim;
+    ent->ino = st->st_ino;
+    ent->fsize = st->st_size;
+    ent->zoption = zoption;
+    ent->dict_id = dict_id;
+    ent->check = check;
+    ent->len = len;
+    return ent;
+}
+
+int zcache_save(ZCACHEENT *ent)
+{
+    FILE *fp;
+    char path[MAX_PATH_SIZE*2], tmp[MAX_PATH_SIZE*2+8];
+    int ok;
+
+    snprintf(path, sizeof(path), "%s/%s", g_arim_settings.files_dir, DEFAULT_ZCACHE_DIR);
+    if (mkdir(path, 0700) == -1 && errno != EEXIST)
+        return 0;
+    zcache_file_path(ent->path, ent->zoption, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fp = fopen(tmp, "w");
+    if (fp == NULL)
+        return 0;
+    fprintf(fp, ZCACHE_FILE_MAGIC " %lld %lld %llu %lld %lX %04X %zu %d\n%s\n",
+            (long long)ent->mtime.tv_sec, (long long)ent->mtime.tv_nsec,
+                (unsigned long long)ent->ino, (long long)ent->fsize, ent->dict_id,
+                    ent->check, ent->len, ent->zoption, ent->path);
+    ok = (fwrite(ent->data, 1, ent->len, fp) == ent->len);
+    if (fclose(fp) != 0)
+        ok = 0;
+    /* write then rename so a reader never sees a partial entry */
+    if (!ok || rename(tmp, path) == -1) {
+        unlink(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+int zcache_get(const char *fpath, const struct stat *st, int zoption,
+               unsigned char *data, size_t size, size_t *len, unsigned int *check)
+{
+    ZCACHEENT *ent;
+    char linebuf[MAX_LOG_LINE_SIZE];
+    size_t max;
+    int numch, result = 0;
+
+    max = zcache_budget();
+    pthread_mutex_lock(&mutex_zcache);
+    if (!max) {
+        zcache_trim(0);
+        pthread_mutex_unlock(&mutex_zcache);
+        return 0;
+    }
+    ent = zcache_find(fpath, zoption);
+    if (ent && !zcache_ent_matches(ent, st, zoption)) {
+        /* file changed since it was cached */
+        zcache_unlink(ent);
+        free(ent);
+        ent = NULL;
+    }
+    if (ent) {
+        zcache_unlink(ent);
+    } else if (zcache_is_persist()) {
+        ent = zcache_load(fpath, st, zoption);
+    }
+    if (ent) {
+        zcache_link_head(ent);
+        if (ent->len <= size) {
+            memcpy(data, ent->data, ent->len);
+            *len = ent->len;
+            *check = ent->check;
+            result = 1;
+        }
+        zcache_trim(max);
+    }
+    pthread_mutex_unlock(&mutex_zcache);
+    if (result) {
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ZCACHE: Using cached %s, %zu bytes", fpath, *len);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+    }
+    return result;
+}
+
+void zcache_put(const char *fpath, const struct stat *st, int zoption,
+                const unsigned char *data, size_t len, unsigned int check)
+{
+    ZCACHEENT *ent, *old;
+    size_t max;
+
+    max = zcache_budget();
+    if (!max || sizeof(ZCACHEENT) + len > max)
+        return;
+    ent = malloc(sizeof(ZCACHEENT) + len);
+    if (ent == NULL)
+        return;
+    snprintf(ent->path, sizeof(ent->path), "%s", fpath);
+    ent->mtime = st->st_mtim;
+    ent->ino = st->st_ino;
+    ent->fsize = st->st_size;
+    ent->zoption = zoption;
+    ent->dict_id = zcache_dict_id(zoption);
+    ent->check = check;
+    ent->len = len;
+    memcpy(ent->data, data, len);
+    if (zcache_is_persist())
+        zcache_save(ent);
+    pthread_mutex_lock(&mutex_zcache);
+    old = zcache_find(fpath, zoption);
+    if (old) {
+        zcache_unlink(old);
+        free(old);
+    }
+    zcache_link_head(ent);
+    zcache_trim(max);
+    pthread_mutex_unlock(&mutex_zcache);
+}
+
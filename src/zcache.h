@@ -0,0 +1,35 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _ZCACHE_H_INCLUDED_
+#define _ZCACHE_H_INCLUDED_
+
+#include <sys/stat.h>
+
+extern int zcache_get(const char *fpath, const struct stat *st, int zoption,
+                      unsigned char *data, size_t size, size_t *len, unsigned int *check);
+extern void zcache_put(const char *fpath, const struct stat *st, int zoption,
+                       const unsigned char *data, size_t len, unsigned int check);
+
+#endif
+
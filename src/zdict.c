@@ -0,0 +1,170 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "ini.h"
+#include "bufq.h"
+#include "ui.h"
+#include "zdict.h"
+
+/*  Optional preset dictionary for the '-zd' compression option. Short
+    messages give deflate too little history to find repeats in, so both
+    stations prime it with the same dictionary, built from mailbox traffic
+    by the arim-zdict tool and installed as the arim-zdict file. Its id is
+    the adler32 checksum zlib stores in the stream header, and is sent as
+    '-zd:XXXXXXXX' so the receiving station can fall back to plain '-z'
+    if it doesn't have the same dictionary. Loaded once at startup and
+    read-only after that. */
+
+static unsigned char zdict_buf[ZDICT_MAX_SIZE];
+static size_t zdict_size;
+static unsigned long zdict_id;
+static char zdict_opt[ZDICT_ID_SIZE+8];
+
+int zdict_init()
+{
+    FILE *fp;
+    struct stat st;
+    char fpath[MAX_PATH_SIZE*2], linebuf[MAX_LOG_LINE_SIZE];
+    int numch;
+
+    zdict_size = 0;
+    zdict_id = 0;
+    snprintf(fpath, sizeof(fpath), "%s/%s", g_arim_path, DEFAULT_ZDICT_FNAME);
+    if (stat(fpath, &st) == -1)
+        return 0; /* no dictionary, '-zd' falls back to '-z' */
+    if (st.st_size == 0 || st.st_size > ZDICT_MAX_SIZE) {
+        numch = snprintf(linebuf, sizeof(linebuf),
+                         "ZDICT: Ignoring %s, size must be 1 to %d bytes", fpath, ZDICT_MAX_SIZE);
+        if (numch >= sizeof(linebuf))
+            ui_truncate_line(linebuf, sizeof(linebuf));
+        bufq_queue_debug_log(linebuf);
+        return 0;
+    }
+    fp = fopen(fpath, "r");
+    if (fp == NULL)
+        return 0;
+    zdict_size = fread(zdict_buf, 1, st.st_size, fp);
+    fclose(fp);
+    if (zdict_size != st.st_size) {
+        zdict_size = 0;
+        return 0;
+    }
+    zdict_id = adler32(adler32(0L, Z_NULL, 0), zdict_buf, zdict_size);
+    snprintf(zdict_opt, sizeof(zdict_opt), " -zd:%08lX", zdict_id);
+    snprintf(linebuf, sizeof(linebuf),
+             "ZDICT: Loaded dictionary %08lX, %zu bytes", zdict_id, zdict_size);
+    bufq_queue_debug_log(linebuf);
+    return 1;
+}
+
+unsigned long zdict_get_id()
+{
+    return zdict_id;
+}
+
+size_t zdict_parse_opt(const char *s, int *zoption)
+{
+    char linebuf[MAX_LOG_LINE_SIZE];
+    unsigned long id;
+    size_t len;
+
+    /* parses '-z', '-zd' or '-zd:XXXXXXXX' at s, returns its length or
+       0 if there's no compression option there. A dictionary we don't
+       have is downgraded to plain '-z' */
+    len = strcspn(s, " \t\r\n");
+    if (len == 2 && !strncmp(s, "-z", 2)) {
+        *zoption = ZOPT_ZLIB;
+        return len;
+    }
+    if (len < 3 || strncmp(s, "-zd", 3) || (len > 3 && s[3] != ':'))
+        return 0;
+    *zoption = zdict_size ? ZOPT_DICT : ZOPT_ZLIB;
+    if (len > 3) {
+        if (1 != sscanf(s + 4, "%8lx", &id) || id != zdict_id)
+            *zoption = ZOPT_ZLIB;
+    }
+    if (*zoption != ZOPT_DICT) {
+        snprintf(linebuf, sizeof(linebuf),
+                 "ZDICT: Dictionary %.*s not available, using -z", (int)len, s);
+        bufq_queue_debug_log(linebuf);
+    }
+    return len;
+}
+
+const char *zdict_opt_str(int zoption)
+{
+    /* option as sent to the remote station, with leading space */
+    switch (zoption) {
+    case ZOPT_ZLIB:
+        return " -z";
+    case ZOPT_DICT:
+        return zdict_opt;
+    }
+    return "";
+}
+
+int zdict_deflate_init(z_stream *zs, int zoption)
+{
+    int zret;
+
+    zret = deflateInit(zs, Z_BEST_COMPRESSION);
+    if (zret == Z_OK && zoption == ZOPT_DICT && zdict_size) {
+        zret = deflateSetDictionary(zs, zdict_buf, zdict_size);
+        if (zret != Z_OK)
+            deflateEnd(zs);
+    }
+    return zret;
+}
+
+int zdict_inflate(z_stream *zs)
+{
+    return zdict_inflate_flush(zs, Z_FINISH);
+}
+
+int zdict_inflate_flush(z_stream *zs, int flush)
+{
+    char linebuf[MAX_LOG_LINE_SIZE];
+    int zret;
+
+    zret = inflate(zs, flush);
+    if (zret == Z_NEED_DICT) {
+        /* stream was primed with a dictionary, zs->adler has its id */
+        if (zdict_size && zs->adler == zdict_id &&
+            inflateSetDictionary(zs, zdict_buf, zdict_size) == Z_OK) {
+            zret = inflate(zs, flush);
+        } else {
+            snprintf(linebuf, sizeof(linebuf),
+                     "ZDICT: Dictionary %08lX not available", (unsigned long)zs->adler);
+            bufq_queue_debug_log(linebuf);
+            zret = Z_DATA_ERROR;
+        }
+    }
+    return zret;
+}
+
@@ -0,0 +1,46 @@
+/***********************************************************************
+
+    ARIM Amateur Radio Instant Messaging program for the ARDOP TNC.
+
+    Copyright (C) 2016-2021 Robert Cunnings NW8L
+
+    This file is part of the ARIM messaging program.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+#ifndef _ZDICT_H_INCLUDED_
+#define _ZDICT_H_INCLUDED_
+
+#include "zlib.h"
+
+#define ZDICT_MAX_SIZE          32768   /* deflate window size */
+#define ZDICT_ID_SIZE           8       /* hex digits of adler32 dictionary id */
+
+/* compression options, ZOPT_DICT is the '-zd' variant of '-z' */
+#define ZOPT_NONE               0
+#define ZOPT_ZLIB               1
+#define ZOPT_DICT               2
+
+extern int zdict_init(void);
+extern unsigned long zdict_get_id(void);
+extern size_t zdict_parse_opt(const char *s, int *zoption);
+extern const char *zdict_opt_str(int zoption);
+extern int zdict_deflate_init(z_stream *zs, int zoption);
+extern int zdict_inflate(z_stream *zs);
+extern int zdict_inflate_flush(z_stream *zs, int flush);
+
+#endif
+